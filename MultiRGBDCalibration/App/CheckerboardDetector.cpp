@@ -0,0 +1,280 @@
+#include "CheckerboardDetector.h"
+
+#define DETECT_REFINE_WINDOW 3 // half size in pixels of the window refining the corners on the pyramid levels
+
+CheckerboardDetector::CheckerboardDetector() : m_bPyramid(false), m_expectedBoardPixels(0), m_minSquarePixels(12),
+	m_presenceCheck(PRESENCE_OFF), m_backend(BACKEND_OPENCV)
+{
+
+}
+
+CheckerboardDetector::~CheckerboardDetector()
+{
+
+}
+
+void CheckerboardDetector::init(const cv::Size patternSize)
+{
+	m_patternSize = patternSize;
+	m_saddleDetector.init(patternSize);
+}
+
+void CheckerboardDetector::setPyramid(const bool bPyramid, const int expectedBoardPixels, const int minSquarePixels)
+{
+	m_bPyramid = bPyramid;
+	m_expectedBoardPixels = expectedBoardPixels;
+	m_minSquarePixels = std::max(minSquarePixels, 1);
+}
+
+bool CheckerboardDetector::detect(const cv::Mat& grayMat, corner2d_t& corners, int* level, const int64 deadlineTick,
+	bool* bCutShort) const
+{
+	if (bCutShort != NULL)
+		*bCutShort = false;
+	if (isPastDeadline(deadlineTick))
+	{
+		corners.clear();
+		if (bCutShort != NULL)
+			*bCutShort = true;
+		return false;
+	}
+
+	if (m_backend == BACKEND_SADDLE)
+	{
+		if (level != NULL)
+			*level = 0;
+		return _detectSaddle(grayMat, corners);
+	}
+
+	int numLevel = m_bPyramid ? getPyramidLevel(grayMat.size()) : 0;
+	if (level != NULL)
+		*level = numLevel;
+
+	if (numLevel > 0 && _detectPyramid(grayMat, numLevel, corners, deadlineTick))
+		return true;
+
+	// the coarse search failed or wasn't finished
+	if (isPastDeadline(deadlineTick))
+	{
+		if (bCutShort != NULL)
+			*bCutShort = true;
+		return false;
+	}
+
+	if (level != NULL)
+		*level = 0;
+	return detectFullResolution(grayMat, corners);
+}
+
+bool CheckerboardDetector::detectFullResolution(const cv::Mat& grayMat, corner2d_t& corners) const
+{
+	corners.clear();
+
+	bool patternfound =
+		cv::findChessboardCorners(grayMat,
+		m_patternSize,
+		corners,
+		cv::CALIB_CB_ADAPTIVE_THRESH +
+		cv::CALIB_CB_NORMALIZE_IMAGE);
+
+	if (patternfound)
+		_refineCorners(grayMat, corners);
+
+	return patternfound;
+}
+
+bool CheckerboardDetector::detectInRoi(const cv::Mat& grayMat, const cv::Rect roi, corner2d_t& corners,
+	int* level, const int64 deadlineTick, bool* bCutShort) const
+{
+	corners.clear();
+	if (bCutShort != NULL)
+		*bCutShort = false;
+
+	cv::Rect frameRoi = roi & cv::Rect(0, 0, grayMat.cols, grayMat.rows);
+	if (frameRoi.area() == 0)
+		return false;
+
+	if (!detect(grayMat(frameRoi), corners, level, deadlineTick, bCutShort))
+		return false;
+
+	cv::Point2f offset((float) frameRoi.x, (float) frameRoi.y);
+	for (int cornerId = 0; cornerId < corners.size(); cornerId++)
+		corners[cornerId] += offset;
+	return true;
+}
+
+void CheckerboardDetector::buildTrackingPyramid(const cv::Mat& grayMat, std::vector<cv::Mat>& pyramid) const
+{
+	cv::buildOpticalFlowPyramid(grayMat, pyramid, cv::Size(TRACK_WINDOW, TRACK_WINDOW), TRACK_MAX_LEVEL);
+}
+
+bool CheckerboardDetector::track(const std::vector<cv::Mat>& prevPyramid, const corner2d_t& prevCorners,
+	const std::vector<cv::Mat>& pyramid, const cv::Mat& grayMat, corner2d_t& corners) const
+{
+	corners.clear();
+	if (prevPyramid.empty() || pyramid.empty() || prevCorners.size() != m_patternSize.area())
+		return false;
+
+	std::vector<uchar> status;
+	std::vector<float> error;
+	cv::calcOpticalFlowPyrLK(prevPyramid, pyramid, prevCorners, corners, status, error,
+		cv::Size(TRACK_WINDOW, TRACK_WINDOW), TRACK_MAX_LEVEL,
+		cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.01));
+
+	// every corner has to be found inside the frame
+	bool bTracked = corners.size() == prevCorners.size();
+	for (int cornerId = 0; bTracked && cornerId < corners.size(); cornerId++)
+	{
+		const cv::Point2f& corner = corners[cornerId];
+		if (!status[cornerId] || corner.x < 0 || corner.y < 0 || corner.x > grayMat.cols - 1 || corner.y > grayMat.rows - 1)
+			bTracked = false;
+	}
+
+	if (!bTracked || !_isGrid(corners))
+	{
+		corners.clear();
+		return false;
+	}
+
+	_refineCorners(grayMat, corners);
+	return true;
+}
+
+bool CheckerboardDetector::isBoardPresent(const cv::Mat& grayMat) const
+{
+	if (m_presenceCheck == PRESENCE_OFF)
+		return true;
+
+	bool bConservative = m_presenceCheck == PRESENCE_CONSERVATIVE;
+	float squarePixels = bConservative ? PRESENCE_CONSERVATIVE_SQUARE_PIXELS : PRESENCE_FAST_SQUARE_PIXELS;
+	double scale = std::min(1.0, (double) squarePixels / _getExpectedSquarePixels(grayMat.size()));
+
+	cv::Mat smallMat = grayMat;
+	if (scale < 1.0)
+		cv::resize(grayMat, smallMat, cv::Size(), scale, scale, cv::INTER_AREA);
+
+	corner2d_t corners;
+	int flags = cv::CALIB_CB_FAST_CHECK;
+	if (bConservative)
+		flags += cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_NORMALIZE_IMAGE;
+	return cv::findChessboardCorners(smallMat, m_patternSize, corners, flags);
+}
+
+int CheckerboardDetector::getPyramidLevel(const cv::Size frameSize) const
+{
+	float squarePixels = _getExpectedSquarePixels(frameSize);
+
+	int numLevel = 0;
+	while (numLevel < DETECT_MAX_PYRAMID_LEVEL && squarePixels / 2 >= m_minSquarePixels)
+	{
+		squarePixels /= 2;
+		numLevel++;
+	}
+	return numLevel;
+}
+
+float CheckerboardDetector::_getExpectedSquarePixels(const cv::Size frameSize) const
+{
+	// the board spans patternWidth + 1 squares
+	int boardPixels = (m_expectedBoardPixels > 0) ? m_expectedBoardPixels : frameSize.width / 3;
+	return std::max((float) boardPixels / (m_patternSize.width + 1), 1.0f);
+}
+
+bool CheckerboardDetector::_detectPyramid(const cv::Mat& grayMat, const int numLevel, corner2d_t& corners,
+	const int64 deadlineTick) const
+{
+	corners.clear();
+
+	// pyramid[level], level 0 is the frame itself
+	std::vector<cv::Mat> pyramid(numLevel + 1);
+	pyramid[0] = grayMat;
+	for (int level = 1; level <= numLevel; level++)
+	{
+		if (isPastDeadline(deadlineTick))
+			return false;
+		cv::pyrDown(pyramid[level - 1], pyramid[level]);
+	}
+
+	// a board found is refined whatever the deadline, the refinement is cheap next to the search
+	if (isPastDeadline(deadlineTick) || !cv::findChessboardCorners(pyramid[numLevel],
+		m_patternSize,
+		corners,
+		cv::CALIB_CB_ADAPTIVE_THRESH +
+		cv::CALIB_CB_NORMALIZE_IMAGE))
+	{
+		corners.clear();
+		return false;
+	}
+
+	// pixel x of a level is pixel 2x of the level below; refine on every level so the seeds stay within the window
+	cv::TermCriteria refineCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.05);
+	for (int level = numLevel; level > 0; level--)
+	{
+		cv::cornerSubPix(pyramid[level], corners, cv::Size(DETECT_REFINE_WINDOW, DETECT_REFINE_WINDOW),
+			cv::Size(-1, -1), refineCriteria);
+		for (int cornerId = 0; cornerId < corners.size(); cornerId++)
+			corners[cornerId] *= 2.0f;
+	}
+
+	_refineCorners(grayMat, corners);
+	return true;
+}
+
+bool CheckerboardDetector::_detectSaddle(const cv::Mat& grayMat, corner2d_t& corners) const
+{
+	if (!m_saddleDetector.detect(grayMat, corners) || !_isGrid(corners))
+	{
+		corners.clear();
+		return false;
+	}
+
+	_refineCorners(grayMat, corners);
+	return true;
+}
+
+void CheckerboardDetector::_refineCorners(const cv::Mat& grayMat, corner2d_t& corners) const
+{
+	cv::cornerSubPix(grayMat, corners, m_patternSize,
+		cv::Size(-1, -1), cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 300, 0.01));
+}
+
+bool CheckerboardDetector::_isGrid(const corner2d_t& corners) const
+{
+	// the corners lie on a plane, so a homography from the ideal grid has to explain all of them
+	corner2d_t gridPoints;
+	for (int row = 0; row < m_patternSize.height; row++)
+		for (int col = 0; col < m_patternSize.width; col++)
+			gridPoints.push_back(cv::Point2f((float) col, (float) row));
+
+	cv::Mat homography = cv::findHomography(gridPoints, corners, 0);
+	if (homography.empty())
+		return false;
+
+	corner2d_t projected;
+	cv::perspectiveTransform(gridPoints, projected, homography);
+
+	// tolerance relative to the average square size, lens distortion bends the grid slightly
+	float squarePixels = 0;
+	int numSquare = 0;
+	for (int row = 0; row < m_patternSize.height; row++)
+		for (int col = 0; col + 1 < m_patternSize.width; col++)
+		{
+			cv::Point2f edge = corners[row * m_patternSize.width + col + 1] - corners[row * m_patternSize.width + col];
+			squarePixels += std::sqrt(edge.x * edge.x + edge.y * edge.y);
+			numSquare++;
+		}
+	if (numSquare == 0)
+		return false;
+	squarePixels /= numSquare;
+	if (squarePixels < 2.0f)
+		return false;
+
+	float maxError = TRACK_MAX_GRID_ERROR * squarePixels;
+	for (int cornerId = 0; cornerId < corners.size(); cornerId++)
+	{
+		cv::Point2f diff = projected[cornerId] - corners[cornerId];
+		if (diff.x * diff.x + diff.y * diff.y > maxError * maxError)
+			return false;
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+/* This class finds the inner corners of the checkerboard in a grayscale frame.
+*
+* The full resolution search runs findChessboardCorners on the frame itself.
+* The pyramid search runs it on a downscaled level, chosen so that a board
+* square of the expected size keeps at least minSquarePixels there, and then
+* refines the corners level by level up to cornerSubPix at full resolution.
+* Frames where the board isn't found on the coarse level are searched again
+* at full resolution, so the pyramid never finds fewer boards.
+*
+* Between consecutive frames the corners can be tracked instead: they are
+* moved with pyramidal Lucas-Kanade, accepted only if they still fit a planar
+* grid, and refined with cornerSubPix like a searched board.
+*
+* The presence check rejects frames without a board before the search: the
+* frame is shrunk until a board square has a few pixels and searched with
+* CALIB_CB_FAST_CHECK, which gives up quickly when there is no board. The
+* conservative check keeps larger squares and the adaptive threshold, so it
+* rejects fewer frames but misses fewer boards.
+*
+* A single findChessboardCorners call can't be interrupted, so a deadline is
+* only checked between the steps of a search: before each pyramid level is
+* built, before the coarse and the full resolution search and before the
+* saddle point backend. A step that isn't started cuts the search short.
+*
+* The saddle point backend replaces the search by SaddlePointDetector on the
+* full resolution frame, which takes about the same time whatever the frame
+* shows; its corners are checked to fit a planar grid and refined the same
+* way. detectFullResolution and the presence check always use
+* findChessboardCorners, so the benchmark compares the backends.
+*/
+
+#pragma once
+
+#ifndef __CHECKERBOARD_DETECTOR_H__
+#define __CHECKERBOARD_DETECTOR_H__
+
+#include "MultiRGBDCalibrationUtil.h"
+#include "SaddlePointDetector.h"
+
+#define DETECT_MAX_PYRAMID_LEVEL 3
+#define TRACK_WINDOW 21 // pixels
+#define TRACK_MAX_LEVEL 3
+#define TRACK_MAX_GRID_ERROR 0.2f // in board squares
+#define PRESENCE_FAST_SQUARE_PIXELS 6
+#define PRESENCE_CONSERVATIVE_SQUARE_PIXELS 12
+
+class CheckerboardDetector
+{
+public:
+	enum PRESENCE_CHECK{PRESENCE_OFF, PRESENCE_FAST, PRESENCE_CONSERVATIVE};
+	enum DETECT_BACKEND{BACKEND_OPENCV, BACKEND_SADDLE};
+
+	CheckerboardDetector();
+	virtual ~CheckerboardDetector();
+
+	void init(const cv::Size patternSize);
+	// expectedBoardPixels is the board width in full resolution pixels, <= 0 for a third of the frame width
+	void setPyramid(const bool bPyramid, const int expectedBoardPixels, const int minSquarePixels);
+
+	void setPresenceCheck(const PRESENCE_CHECK presenceCheck)
+	{
+		m_presenceCheck = presenceCheck;
+	}
+	// the saddle point backend ignores the pyramid
+	void setBackend(const DETECT_BACKEND backend)
+	{
+		m_backend = backend;
+	}
+
+	cv::Size getPatternSize() const
+	{
+		return m_patternSize;
+	}
+
+	// cheap test on a shrunk copy of the frame, false if the frame most likely shows no board
+	bool isBoardPresent(const cv::Mat& grayMat) const;
+
+	// called concurrently from the detection workers; level returns the pyramid level the board was found on,
+	// deadlineTick is a cv::getTickCount() value, 0 for none, and bCutShort whether a step was skipped for it
+	bool detect(const cv::Mat& grayMat, corner2d_t& corners, int* level = NULL, const int64 deadlineTick = 0,
+		bool* bCutShort = NULL) const;
+	// findChessboardCorners on the whole frame, whatever the backend
+	bool detectFullResolution(const cv::Mat& grayMat, corner2d_t& corners) const;
+	// detect() inside roi only, the corners are in frame coordinates
+	bool detectInRoi(const cv::Mat& grayMat, const cv::Rect roi, corner2d_t& corners,
+		int* level = NULL, const int64 deadlineTick = 0, bool* bCutShort = NULL) const;
+
+	// the frame pyramid track() reads, built once per frame
+	void buildTrackingPyramid(const cv::Mat& grayMat, std::vector<cv::Mat>& pyramid) const;
+	// move the corners of the previous frame into the frame; false if they were lost or no longer form the grid
+	bool track(const std::vector<cv::Mat>& prevPyramid, const corner2d_t& prevCorners,
+		const std::vector<cv::Mat>& pyramid, const cv::Mat& grayMat, corner2d_t& corners) const;
+
+	int getPyramidLevel(const cv::Size frameSize) const;
+	static bool isPastDeadline(const int64 deadlineTick)
+	{
+		return deadlineTick > 0 && cv::getTickCount() > deadlineTick;
+	}
+	bool isPyramid() const
+	{
+		return m_bPyramid;
+	}
+	PRESENCE_CHECK getPresenceCheck() const
+	{
+		return m_presenceCheck;
+	}
+	DETECT_BACKEND getBackend() const
+	{
+		return m_backend;
+	}
+
+private:
+	// false without searching once past the deadline
+	bool _detectPyramid(const cv::Mat& grayMat, const int numLevel, corner2d_t& corners, const int64 deadlineTick) const;
+	bool _detectSaddle(const cv::Mat& grayMat, corner2d_t& corners) const;
+	void _refineCorners(const cv::Mat& grayMat, corner2d_t& corners) const;
+	bool _isGrid(const corner2d_t& corners) const;
+	float _getExpectedSquarePixels(const cv::Size frameSize) const;
+
+	cv::Size m_patternSize;
+	bool m_bPyramid;
+	int m_expectedBoardPixels;
+	int m_minSquarePixels;
+	PRESENCE_CHECK m_presenceCheck;
+	DETECT_BACKEND m_backend;
+	SaddlePointDetector m_saddleDetector;
+};
+
+#endif//__CHECKERBOARD_DETECTOR_H__
\ No newline at end of file
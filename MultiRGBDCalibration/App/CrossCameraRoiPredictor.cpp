@@ -0,0 +1,129 @@
+#include "CrossCameraRoiPredictor.h"
+
+#include <algorithm>
+
+CrossCameraRoiPredictor::CrossCameraRoiPredictor()
+{
+
+}
+
+CrossCameraRoiPredictor::~CrossCameraRoiPredictor()
+{
+	clear();
+}
+
+void CrossCameraRoiPredictor::clear()
+{
+	m_cameras.clear();
+	m_boardPoses.clear();
+	m_boardCorners.clear();
+}
+
+void CrossCameraRoiPredictor::init(const std::vector<CameraIntrinsicF>& intrinsics,
+	const std::vector<CameraExtrinsicF>& extrinsics,
+	const std::vector<bool>& bCalibrated,
+	const cv::Size patternSize,
+	const float patternLength,
+	const int numFrame)
+{
+	clear();
+
+	m_cameras.resize(intrinsics.size());
+	for (int camId = 0; camId < intrinsics.size(); camId++)
+	{
+		const CameraIntrinsicF& intrinsic = intrinsics[camId];
+		CameraModel& camera = m_cameras[camId];
+		camera.bCalibrated = bCalibrated[camId] && intrinsic.w > 0 && intrinsic.h > 0;
+		if (!camera.bCalibrated)
+			continue;
+
+		camera.frameSize = cv::Size(intrinsic.w, intrinsic.h);
+		camera.cameraMatrix = cv::Mat::eye(3, 3, CV_64F);
+		camera.cameraMatrix.at<double>(0, 0) = intrinsic.fx;
+		camera.cameraMatrix.at<double>(1, 1) = intrinsic.fy;
+		camera.cameraMatrix.at<double>(0, 2) = intrinsic.cx;
+		camera.cameraMatrix.at<double>(1, 2) = intrinsic.cy;
+		// the intrinsic files hold four coefficients
+		camera.distCoeffs = cv::Mat::zeros(4, 1, CV_64F);
+		for (int i = 0; i < 4; i++)
+			camera.distCoeffs.at<double>(i) = intrinsic.dist[i];
+
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+				camera.rotation(i, j) = extrinsics[camId].Rotation[i][j];
+			camera.translation[i] = extrinsics[camId].Translation[i];
+		}
+	}
+
+	// same board coordinates as the intrinsic calibration
+	for (int j = 0; j < patternSize.height; j++)
+		for (int i = 0; i < patternSize.width; i++)
+			m_boardCorners.push_back(cv::Point3f(float(j*patternLength), float(i*patternLength), 0));
+
+	BoardPose invalidPose;
+	invalidPose.bValid = false;
+	m_boardPoses.assign(numFrame, invalidPose);
+}
+
+void CrossCameraRoiPredictor::addBoard(const int frameId, const int camId, const corner2d_t& corners)
+{
+	if (frameId < 0 || frameId >= m_boardPoses.size() || m_boardPoses[frameId].bValid
+		|| !isCalibrated(camId) || corners.size() != m_boardCorners.size())
+		return;
+
+	const CameraModel& camera = m_cameras[camId];
+	cv::Vec3d rvec, tvec;
+	if (!cv::solvePnP(m_boardCorners, corners, camera.cameraMatrix, camera.distCoeffs, rvec, tvec))
+		return;
+
+	cv::Matx33d boardRotation;
+	cv::Rodrigues(rvec, boardRotation);
+
+	BoardPose& pose = m_boardPoses[frameId];
+	pose.rotation = camera.rotation * boardRotation;
+	pose.translation = camera.rotation * tvec + camera.translation;
+	pose.bValid = true;
+}
+
+cv::Rect CrossCameraRoiPredictor::predictRoi(const int frameId, const int camId, const float padding) const
+{
+	if (frameId < 0 || frameId >= m_boardPoses.size() || !m_boardPoses[frameId].bValid || !isCalibrated(camId))
+		return cv::Rect();
+
+	// board to camera: x_cam = R^T * (x_ref - t)
+	const CameraModel& camera = m_cameras[camId];
+	const BoardPose& pose = m_boardPoses[frameId];
+	cv::Matx33d rotation = camera.rotation.t() * pose.rotation;
+	cv::Vec3d translation = camera.rotation.t() * (pose.translation - camera.translation);
+
+	// the projection of points behind the camera is meaningless
+	for (int cornerId = 0; cornerId < m_boardCorners.size(); cornerId++)
+	{
+		const cv::Point3f& corner = m_boardCorners[cornerId];
+		double z = rotation(2, 0) * corner.x + rotation(2, 1) * corner.y + rotation(2, 2) * corner.z + translation[2];
+		if (z <= 0)
+			return cv::Rect();
+	}
+
+	cv::Vec3d rvec;
+	cv::Rodrigues(rotation, rvec);
+	corner2d_t projected;
+	cv::projectPoints(m_boardCorners, rvec, translation, camera.cameraMatrix, camera.distCoeffs, projected);
+
+	cv::Rect box = cv::boundingRect(projected);
+	int pad = std::max(ROI_MIN_PADDING, (int) (padding * std::max(box.width, box.height)));
+	cv::Rect roi(box.x - pad, box.y - pad, box.width + 2 * pad, box.height + 2 * pad);
+	return roi & cv::Rect(0, 0, camera.frameSize.width, camera.frameSize.height);
+}
+
+int CrossCameraRoiPredictor::getNumBoard() const
+{
+	int numBoard = 0;
+	for (int frameId = 0; frameId < m_boardPoses.size(); frameId++)
+	{
+		if (m_boardPoses[frameId].bValid)
+			numBoard++;
+	}
+	return numBoard;
+}
\ No newline at end of file
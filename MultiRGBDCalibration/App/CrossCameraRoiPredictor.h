@@ -0,0 +1,76 @@
+/* This class predicts where the board appears in a camera from the cameras that already found it.
+*
+* The board pose of a frame is solved with solvePnP from the corners of the
+* first camera that found the board, moved into the other cameras with the
+* extrinsics of a previous calibration and projected with their intrinsics.
+* The bounding box of the projected corners is padded to absorb the error of
+* the rough extrinsics, so the search only needs to look inside it.
+*/
+
+#pragma once
+
+#ifndef __CROSS_CAMERA_ROI_PREDICTOR_H__
+#define __CROSS_CAMERA_ROI_PREDICTOR_H__
+
+#include "MultiRGBDCalibrationUtil.h"
+
+#define ROI_MIN_PADDING 32 // pixels
+
+class CrossCameraRoiPredictor
+{
+public:
+	CrossCameraRoiPredictor();
+	virtual ~CrossCameraRoiPredictor();
+
+	void clear();
+	// a camera takes part if bCalibrated[camId], its intrinsic has the frame size (w, h > 0);
+	// extrinsics[camId] takes the camera to the common reference frame
+	void init(const std::vector<CameraIntrinsicF>& intrinsics,
+		const std::vector<CameraExtrinsicF>& extrinsics,
+		const std::vector<bool>& bCalibrated,
+		const cv::Size patternSize,
+		const float patternLength,
+		const int numFrame);
+
+	bool isCalibrated(const int camId) const
+	{
+		return camId >= 0 && camId < m_cameras.size() && m_cameras[camId].bCalibrated;
+	}
+
+	// the first calibrated camera that found the board in the frame gives its pose
+	void addBoard(const int frameId, const int camId, const corner2d_t& corners);
+	// bounding box of the board in camId grown by padding times its size, clipped to the frame;
+	// empty if no camera found the board or it is projected out of the frame
+	cv::Rect predictRoi(const int frameId, const int camId, const float padding) const;
+
+	int getNumBoard() const;
+
+private:
+	struct CameraModel
+	{
+		bool bCalibrated;
+		cv::Size frameSize;
+		cv::Mat cameraMatrix;
+		cv::Mat distCoeffs;
+		// x_ref = rotation * x_cam + translation
+		cv::Matx33d rotation;
+		cv::Vec3d translation;
+	};
+
+	struct BoardPose
+	{
+		bool bValid;
+		// x_ref = rotation * x_board + translation
+		cv::Matx33d rotation;
+		cv::Vec3d translation;
+	};
+
+	// camId
+	std::vector<CameraModel> m_cameras;
+	// frameId
+	std::vector<BoardPose> m_boardPoses;
+	// cornerId, in board coordinates
+	corner3d_t m_boardCorners;
+};
+
+#endif//__CROSS_CAMERA_ROI_PREDICTOR_H__
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include "DatasetValidator.h"
+#include "..\Utility\ThreadPool.h"
+
+#include <cstdio>
+#include <cstring>
+
+#define PNG_HEADER_BYTES 26 // signature, IHDR length and type, width, height, bit depth, color type
+#define PNG_TRAILER_BYTES 12 // empty IEND chunk
+#define VALIDATION_FILES_PER_JOB 64
+#define VALIDATION_MAX_PRINTED 20
+
+static const unsigned char PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+static const unsigned char PNG_IEND[PNG_TRAILER_BYTES] = {0, 0, 0, 0, 'I', 'E', 'N', 'D', 0xae, 0x42, 0x60, 0x82};
+
+static int readBigEndian32(const unsigned char* bytes)
+{
+	return (int) (((unsigned) bytes[0] << 24) | ((unsigned) bytes[1] << 16) | ((unsigned) bytes[2] << 8) | bytes[3]);
+}
+
+DatasetValidator::DatasetValidator() : m_config(NULL)
+{
+
+}
+
+DatasetValidator::~DatasetValidator()
+{
+
+}
+
+bool DatasetValidator::validate(const MultiRGBDCalibrationConfig& config,
+	const std::vector<CameraIntrinsicF>& intrinsics,
+	const int numThreads)
+{
+	int64 startTick = cv::getTickCount();
+
+	m_config = &config;
+	m_checks.clear();
+	for (int camId = 0; camId < config.numCamera; camId++)
+	{
+		if (config.frameLayout == MultiRGBDCalibrationConfig::RGBD_SEQUENCE)
+			_addFile(config.sequenceFilenames[camId], camId, -1, CONTAINER);
+		else if (config.frameLayout == MultiRGBDCalibrationConfig::VIDEO)
+		{
+			_addFile(config.colorVideoFilenames[camId], camId, -1, CONTAINER);
+			_addFile(config.depthVideoFilenames[camId], camId, -1, CONTAINER);
+		}
+		else {
+			for (int frameId = 0; frameId < config.frameSet.getNumFrame(); frameId++)
+				_addFile("", camId, frameId, COLOR_PNG);
+			for (int frameId = 0; frameId < config.frameSet.getNumFrame(); frameId++)
+				_addFile("", camId, frameId, DEPTH_PNG);
+		}
+	}
+
+	if (config.numCamera <= 0 || m_checks.empty())
+	{
+		printf("Dataset check failed: no cameras or frames configured in %s\n", config.configFilename.c_str());
+		return false;
+	}
+
+	// small batches keep the queue short while still spreading the opens over all threads
+	ThreadPool threadPool;
+	threadPool.init(numThreads);
+	int numCheck = (int) m_checks.size();
+	for (int checkStart = 0; checkStart < numCheck; checkStart += VALIDATION_FILES_PER_JOB)
+	{
+		int checkEnd = std::min(checkStart + VALIDATION_FILES_PER_JOB, numCheck);
+		threadPool.enqueue(std::bind(&DatasetValidator::_checkFiles, this, checkStart, checkEnd));
+	}
+	threadPool.wait();
+	threadPool.clear();
+
+	_checkFrameSizes(intrinsics, config.numCamera);
+
+	int numFailed = 0;
+	for (int checkId = 0; checkId < numCheck; checkId++)
+	{
+		if (m_checks[checkId].status == VALID)
+			continue;
+
+		if (numFailed < VALIDATION_MAX_PRINTED)
+			_printCheck(m_checks[checkId]);
+		numFailed++;
+	}
+	if (numFailed > VALIDATION_MAX_PRINTED)
+		printf("  ... and %d more\n", numFailed - VALIDATION_MAX_PRINTED);
+
+	double ms = (cv::getTickCount() - startTick) * 1000.0 / cv::getTickFrequency();
+	if (numFailed > 0)
+		printf("Dataset check failed: %d of %d files are unusable (%.1f ms)\n", numFailed, numCheck, ms);
+	else
+		printf("Dataset check passed: %d files of %d cameras (%.1f ms)\n", numCheck, config.numCamera, ms);
+
+	return numFailed == 0;
+}
+
+void DatasetValidator::_addFile(const std::string& filename, const int camId, const int frameId, const FILE_KIND kind)
+{
+	FileCheck check;
+	check.filename = filename;
+	check.camId = camId;
+	check.frameId = frameId;
+	check.kind = kind;
+	check.status = VALID;
+	check.width = 0;
+	check.height = 0;
+	check.bitDepth = 0;
+	check.colorType = 0;
+	m_checks.push_back(check);
+}
+
+void DatasetValidator::_checkFiles(const int checkStart, const int checkEnd)
+{
+	for (int checkId = checkStart; checkId < checkEnd; checkId++)
+	{
+		FileCheck& check = m_checks[checkId];
+
+		FILE* file = fopen(_getFilename(check).c_str(), "rb");
+		if (file == NULL)
+		{
+			check.status = MISSING;
+			continue;
+		}
+
+		if (check.kind == CONTAINER)
+		{
+			fclose(file);
+			continue;
+		}
+
+		// a png missing its IEND trailer was cut off while being written or copied
+		unsigned char header[PNG_HEADER_BYTES];
+		unsigned char trailer[PNG_TRAILER_BYTES];
+		bool bHeader = fread(header, 1, PNG_HEADER_BYTES, file) == PNG_HEADER_BYTES;
+		bool bTrailer = fseek(file, -PNG_TRAILER_BYTES, SEEK_END) == 0
+			&& fread(trailer, 1, PNG_TRAILER_BYTES, file) == PNG_TRAILER_BYTES;
+		fclose(file);
+
+		if (bHeader && (memcmp(header, PNG_SIGNATURE, 8) != 0 || memcmp(header + 12, "IHDR", 4) != 0))
+		{
+			check.status = NOT_PNG;
+			continue;
+		}
+		if (!bHeader || !bTrailer || memcmp(trailer, PNG_IEND, PNG_TRAILER_BYTES) != 0)
+		{
+			check.status = TRUNCATED;
+			continue;
+		}
+
+		check.width = readBigEndian32(header + 16);
+		check.height = readBigEndian32(header + 20);
+		check.bitDepth = header[24];
+		check.colorType = header[25];
+
+		// color is decoded as 8-bit, depth as 16-bit single channel
+		if (check.kind == COLOR_PNG && check.bitDepth != 8)
+			check.status = WRONG_FORMAT;
+		if (check.kind == DEPTH_PNG && (check.bitDepth != 16 || check.colorType != 0))
+			check.status = WRONG_FORMAT;
+	}
+}
+
+void DatasetValidator::_checkFrameSizes(const std::vector<CameraIntrinsicF>& intrinsics, const int numCamera)
+{
+	// the depth frames are sampled at color pixel coordinates, so both have the frame size
+	m_frameSizes.assign(numCamera, cv::Size(0, 0));
+	for (int camId = 0; camId < numCamera && camId < intrinsics.size(); camId++)
+	{
+		if (intrinsics[camId].w > 0 && intrinsics[camId].h > 0)
+			m_frameSizes[camId] = cv::Size(intrinsics[camId].w, intrinsics[camId].h);
+	}
+
+	for (int checkId = 0; checkId < m_checks.size(); checkId++)
+	{
+		FileCheck& check = m_checks[checkId];
+		if (check.kind == CONTAINER || check.status != VALID)
+			continue;
+
+		cv::Size& frameSize = m_frameSizes[check.camId];
+		if (frameSize.area() == 0)
+			frameSize = cv::Size(check.width, check.height);
+		else if (frameSize != cv::Size(check.width, check.height))
+			check.status = WRONG_SIZE;
+	}
+}
+
+void DatasetValidator::_printCheck(const FileCheck& check) const
+{
+	const char* kindName = (check.kind == COLOR_PNG) ? "color" : ((check.kind == DEPTH_PNG) ? "depth" : "container");
+	std::string filename = _getFilename(check);
+
+	switch (check.status)
+	{
+	case MISSING:
+		printf("  missing %s file: %s\n", kindName, filename.c_str());
+		break;
+	case TRUNCATED:
+		printf("  truncated %s file: %s\n", kindName, filename.c_str());
+		break;
+	case NOT_PNG:
+		printf("  %s file is not a png: %s\n", kindName, filename.c_str());
+		break;
+	case WRONG_FORMAT:
+		printf("  %s frame is %d-bit with png color type %d, expected %s: %s\n", kindName, check.bitDepth, check.colorType,
+			check.kind == COLOR_PNG ? "8-bit" : "16-bit grayscale", filename.c_str());
+		break;
+	case WRONG_SIZE:
+		printf("  %s frame is %dx%d, expected %dx%d: %s\n", kindName, check.width, check.height,
+			m_frameSizes[check.camId].width, m_frameSizes[check.camId].height, filename.c_str());
+		break;
+	default:
+		break;
+	}
+}
+
+std::string DatasetValidator::_getFilename(const FileCheck& check) const
+{
+	if (check.kind == COLOR_PNG)
+		return m_config->getColorFilename(check.camId, check.frameId);
+	if (check.kind == DEPTH_PNG)
+		return m_config->getDepthFilename(check.camId, check.frameId);
+	return check.filename;
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+/* This class checks the input files of all cameras before any frame is decoded.
+*
+* Every expected file is checked in parallel reading only its png header and
+* trailer, so a missing, truncated or mismatched frame fails the run right after
+* the configuration is loaded instead of after the earlier cameras are processed.
+*/
+
+#pragma once
+
+#ifndef __DATASET_VALIDATOR_H__
+#define __DATASET_VALIDATOR_H__
+
+#include "MultiRGBDCalibrationConfig.h"
+#include "MultiRGBDCalibrationUtil.h"
+
+class DatasetValidator
+{
+public:
+	DatasetValidator();
+	virtual ~DatasetValidator();
+
+	// check the files the configured layout reads; the frame size of a camera is checked
+	// against intrinsics[camId] when it has been loaded (w, h > 0), otherwise against its first frame
+	bool validate(const MultiRGBDCalibrationConfig& config,
+		const std::vector<CameraIntrinsicF>& intrinsics,
+		const int numThreads);
+
+private:
+	enum FILE_KIND{COLOR_PNG, DEPTH_PNG, CONTAINER};
+	enum FILE_STATUS{VALID, MISSING, TRUNCATED, NOT_PNG, WRONG_FORMAT, WRONG_SIZE};
+
+	struct FileCheck
+	{
+		// empty for png frames, which are resolved from frameId
+		std::string filename;
+		int camId;
+		int frameId;
+		FILE_KIND kind;
+		FILE_STATUS status;
+		int width, height;
+		int bitDepth;
+		int colorType;
+	};
+
+	void _addFile(const std::string& filename, const int camId, const int frameId, const FILE_KIND kind);
+	void _checkFiles(const int checkStart, const int checkEnd);
+	void _checkFrameSizes(const std::vector<CameraIntrinsicF>& intrinsics, const int numCamera);
+	void _printCheck(const FileCheck& check) const;
+	std::string _getFilename(const FileCheck& check) const;
+
+	const MultiRGBDCalibrationConfig* m_config;
+
+	// checkId
+	std::vector<FileCheck> m_checks;
+	// camId
+	std::vector<cv::Size> m_frameSizes;
+};
+
+#endif//__DATASET_VALIDATOR_H__
\ No newline at end of file
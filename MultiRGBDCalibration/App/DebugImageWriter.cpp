@@ -0,0 +1,230 @@
+#include "DebugImageWriter.h"
+
+#include <algorithm>
+
+DebugImageWriter::DebugImageWriter() : m_output(OUTPUT_NONE), m_queueSize(0), m_maxWidth(0), m_bStop(true),
+	m_numWritten(0), m_numDropped(0), m_numFailed(0), m_maxQueued(0), m_writeTicks(0)
+{
+
+}
+
+DebugImageWriter::~DebugImageWriter()
+{
+	clear();
+}
+
+void DebugImageWriter::init(const OUTPUT output, const std::string& folder, const int queueSize, const int maxWidth)
+{
+	clear();
+
+	m_output = output;
+	m_folder = folder;
+	m_queueSize = std::max(queueSize, 1);
+	m_maxWidth = std::max(maxWidth, 0);
+	if (m_output == OUTPUT_NONE)
+		return;
+
+	m_bStop = false;
+	m_thread = std::thread(&DebugImageWriter::_writeLoop, this);
+}
+
+void DebugImageWriter::finish()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_bStop = true;
+	}
+	m_jobCondition.notify_all();
+
+	if (m_thread.joinable())
+		m_thread.join();
+
+	// the last, partly filled sheets
+	for (std::map<std::string, Sheet>::iterator it = m_sheets.begin(); it != m_sheets.end(); it++)
+	{
+		_writeSheet(it->first, it->second);
+		it->second.video.release();
+	}
+	m_sheets.clear();
+}
+
+void DebugImageWriter::clear()
+{
+	finish();
+
+	m_output = OUTPUT_NONE;
+	m_jobs.clear();
+	m_numWritten = 0;
+	m_numDropped = 0;
+	m_numFailed = 0;
+	m_maxQueued = 0;
+	m_writeTicks = 0;
+}
+
+bool DebugImageWriter::push(const std::string& name, const int frameId, const cv::Mat& frame, const corner2d_t& corners,
+	const cv::Size patternSize, const bool bFound, const std::string& label)
+{
+	if (m_output == OUTPUT_NONE || frame.data == NULL)
+		return false;
+
+	Job job;
+	job.name = name;
+	job.frameId = frameId;
+	job.frame = frame;
+	job.corners = corners;
+	job.patternSize = patternSize;
+	job.bFound = bFound;
+	job.label = label;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_bStop)
+			return false;
+		if ((int) m_jobs.size() >= m_queueSize)
+		{
+			m_numDropped++;
+			return false;
+		}
+		m_jobs.push_back(job);
+		m_maxQueued = std::max(m_maxQueued, (int) m_jobs.size());
+	}
+	m_jobCondition.notify_one();
+	return true;
+}
+
+void DebugImageWriter::printStats() const
+{
+	if (m_output == OUTPUT_NONE)
+		return;
+
+	printf("Wrote %d debug frames to %s in %.1f ms on the writer thread (%d dropped, %d failed, max. %d of %d queued)\n",
+		m_numWritten, m_folder.c_str(), m_writeTicks * 1000.0 / cv::getTickFrequency(),
+		m_numDropped, m_numFailed, m_maxQueued, m_queueSize);
+}
+
+void DebugImageWriter::_writeLoop()
+{
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (!m_bStop && m_jobs.empty())
+				m_jobCondition.wait(lock);
+
+			// the queue is written out before stopping
+			if (m_bStop && m_jobs.empty())
+				return;
+
+			job = m_jobs.front();
+			m_jobs.pop_front();
+		}
+
+		int64 startTick = cv::getTickCount();
+		if (m_output == OUTPUT_IMAGES)
+			_writeImage(job);
+		else
+			_addTile(job);
+		m_writeTicks += cv::getTickCount() - startTick;
+	}
+}
+
+cv::Mat DebugImageWriter::_render(const Job& job, const cv::Size size) const
+{
+	// the frame is shared with the store, so it is drawn on a resized or converted copy
+	cv::Mat image;
+	if (size == job.frame.size())
+		image = job.frame.clone();
+	else
+		cv::resize(job.frame, image, size, 0, 0, cv::INTER_AREA);
+	if (image.channels() == 1)
+		cv::cvtColor(image, image, CV_GRAY2BGR);
+	else if (image.channels() == 4)
+		cv::cvtColor(image, image, CV_BGRA2BGR);
+
+	if (!job.corners.empty())
+	{
+		float scaleX = (float) size.width / job.frame.cols;
+		float scaleY = (float) size.height / job.frame.rows;
+		corner2d_t corners(job.corners.size());
+		for (int cornerId = 0; cornerId < corners.size(); cornerId++)
+			corners[cornerId] = cv::Point2f(job.corners[cornerId].x * scaleX, job.corners[cornerId].y * scaleY);
+		cv::drawChessboardCorners(image, job.patternSize, cv::Mat(corners), job.bFound);
+	}
+
+	char text[256];
+	sprintf_s(text, 256, "%s %d: %s", job.name.c_str(), job.frameId, job.label.c_str());
+	cv::Point origin(6, 18);
+	cv::putText(image, text, origin, cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 0), 3);
+	cv::putText(image, text, origin, cv::FONT_HERSHEY_SIMPLEX, 0.5,
+		job.bFound ? cv::Scalar(0, 255, 0) : cv::Scalar(0, 0, 255), 1);
+	return image;
+}
+
+void DebugImageWriter::_writeImage(const Job& job)
+{
+	cv::Size size = job.frame.size();
+	if (m_maxWidth > 0 && size.width > m_maxWidth)
+		size = cv::Size(m_maxWidth, cvRound((double) size.height * m_maxWidth / size.width));
+
+	char filename[1024];
+	sprintf_s(filename, 1024, "%s/%s-%04d.jpg", m_folder.c_str(), job.name.c_str(), job.frameId);
+
+	std::vector<int> params;
+	params.push_back(cv::IMWRITE_JPEG_QUALITY);
+	params.push_back(DEBUG_JPEG_QUALITY);
+	if (cv::imwrite(filename, _render(job, size), params))
+		m_numWritten++;
+	else
+		m_numFailed++;
+}
+
+void DebugImageWriter::_addTile(const Job& job)
+{
+	// the tile size of a camera follows its first frame
+	Sheet& sheet = m_sheets[job.name];
+	if (sheet.canvas.data == NULL)
+	{
+		int sheetWidth = m_maxWidth > 0 ? m_maxWidth : job.frame.cols * DEBUG_SHEET_COLUMNS;
+		int tileWidth = std::max(sheetWidth / DEBUG_SHEET_COLUMNS, 1);
+		sheet.tileSize = cv::Size(tileWidth, std::max(cvRound((double) job.frame.rows * tileWidth / job.frame.cols), 1));
+		sheet.canvas = cv::Mat::zeros(sheet.tileSize.height * DEBUG_SHEET_ROWS, sheet.tileSize.width * DEBUG_SHEET_COLUMNS, CV_8UC3);
+		sheet.numTile = 0;
+		sheet.bFailed = false;
+	}
+
+	cv::Rect tileRect((sheet.numTile % DEBUG_SHEET_COLUMNS) * sheet.tileSize.width,
+		(sheet.numTile / DEBUG_SHEET_COLUMNS) * sheet.tileSize.height, sheet.tileSize.width, sheet.tileSize.height);
+	_render(job, sheet.tileSize).copyTo(sheet.canvas(tileRect));
+	sheet.numTile++;
+
+	if (sheet.numTile == DEBUG_SHEET_COLUMNS * DEBUG_SHEET_ROWS)
+		_writeSheet(job.name, sheet);
+}
+
+void DebugImageWriter::_writeSheet(const std::string& name, Sheet& sheet)
+{
+	if (sheet.numTile == 0)
+		return;
+
+	if (!sheet.bFailed && !sheet.video.isOpened())
+	{
+		std::string filename = m_folder + "/" + name + ".avi";
+		if (!sheet.video.open(filename, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), DEBUG_SHEET_FPS, sheet.canvas.size()))
+		{
+			printf("Couldn't open debug video %s\n", filename.c_str());
+			sheet.bFailed = true;
+		}
+	}
+
+	if (sheet.video.isOpened())
+	{
+		sheet.video.write(sheet.canvas);
+		m_numWritten += sheet.numTile;
+	}
+	else
+		m_numFailed += sheet.numTile;
+
+	sheet.canvas.setTo(cv::Scalar::all(0));
+	sheet.numTile = 0;
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+/* This class draws the detected corners of the frames to disk in the background.
+*
+* The detection workers push one job per frame, a reference to the frame and
+* its corners, and go on at once; a single writer thread draws the corners and
+* writes either a jpg per frame or, per camera, a video of contact sheets with
+* several frames each. The queue is bounded: when the writer falls behind, new
+* jobs are dropped and counted instead of holding up the detection.
+*
+* A job only references its frame, so frames viewed from the slab of a frame
+* store have to stay loaded until finish() has returned.
+*/
+
+#pragma once
+
+#ifndef __DEBUG_IMAGE_WRITER_H__
+#define __DEBUG_IMAGE_WRITER_H__
+
+#include <deque>
+#include <map>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "MultiRGBDCalibrationUtil.h"
+
+#define DEBUG_SHEET_COLUMNS 4
+#define DEBUG_SHEET_ROWS 3
+#define DEBUG_SHEET_FPS 2.0
+#define DEBUG_JPEG_QUALITY 90
+
+class DebugImageWriter
+{
+public:
+	enum OUTPUT{OUTPUT_NONE, OUTPUT_IMAGES, OUTPUT_VIDEO};
+
+	DebugImageWriter();
+	virtual ~DebugImageWriter();
+
+	// start the writer thread; maxWidth is the width of an image or of a whole contact sheet, 0 = frame size
+	void init(const OUTPUT output, const std::string& folder, const int queueSize, const int maxWidth);
+	// write the queued jobs, close the videos and stop the writer thread
+	void finish();
+	void clear();
+
+	bool isEnabled() const
+	{
+		return m_output != OUTPUT_NONE;
+	}
+
+	// called concurrently from the detection workers; false if the job was dropped
+	bool push(const std::string& name, const int frameId, const cv::Mat& frame, const corner2d_t& corners,
+		const cv::Size patternSize, const bool bFound, const std::string& label);
+
+	void printStats() const;
+
+private:
+	struct Job
+	{
+		std::string name;
+		int frameId;
+		cv::Mat frame;
+		corner2d_t corners;
+		cv::Size patternSize;
+		bool bFound;
+		std::string label;
+	};
+
+	// the contact sheet video of one camera
+	struct Sheet
+	{
+		cv::VideoWriter video;
+		cv::Mat canvas;
+		cv::Size tileSize;
+		int numTile;
+		bool bFailed;
+	};
+
+	void _writeLoop();
+	// the frame scaled to size with its corners and label drawn on it
+	cv::Mat _render(const Job& job, const cv::Size size) const;
+	void _writeImage(const Job& job);
+	void _addTile(const Job& job);
+	void _writeSheet(const std::string& name, Sheet& sheet);
+
+	OUTPUT m_output;
+	std::string m_folder;
+	int m_queueSize;
+	int m_maxWidth;
+
+	std::deque<Job> m_jobs;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_jobCondition;
+	bool m_bStop;
+
+	// by camera name, used by the writer thread only
+	std::map<std::string, Sheet> m_sheets;
+
+	/* ----- Statistics ----- */
+	int m_numWritten;
+	int m_numDropped;
+	int m_numFailed;
+	int m_maxQueued;
+	int64 m_writeTicks;
+};
+
+#endif//__DEBUG_IMAGE_WRITER_H__
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "DepthBoardFinder.h"
+
+#include <algorithm>
+
+DepthBoardFinder::DepthBoardFinder() : m_boardDiagonal(0.0f), m_squareLength(0.0f), m_fx(0.0f), m_downscale(1)
+{
+
+}
+
+DepthBoardFinder::~DepthBoardFinder()
+{
+
+}
+
+void DepthBoardFinder::init(const cv::Size patternSize, const float patternLength, const float fx, const int downscale)
+{
+	// inner corners are one square short of the board in each direction
+	float boardWidth = (patternSize.width + 1) * patternLength;
+	float boardHeight = (patternSize.height + 1) * patternLength;
+	m_boardDiagonal = std::sqrt(boardWidth * boardWidth + boardHeight * boardHeight);
+	m_squareLength = patternLength;
+	m_fx = fx;
+	m_downscale = std::max(downscale, 1);
+}
+
+void DepthBoardFinder::findCandidates(const cv::Mat& depthMat, const cv::Size colorSize, std::vector<cv::Rect>& rois) const
+{
+	rois.clear();
+	if (depthMat.data == NULL || depthMat.type() != CV_16UC1 || m_fx <= 0 || m_boardDiagonal <= 0)
+		return;
+
+	cv::Mat smallDepth;
+	cv::resize(depthMat, smallDepth, cv::Size(depthMat.cols / m_downscale, depthMat.rows / m_downscale), 0, 0, cv::INTER_NEAREST);
+	if (smallDepth.cols < 2 || smallDepth.rows < 2)
+		return;
+
+	// smooth where the depth changes by less than depth / 32 towards both neighbours; missing depth is
+	// never smooth, its tolerance is 0
+	int w = smallDepth.cols - 1, h = smallDepth.rows - 1;
+	cv::Mat center = smallDepth(cv::Rect(0, 0, w, h));
+	cv::Mat tolerance = center * (1.0 / (1 << DEPTH_ROI_SMOOTH_SHIFT));
+	cv::Mat diffRight, diffDown, smoothRight, smoothDown, smoothMask;
+	cv::absdiff(center, smallDepth(cv::Rect(1, 0, w, h)), diffRight);
+	cv::absdiff(center, smallDepth(cv::Rect(0, 1, w, h)), diffDown);
+	cv::compare(diffRight, tolerance, smoothRight, cv::CMP_LT);
+	cv::compare(diffDown, tolerance, smoothDown, cv::CMP_LT);
+	cv::bitwise_and(smoothRight, smoothDown, smoothMask);
+
+	cv::Mat labels, stats, centroids;
+	int numLabel = cv::connectedComponentsWithStats(smoothMask, labels, stats, centroids, 4, CV_32S);
+
+	std::vector<Candidate> candidates;
+	for (int label = 1; label < numLabel; label++)
+	{
+		if (stats.at<int>(label, cv::CC_STAT_AREA) < DEPTH_ROI_MIN_AREA)
+			continue;
+
+		Candidate candidate;
+		candidate.box = cv::Rect(stats.at<int>(label, cv::CC_STAT_LEFT), stats.at<int>(label, cv::CC_STAT_TOP),
+			stats.at<int>(label, cv::CC_STAT_WIDTH), stats.at<int>(label, cv::CC_STAT_HEIGHT));
+		if (!_fitPlane(smallDepth, labels, label, candidate.box, candidate.depth))
+			continue;
+
+		// a tilted board only gets smaller, the extent is its diagonal on the downscaled frame
+		float boardPixels = m_boardDiagonal * m_fx / (candidate.depth / 1000.0f) / m_downscale;
+		float extent = std::sqrt((float) (candidate.box.width * candidate.box.width + candidate.box.height * candidate.box.height)) / boardPixels;
+		if (extent < DEPTH_ROI_MIN_EXTENT || extent > DEPTH_ROI_MAX_EXTENT)
+			continue;
+
+		candidate.fit = std::abs(std::log(extent));
+		candidates.push_back(candidate);
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+	if (candidates.size() > DEPTH_ROI_MAX_CANDIDATES)
+		candidates.resize(DEPTH_ROI_MAX_CANDIDATES);
+
+	// back to color pixels, padded by a board square and the downscale
+	float scale = (float) colorSize.width / depthMat.cols;
+	cv::Rect colorRect(0, 0, colorSize.width, colorSize.height);
+	for (int candidateId = 0; candidateId < candidates.size(); candidateId++)
+	{
+		const Candidate& candidate = candidates[candidateId];
+		int pad = (int) (m_squareLength * m_fx / (candidate.depth / 1000.0f)) + (int) (m_downscale * scale);
+		cv::Rect roi((int) (candidate.box.x * m_downscale * scale) - pad,
+			(int) (candidate.box.y * m_downscale * scale) - pad,
+			(int) ((candidate.box.width + 1) * m_downscale * scale) + 2 * pad,
+			(int) ((candidate.box.height + 1) * m_downscale * scale) + 2 * pad);
+		roi &= colorRect;
+		if (roi.area() > 0)
+			rois.push_back(roi);
+	}
+}
+
+bool DepthBoardFinder::_fitPlane(const cv::Mat& smallDepth, const cv::Mat& labels, const int label, const cv::Rect box, float& depth) const
+{
+	// least squares z = a * u + b * v + c over the blob, u and v relative to the box
+	double n = 0, su = 0, sv = 0, sz = 0, suu = 0, suv = 0, svv = 0, suz = 0, svz = 0;
+	for (int y = box.y; y < box.y + box.height; y++)
+	{
+		const ushort* depthRow = smallDepth.ptr<ushort>(y);
+		const int* labelRow = labels.ptr<int>(y);
+		double v = y - box.y;
+		for (int x = box.x; x < box.x + box.width; x++)
+		{
+			if (labelRow[x] != label)
+				continue;
+
+			double u = x - box.x, z = depthRow[x];
+			n++;
+			su += u;
+			sv += v;
+			sz += z;
+			suu += u * u;
+			suv += u * v;
+			svv += v * v;
+			suz += u * z;
+			svz += v * z;
+		}
+	}
+	if (n < 3)
+		return false;
+
+	// normal equations by Cramer's rule
+	double det = suu * (svv * n - sv * sv) - suv * (suv * n - sv * su) + su * (suv * sv - svv * su);
+	if (std::abs(det) < 1e-9)
+		return false;
+	double a = (suz * (svv * n - sv * sv) - suv * (svz * n - sv * sz) + su * (svz * sv - svv * sz)) / det;
+	double b = (suu * (svz * n - sz * sv) - suz * (suv * n - sv * su) + su * (suv * sz - svz * su)) / det;
+	double c = (suu * (svv * sz - sv * svz) - suv * (suv * sz - svz * su) + suz * (suv * sv - svv * su)) / det;
+
+	double squaredResidual = 0;
+	for (int y = box.y; y < box.y + box.height; y++)
+	{
+		const ushort* depthRow = smallDepth.ptr<ushort>(y);
+		const int* labelRow = labels.ptr<int>(y);
+		double v = y - box.y;
+		for (int x = box.x; x < box.x + box.width; x++)
+		{
+			if (labelRow[x] != label)
+				continue;
+
+			double residual = depthRow[x] - (a * (x - box.x) + b * v + c);
+			squaredResidual += residual * residual;
+		}
+	}
+
+	depth = (float) (sz / n);
+	return std::sqrt(squaredResidual / n) <= DEPTH_ROI_MAX_PLANE_RMS * depth;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+/* This class finds where the board can be from the registered depth frame.
+*
+* The board is a planar patch in front of the background, so its depth is
+* smooth inside and jumps at its border. On the depth frame downscaled by
+* nearest neighbour, pixels whose depth changes by less than a fraction of
+* itself towards their right and lower neighbours form connected blobs. A
+* blob is a candidate when its extent fits the board at the blob's depth and
+* a least squares plane fits its depth; the padded blob box in color pixels
+* is then all the checkerboard search has to look at.
+*/
+
+#pragma once
+
+#ifndef __DEPTH_BOARD_FINDER_H__
+#define __DEPTH_BOARD_FINDER_H__
+
+#include "MultiRGBDCalibrationUtil.h"
+
+#define DEPTH_ROI_SMOOTH_SHIFT 5 // neighbours closer than depth / 32 are smooth
+#define DEPTH_ROI_MIN_AREA 64 // pixels on the downscaled frame
+#define DEPTH_ROI_MIN_EXTENT 0.4f // blob diagonal over board diagonal
+#define DEPTH_ROI_MAX_EXTENT 2.0f // the white margin around the squares adds to the board
+#define DEPTH_ROI_MAX_PLANE_RMS 0.02f // of the depth
+#define DEPTH_ROI_MAX_CANDIDATES 4
+
+class DepthBoardFinder
+{
+public:
+	DepthBoardFinder();
+	virtual ~DepthBoardFinder();
+
+	// fx in color pixels, the depth is downscaled by downscale before the segmentation
+	void init(const cv::Size patternSize, const float patternLength, const float fx, const int downscale);
+
+	// called concurrently from the detection workers; padded color rois of the candidate blobs, best fitting first
+	void findCandidates(const cv::Mat& depthMat, const cv::Size colorSize, std::vector<cv::Rect>& rois) const;
+
+private:
+	struct Candidate
+	{
+		cv::Rect box;
+		float depth;
+		// distance of the extent from the board size, smaller fits better
+		float fit;
+
+		bool operator<(const Candidate& candidate) const
+		{
+			return fit < candidate.fit;
+		}
+	};
+
+	// mean depth in mm and plane fit of the blob, false if it isn't planar
+	bool _fitPlane(const cv::Mat& smallDepth, const cv::Mat& labels, const int label, const cv::Rect box, float& depth) const;
+
+	// board diagonal in meters
+	float m_boardDiagonal;
+	float m_squareLength;
+	float m_fx;
+	int m_downscale;
+};
+
+#endif//__DEPTH_BOARD_FINDER_H__
\ No newline at end of file
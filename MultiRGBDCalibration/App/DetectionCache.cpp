@@ -0,0 +1,142 @@
+#include "DetectionCache.h"
+
+#include <cstdio>
+
+struct DetectionCacheHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned long long settingsKey;
+	int colorWidth;
+	int colorHeight;
+	int numCorner;
+	int numEntry;
+};
+
+DetectionCache::DetectionCache() : m_settingsKey(0), m_numCorner(0)
+{
+
+}
+
+DetectionCache::~DetectionCache()
+{
+	clear();
+}
+
+void DetectionCache::clear()
+{
+	m_entries.clear();
+	m_settingsKey = 0;
+	m_numCorner = 0;
+	m_colorSize = cv::Size(0, 0);
+}
+
+void DetectionCache::init(const unsigned long long settingsKey, const cv::Size patternSize)
+{
+	clear();
+	m_settingsKey = settingsKey;
+	m_numCorner = patternSize.area();
+}
+
+bool DetectionCache::load(const std::string& filename, const unsigned long long settingsKey, const cv::Size patternSize)
+{
+	init(settingsKey, patternSize);
+
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (file == NULL)
+		return false;
+
+	DetectionCacheHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1
+		|| header.magic != DETECTION_CACHE_MAGIC || header.version != DETECTION_CACHE_VERSION
+		|| header.settingsKey != settingsKey || header.numCorner != m_numCorner || header.numEntry < 0)
+	{
+		fclose(file);
+		return false;
+	}
+
+	bool bValid = true;
+	for (int entryId = 0; entryId < header.numEntry && bValid; entryId++)
+	{
+		unsigned long long frameKey;
+		unsigned char bFound;
+		Entry entry;
+		bValid = fread(&frameKey, sizeof(frameKey), 1, file) == 1 && fread(&bFound, 1, 1, file) == 1;
+		entry.bFound = bFound != 0;
+		if (bValid && entry.bFound)
+		{
+			entry.corners.resize(m_numCorner);
+			bValid = fread(&entry.corners[0], sizeof(cv::Point2f), m_numCorner, file) == m_numCorner;
+		}
+		if (bValid)
+			m_entries[frameKey] = entry;
+	}
+	fclose(file);
+
+	// a truncated file is dropped as a whole, it is written again after the detection
+	if (!bValid)
+	{
+		printf("Detection cache %s is damaged, ignoring it\n", filename.c_str());
+		init(settingsKey, patternSize);
+		return false;
+	}
+
+	m_colorSize = cv::Size(header.colorWidth, header.colorHeight);
+	return true;
+}
+
+bool DetectionCache::save(const std::string& filename) const
+{
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (file == NULL)
+	{
+		printf("Couldn't write detection cache %s\n", filename.c_str());
+		return false;
+	}
+
+	DetectionCacheHeader header;
+	header.magic = DETECTION_CACHE_MAGIC;
+	header.version = DETECTION_CACHE_VERSION;
+	header.settingsKey = m_settingsKey;
+	header.colorWidth = m_colorSize.width;
+	header.colorHeight = m_colorSize.height;
+	header.numCorner = m_numCorner;
+	header.numEntry = (int) m_entries.size();
+
+	bool bSuccess = fwrite(&header, sizeof(header), 1, file) == 1;
+	for (std::map<unsigned long long, Entry>::const_iterator it = m_entries.begin(); bSuccess && it != m_entries.end(); it++)
+	{
+		unsigned char bFound = it->second.bFound ? 1 : 0;
+		bSuccess = fwrite(&it->first, sizeof(it->first), 1, file) == 1 && fwrite(&bFound, 1, 1, file) == 1;
+		if (bSuccess && bFound)
+			bSuccess = fwrite(&it->second.corners[0], sizeof(cv::Point2f), m_numCorner, file) == m_numCorner;
+	}
+	if (fclose(file) != 0)
+		bSuccess = false;
+
+	if (!bSuccess)
+		printf("Writing detection cache %s failed!\n", filename.c_str());
+	return bSuccess;
+}
+
+bool DetectionCache::find(const unsigned long long frameKey, bool& bFound, corner2d_t& corners) const
+{
+	std::map<unsigned long long, Entry>::const_iterator it = m_entries.find(frameKey);
+	if (it == m_entries.end())
+		return false;
+
+	bFound = it->second.bFound;
+	corners = it->second.corners;
+	return true;
+}
+
+void DetectionCache::add(const unsigned long long frameKey, const bool bFound, const corner2d_t& corners)
+{
+	// a found board has to have all its corners
+	if (bFound && corners.size() != m_numCorner)
+		return;
+
+	Entry& entry = m_entries[frameKey];
+	entry.bFound = bFound;
+	entry.corners = bFound ? corners : corner2d_t();
+}
\ No newline at end of file
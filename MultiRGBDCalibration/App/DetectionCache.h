@@ -0,0 +1,76 @@
+/* This class keeps the checkerboard detections of one camera on disk between runs.
+*
+* An entry holds the result of one frame, whether the board was found and its
+* corners, and is looked up by the content key of the color frame, so a frame
+* is recognized as long as its file is unchanged. The file as a whole belongs
+* to a settings key over the pattern and every detection parameter that can
+* change a result; a file of another settings key or version is ignored and
+* replaced when the detections are saved.
+*
+* The file is binary: magic, version, settings key, color frame size, corners
+* per board and num. of entries, then per entry the frame key, a found byte
+* and, for a found board, the corners as float x, y.
+*/
+
+#pragma once
+
+#ifndef __DETECTION_CACHE_H__
+#define __DETECTION_CACHE_H__
+
+#include <map>
+
+#include "MultiRGBDCalibrationUtil.h"
+
+#define DETECTION_CACHE_MAGIC 0x43445242 // "BRDC"
+#define DETECTION_CACHE_VERSION 1
+
+class DetectionCache
+{
+public:
+	DetectionCache();
+	virtual ~DetectionCache();
+
+	void clear();
+	// start an empty cache for the settings
+	void init(const unsigned long long settingsKey, const cv::Size patternSize);
+
+	// false, leaving the cache empty, if the file is missing, damaged or of other settings
+	bool load(const std::string& filename, const unsigned long long settingsKey, const cv::Size patternSize);
+	bool save(const std::string& filename) const;
+
+	// false if the frame isn't in the cache
+	bool find(const unsigned long long frameKey, bool& bFound, corner2d_t& corners) const;
+	bool contains(const unsigned long long frameKey) const
+	{
+		return m_entries.find(frameKey) != m_entries.end();
+	}
+	void add(const unsigned long long frameKey, const bool bFound, const corner2d_t& corners);
+
+	void setColorSize(const cv::Size colorSize)
+	{
+		m_colorSize = colorSize;
+	}
+	cv::Size getColorSize() const
+	{
+		return m_colorSize;
+	}
+	int getNumEntry() const
+	{
+		return (int) m_entries.size();
+	}
+
+private:
+	struct Entry
+	{
+		bool bFound;
+		corner2d_t corners;
+	};
+
+	unsigned long long m_settingsKey;
+	int m_numCorner;
+	cv::Size m_colorSize;
+	// by frame key
+	std::map<unsigned long long, Entry> m_entries;
+};
+
+#endif//__DETECTION_CACHE_H__
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "FrameDecodePool.h"
+
+FrameDecodePool::FrameDecodePool()
+{
+	resetStats();
+}
+
+FrameDecodePool::~FrameDecodePool()
+{
+	clear();
+}
+
+void FrameDecodePool::init(int numThreads)
+{
+	m_threadPool.init(numThreads);
+	resetStats();
+}
+
+void FrameDecodePool::clear()
+{
+	m_threadPool.clear();
+}
+
+void FrameDecodePool::requestRead(FrameSource* source, const int frameId, const FrameSource::FRAME_PLANE plane,
+	cv::Mat* dst, const std::function<void()>& onDecoded)
+{
+	if (m_startTick == 0)
+		m_startTick = cv::getTickCount();
+
+	m_threadPool.enqueue(std::bind(&FrameDecodePool::_read, this, source, frameId, plane, dst, onDecoded));
+}
+
+void FrameDecodePool::wait()
+{
+	m_threadPool.wait();
+	m_endTick = cv::getTickCount();
+}
+
+void FrameDecodePool::resetStats()
+{
+	m_startTick = 0;
+	m_endTick = 0;
+	m_numFrame = 0;
+	m_numFailedFrame = 0;
+	m_numByteRead = 0;
+	m_numByteDecoded = 0;
+}
+
+void FrameDecodePool::printStats()
+{
+	double seconds = (m_endTick - m_startTick) / cv::getTickFrequency();
+	if (m_startTick == 0 || seconds <= 0)
+		return;
+
+	double mbRead = m_numByteRead / (1024.0 * 1024.0);
+	double mbDecoded = m_numByteDecoded / (1024.0 * 1024.0);
+
+	printf("Decoded %d frames (%d failed) in %.2f s with %d threads\n",
+		(int) m_numFrame, (int) m_numFailedFrame, seconds, getNumThreads());
+	printf("  %.1f frames/s, %.1f MB/s read, %.1f MB/s decoded\n",
+		m_numFrame / seconds, mbRead / seconds, mbDecoded / seconds);
+}
+
+void FrameDecodePool::_read(FrameSource* source, const int frameId, const FrameSource::FRAME_PLANE plane,
+	cv::Mat* dst, const std::function<void()>& onDecoded)
+{
+	size_t numByteRead = 0;
+	source->read(frameId, plane, *dst, numByteRead);
+
+	m_numFrame++;
+	m_numByteRead += (long long) numByteRead;
+
+	if (dst->data != NULL)
+		m_numByteDecoded += (long long) (dst->total() * dst->elemSize());
+	else
+		m_numFailedFrame++;
+
+	if (onDecoded)
+		onDecoded();
+}
\ No newline at end of file
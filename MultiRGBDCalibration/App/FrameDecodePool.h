@@ -0,0 +1,57 @@
+/* This class decodes the frames of all rgbd cameras on a shared thread pool. */
+
+#pragma once
+
+#ifndef __FRAME_DECODE_POOL_H__
+#define __FRAME_DECODE_POOL_H__
+
+#include <atomic>
+#include <functional>
+#include <string>
+
+#include "MultiRGBDCalibrationUtil.h"
+#include "FrameSource.h"
+#include "..\Utility\ThreadPool.h"
+
+class FrameDecodePool
+{
+public:
+	FrameDecodePool();
+	virtual ~FrameDecodePool();
+
+	// numThreads <= 0 uses one worker per hardware thread
+	void init(int numThreads);
+	void clear();
+
+	// queue a read of one frame plane into dst; dst is left empty when the frame cannot be decoded.
+	// onDecoded runs on the same worker right after the read, while the plane is still in cache.
+	void requestRead(FrameSource* source, const int frameId, const FrameSource::FRAME_PLANE plane,
+		cv::Mat* dst, const std::function<void()>& onDecoded = std::function<void()>());
+
+	// block until all requested frames are decoded
+	void wait();
+
+	void resetStats();
+	void printStats();
+
+	int getNumThreads() const
+	{
+		return m_threadPool.getNumThreads();
+	}
+
+private:
+	void _read(FrameSource* source, const int frameId, const FrameSource::FRAME_PLANE plane,
+		cv::Mat* dst, const std::function<void()>& onDecoded);
+
+	ThreadPool m_threadPool;
+
+	/* ----- Statistics ----- */
+	int64 m_startTick;
+	int64 m_endTick;
+	std::atomic<int> m_numFrame;
+	std::atomic<int> m_numFailedFrame;
+	std::atomic<long long> m_numByteRead;
+	std::atomic<long long> m_numByteDecoded;
+};
+
+#endif//__FRAME_DECODE_POOL_H__
\ No newline at end of file
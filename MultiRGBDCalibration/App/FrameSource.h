@@ -0,0 +1,57 @@
+/* This class is the interface to the storage the frames of one rgbd camera are read from. */
+
+#pragma once
+
+#ifndef __FRAME_SOURCE_H__
+#define __FRAME_SOURCE_H__
+
+#include <string>
+
+#include "MultiRGBDCalibrationUtil.h"
+
+class FrameSource
+{
+public:
+	enum FRAME_PLANE{COLOR, DEPTH};
+
+	virtual ~FrameSource() {}
+
+	virtual int getNumFrame() const = 0;
+
+	// read one plane of a frame into dst, color as 8-bit BGR (grayscale after setGrayColor(true))
+	// and depth as 16-bit unsigned short.
+	// Decodes into the buffer of dst when it already has the size and type of the frame, and
+	// releases dst on failure. numByteRead returns the bytes taken from storage.
+	// Called concurrently from the decode threads.
+	virtual bool read(const int frameId, const FRAME_PLANE plane, cv::Mat& dst, size_t& numByteRead) = 0;
+
+	// decode the color plane straight to 8-bit grayscale, set before the first read.
+	// Returns false if the source can't, its color plane then stays BGR.
+	virtual bool setGrayColor(const bool bGray)
+	{
+		return !bGray;
+	}
+
+	// hint that read() will soon be called for the frame plane, in about the order of the hints
+	virtual void prefetch(const int frameId, const FRAME_PLANE plane)
+	{
+	}
+
+	// true if read() returns views into storage owned by the source instead of decoding
+	virtual bool isZeroCopy() const
+	{
+		return false;
+	}
+
+	// identifies the stored content of a frame plane without decoding it, e.g. by the size and
+	// modification time of its file; false if the source can't tell, the frame is then never cached
+	virtual bool getContentKey(const int frameId, const FRAME_PLANE plane, unsigned long long& key) const
+	{
+		return false;
+	}
+
+	// name of a frame plane for messages
+	virtual std::string getName(const int frameId, const FRAME_PLANE plane) const = 0;
+};
+
+#endif//__FRAME_SOURCE_H__
\ No newline at end of file
@@ -0,0 +1,427 @@
+#include "FrameStore.h"
+
+#include <climits>
+
+#define FRAME_PLANE_ALIGNMENT 64 // bytes
+
+FrameStore::FrameStore() : m_source(NULL), m_budgetBytes(0), m_residentBytes(0), m_peakResidentBytes(0),
+	m_totalAccountedBytes(0), m_numAccountedFrame(0), m_useCounter(0), m_bArena(false),
+	m_bGrayDecode(false), m_bGrayColor(false),
+	m_bCompressDepth(false), m_depthBandHeight(16), m_rawDepthBytes(0), m_compressedDepthBytes(0),
+	m_depthEncodeTicks(0), m_numEncodedDepth(0), m_depthDecodeTicks(0), m_numDecodedDepthRows(0)
+{
+
+}
+
+FrameStore::~FrameStore()
+{
+	clear();
+}
+
+void FrameStore::clear()
+{
+	m_color.clear();
+	m_gray.clear();
+	m_depth.clear();
+	m_compressedDepth.clear();
+	m_colorState.clear();
+	m_depthState.clear();
+	m_frameBytes.clear();
+	m_lastUse.clear();
+
+	m_arena.reset();
+	m_bArena = false;
+	m_bGrayColor = false;
+
+	if (m_source != NULL)
+	{
+		delete m_source;
+		m_source = NULL;
+	}
+
+	m_budgetBytes = 0;
+	m_residentBytes = 0;
+	m_peakResidentBytes = 0;
+	m_totalAccountedBytes = 0;
+	m_numAccountedFrame = 0;
+	m_useCounter = 0;
+	m_colorSize = cv::Size(0, 0);
+
+	m_rawDepthBytes = 0;
+	m_compressedDepthBytes = 0;
+	m_depthEncodeTicks = 0;
+	m_numEncodedDepth = 0;
+	m_depthDecodeTicks = 0;
+	m_numDecodedDepthRows = 0;
+}
+
+void FrameStore::init(FrameSource* source, const size_t budgetBytes)
+{
+	clear();
+
+	m_source = source;
+	m_budgetBytes = budgetBytes;
+
+	int numFrame = source->getNumFrame();
+	m_color.resize(numFrame);
+	m_gray.resize(numFrame);
+	m_depth.resize(numFrame);
+	if (m_bCompressDepth)
+		m_compressedDepth.resize(numFrame);
+	m_colorState.resize(numFrame, EMPTY);
+	m_depthState.resize(numFrame, EMPTY);
+	m_frameBytes.resize(numFrame, 0);
+	m_lastUse.resize(numFrame, 0);
+
+	m_bGrayColor = m_bGrayDecode && source->setGrayColor(true);
+
+	// zero-copy sources already hand out views into their own storage
+	if (!isStreaming() && !source->isZeroCopy())
+		_initArena();
+}
+
+void FrameStore::setDepthCompression(const bool bCompress, const int bandHeight)
+{
+	m_bCompressDepth = bCompress;
+	m_depthBandHeight = bandHeight;
+}
+
+void FrameStore::requestFrames(const int frameStart, const int frameEnd, FrameDecodePool& decodePool, const bool bColor)
+{
+	// make room for the whole window before any decode starts
+	_evict(getFrameBytes() * (frameEnd - frameStart), frameStart, frameEnd);
+
+	for (int frameId = frameStart; frameId < frameEnd; frameId++)
+	{
+		// read ahead in the order the decode threads take the frames
+		if (bColor && m_colorState[frameId] == EMPTY)
+			m_source->prefetch(frameId, FrameSource::COLOR);
+		if (m_depthState[frameId] == EMPTY)
+			m_source->prefetch(frameId, FrameSource::DEPTH);
+
+		if (bColor && m_colorState[frameId] == EMPTY)
+		{
+			m_colorState[frameId] = REQUESTED;
+			decodePool.requestRead(m_source, frameId, FrameSource::COLOR, &m_color[frameId],
+				(m_bArena && !m_bGrayColor) ? std::bind(&FrameStore::_convertGray, this, frameId) : std::function<void()>());
+		}
+		if (m_depthState[frameId] == EMPTY)
+		{
+			m_depthState[frameId] = REQUESTED;
+			decodePool.requestRead(m_source, frameId, FrameSource::DEPTH, &m_depth[frameId],
+				m_bCompressDepth ? std::bind(&FrameStore::_compressDepth, this, frameId) : std::function<void()>());
+		}
+	}
+}
+
+void FrameStore::checkFrames(const int frameStart, const int frameEnd)
+{
+	for (int frameId = frameStart; frameId < frameEnd; frameId++)
+	{
+		if (m_colorState[frameId] != REQUESTED)
+			continue;
+
+		if (m_color[frameId].data != NULL)
+			m_colorState[frameId] = LOADED;
+		else {
+			m_colorState[frameId] = FAILED;
+			printf("Loading color frame %d failed! - %s\n", frameId, m_source->getName(frameId, FrameSource::COLOR).c_str());
+		}
+	}
+
+	for (int frameId = frameStart; frameId < frameEnd; frameId++)
+	{
+		if (m_depthState[frameId] != REQUESTED)
+			continue;
+
+		if (_hasDepth(frameId))
+		{
+			m_depthState[frameId] = LOADED;
+			_accountCompression(frameId);
+		}
+		else {
+			m_depthState[frameId] = FAILED;
+			printf("Loading depth frame %d failed! - %s\n", frameId, m_source->getName(frameId, FrameSource::DEPTH).c_str());
+		}
+	}
+
+	for (int frameId = frameStart; frameId < frameEnd; frameId++)
+	{
+		m_lastUse[frameId] = ++m_useCounter;
+		_account(frameId);
+	}
+}
+
+void FrameStore::releaseFrames(const int frameStart, const int frameEnd)
+{
+	for (int frameId = frameStart; frameId < frameEnd; frameId++)
+	{
+		// slab views are kept and simply overwritten by the next decode
+		if (!m_bArena)
+		{
+			m_color[frameId].release();
+			m_gray[frameId].release();
+			m_depth[frameId].release();
+		}
+		if (m_bCompressDepth)
+			m_compressedDepth[frameId].clear();
+
+		if (m_colorState[frameId] == LOADED)
+			m_colorState[frameId] = EMPTY;
+		if (m_depthState[frameId] == LOADED)
+			m_depthState[frameId] = EMPTY;
+
+		_account(frameId);
+	}
+}
+
+cv::Mat FrameStore::getColor(const int frameId)
+{
+	if (m_colorState[frameId] == EMPTY)
+		_fetch(frameId, FrameSource::COLOR);
+
+	m_lastUse[frameId] = ++m_useCounter;
+	return (m_colorState[frameId] == LOADED) ? m_color[frameId] : cv::Mat();
+}
+
+cv::Mat FrameStore::getGray(const int frameId)
+{
+	cv::Mat colorMat = getColor(frameId);
+	if (colorMat.data == NULL)
+		return cv::Mat();
+
+	if (m_bGrayColor)
+		return colorMat;
+	// the slab keeps a grayscale plane converted right after decoding
+	if (m_bArena)
+		return m_gray[frameId];
+
+	cv::Mat grayMat;
+	cv::cvtColor(colorMat, grayMat, CV_RGB2GRAY);
+	return grayMat;
+}
+
+cv::Mat FrameStore::getDepth(const int frameId)
+{
+	return getDepthRows(frameId, 0, INT_MAX);
+}
+
+cv::Mat FrameStore::getDepthRows(const int frameId, const int rowStart, const int rowEnd)
+{
+	if (m_depthState[frameId] == EMPTY)
+		_fetch(frameId, FrameSource::DEPTH);
+
+	m_lastUse[frameId] = ++m_useCounter;
+	if (m_depthState[frameId] != LOADED)
+		return cv::Mat();
+	if (!m_bCompressDepth)
+		return m_depth[frameId];
+
+	// decompress into a fresh matrix so the caller owns it
+	const RVLDepthFrame& compressed = m_compressedDepth[frameId];
+	int64 startTick = cv::getTickCount();
+	cv::Mat depthMat;
+	compressed.decompressRows(rowStart, rowEnd, depthMat);
+	m_depthDecodeTicks += cv::getTickCount() - startTick;
+	m_numDecodedDepthRows += std::max(std::min(rowEnd, compressed.getRows()) - std::max(rowStart, 0), 0);
+
+	return depthMat;
+}
+
+void FrameStore::printDepthCompressionStats() const
+{
+	if (!m_bCompressDepth || m_numEncodedDepth == 0 || m_compressedDepthBytes == 0)
+		return;
+
+	double tickPerMs = cv::getTickFrequency() / 1000.0;
+	int rows = 0;
+	for (int frameId = 0; frameId < getNumFrame() && rows == 0; frameId++)
+		rows = m_compressedDepth[frameId].getRows();
+
+	printf("Depth compression: %.1f MB -> %.1f MB (%.2fx), %.2f ms/frame encode",
+		m_rawDepthBytes / (1024.0 * 1024.0), m_compressedDepthBytes / (1024.0 * 1024.0),
+		(double) m_rawDepthBytes / m_compressedDepthBytes, m_depthEncodeTicks / tickPerMs / m_numEncodedDepth);
+	// decode time is scaled to a full frame since most accesses only decode a few bands
+	if (m_numDecodedDepthRows > 0 && rows > 0)
+		printf(", %.2f ms/frame decode", m_depthDecodeTicks / tickPerMs / m_numDecodedDepthRows * rows);
+	printf("\n");
+}
+
+void FrameStore::_initArena()
+{
+	int numFrame = getNumFrame();
+
+	// the first readable frame gives the plane sizes
+	cv::Mat colorMat, depthMat;
+	size_t numByteRead = 0;
+	int probeFrameId = 0;
+	for (; probeFrameId < numFrame; probeFrameId++)
+	{
+		if (m_source->read(probeFrameId, FrameSource::COLOR, colorMat, numByteRead)
+			&& m_source->read(probeFrameId, FrameSource::DEPTH, depthMat, numByteRead))
+			break;
+	}
+	if (probeFrameId == numFrame)
+		return;
+
+	size_t colorBytes = colorMat.total() * colorMat.elemSize();
+	size_t grayBytes = m_bGrayColor ? 0 : colorMat.total();
+	size_t depthBytes = m_bCompressDepth ? 0 : depthMat.total() * depthMat.elemSize();
+	size_t frameBytes = 0;
+	frameBytes += (colorBytes + FRAME_PLANE_ALIGNMENT - 1) / FRAME_PLANE_ALIGNMENT * FRAME_PLANE_ALIGNMENT;
+	frameBytes += (grayBytes + FRAME_PLANE_ALIGNMENT - 1) / FRAME_PLANE_ALIGNMENT * FRAME_PLANE_ALIGNMENT;
+	frameBytes += (depthBytes + FRAME_PLANE_ALIGNMENT - 1) / FRAME_PLANE_ALIGNMENT * FRAME_PLANE_ALIGNMENT;
+
+	if (!m_arena.reserve(frameBytes * numFrame))
+	{
+		printf("Couldn't allocate a %.1f MB frame slab, using the heap\n", frameBytes * numFrame / (1024.0 * 1024.0));
+		return;
+	}
+
+	// planes of one kind are contiguous so each stage walks the slab front to back
+	for (int frameId = 0; frameId < numFrame; frameId++)
+		m_color[frameId] = cv::Mat(colorMat.rows, colorMat.cols, colorMat.type(), m_arena.allocate(colorBytes, FRAME_PLANE_ALIGNMENT));
+	for (int frameId = 0; frameId < numFrame && grayBytes > 0; frameId++)
+		m_gray[frameId] = cv::Mat(colorMat.rows, colorMat.cols, CV_8UC1, m_arena.allocate(grayBytes, FRAME_PLANE_ALIGNMENT));
+	for (int frameId = 0; frameId < numFrame && depthBytes > 0; frameId++)
+		m_depth[frameId] = cv::Mat(depthMat.rows, depthMat.cols, depthMat.type(), m_arena.allocate(depthBytes, FRAME_PLANE_ALIGNMENT));
+	m_bArena = true;
+
+	printf("Frame slab %.1f MB (%s pages)\n", m_arena.getCapacity() / (1024.0 * 1024.0),
+		m_arena.isHugePage() ? "huge" : "normal");
+
+	// keep the probed frame
+	colorMat.copyTo(m_color[probeFrameId]);
+	if (grayBytes > 0)
+		cv::cvtColor(colorMat, m_gray[probeFrameId], CV_RGB2GRAY);
+	depthMat.copyTo(m_depth[probeFrameId]);
+	if (m_bCompressDepth)
+		_compressDepth(probeFrameId);
+	m_colorState[probeFrameId] = LOADED;
+	m_depthState[probeFrameId] = LOADED;
+	_accountCompression(probeFrameId);
+	_account(probeFrameId);
+}
+
+void FrameStore::_convertGray(const int frameId)
+{
+	// convert while the color plane is still in cache
+	if (m_color[frameId].data != NULL)
+		cv::cvtColor(m_color[frameId], m_gray[frameId], CV_RGB2GRAY);
+}
+
+void FrameStore::_compressDepth(const int frameId)
+{
+	if (m_depth[frameId].data == NULL)
+		return;
+
+	m_compressedDepth[frameId].compress(m_depth[frameId], m_depthBandHeight);
+	m_depth[frameId].release();
+}
+
+bool FrameStore::_hasDepth(const int frameId) const
+{
+	return m_bCompressDepth ? !m_compressedDepth[frameId].empty() : m_depth[frameId].data != NULL;
+}
+
+void FrameStore::_accountCompression(const int frameId)
+{
+	if (!m_bCompressDepth)
+		return;
+
+	const RVLDepthFrame& compressed = m_compressedDepth[frameId];
+	m_rawDepthBytes += (long long) compressed.getRawBytes();
+	m_compressedDepthBytes += (long long) compressed.getCompressedBytes();
+	m_depthEncodeTicks += compressed.getCompressTicks();
+	m_numEncodedDepth++;
+}
+
+void FrameStore::_fetch(const int frameId, const FrameSource::FRAME_PLANE plane)
+{
+	size_t numByteRead = 0;
+
+	if (plane == FrameSource::COLOR)
+	{
+		if (m_source->read(frameId, FrameSource::COLOR, m_color[frameId], numByteRead))
+		{
+			m_colorState[frameId] = LOADED;
+			if (m_bArena && !m_bGrayColor)
+				cv::cvtColor(m_color[frameId], m_gray[frameId], CV_RGB2GRAY);
+		}
+		else {
+			m_colorState[frameId] = FAILED;
+			printf("Loading color frame %d failed! - %s\n", frameId, m_source->getName(frameId, FrameSource::COLOR).c_str());
+		}
+	}
+	else {
+		if (m_source->read(frameId, FrameSource::DEPTH, m_depth[frameId], numByteRead))
+		{
+			if (m_bCompressDepth)
+				_compressDepth(frameId);
+			m_depthState[frameId] = LOADED;
+			_accountCompression(frameId);
+		}
+		else {
+			m_depthState[frameId] = FAILED;
+			printf("Loading depth frame %d failed! - %s\n", frameId, m_source->getName(frameId, FrameSource::DEPTH).c_str());
+		}
+	}
+
+	_account(frameId);
+	_evict(0, frameId, frameId + 1);
+}
+
+void FrameStore::_account(const int frameId)
+{
+	size_t bytes = 0;
+	if (m_colorState[frameId] == LOADED)
+	{
+		bytes += m_color[frameId].total() * m_color[frameId].elemSize();
+		if (m_bArena && !m_bGrayColor)
+			bytes += m_gray[frameId].total();
+		if (m_colorSize.area() == 0)
+			m_colorSize = m_color[frameId].size();
+	}
+	if (m_depthState[frameId] == LOADED)
+	{
+		if (m_bCompressDepth)
+			bytes += m_compressedDepth[frameId].getCompressedBytes();
+		else
+			bytes += m_depth[frameId].total() * m_depth[frameId].elemSize();
+	}
+
+	// the average frame size is measured on complete frames only
+	if (m_frameBytes[frameId] == 0 && m_colorState[frameId] == LOADED && m_depthState[frameId] == LOADED)
+	{
+		m_totalAccountedBytes += bytes;
+		m_numAccountedFrame++;
+	}
+
+	m_residentBytes = m_residentBytes - m_frameBytes[frameId] + bytes;
+	m_frameBytes[frameId] = bytes;
+	if (m_residentBytes > m_peakResidentBytes)
+		m_peakResidentBytes = m_residentBytes;
+}
+
+void FrameStore::_evict(const size_t requiredBytes, const int keepStart, const int keepEnd)
+{
+	if (!isStreaming())
+		return;
+
+	// drop the least recently used frames until the store fits into the budget
+	while (m_residentBytes + requiredBytes > m_budgetBytes)
+	{
+		int lruFrameId = -1;
+		for (int frameId = 0; frameId < getNumFrame(); frameId++)
+		{
+			if ((frameId >= keepStart && frameId < keepEnd) || m_frameBytes[frameId] == 0)
+				continue;
+			if (lruFrameId < 0 || m_lastUse[frameId] < m_lastUse[lruFrameId])
+				lruFrameId = frameId;
+		}
+		if (lruFrameId < 0)
+			break;
+
+		releaseFrames(lruFrameId, lruFrameId + 1);
+	}
+}
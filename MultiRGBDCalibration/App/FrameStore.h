@@ -0,0 +1,149 @@
+/* This class keeps the decoded color and depth frames of one rgbd camera.
+*
+* With a zero budget every frame stays resident once it is loaded. The color,
+* grayscale and depth planes of all frames then live in one slab, each kind of
+* plane stored contiguously in frame order. With a non-zero budget the store
+* only keeps as many frames as fit into the budget, evicting the least recently
+* used ones, and re-decodes evicted frames when they are requested again.
+*
+* Depth frames can be kept RVL-compressed instead; they are then compressed by
+* the decode workers and only decompressed, or partly decompressed, on access.
+*
+* With gray decoding the color plane is decoded straight to grayscale where the
+* source supports it; getColor() and getGray() then return the same plane.
+*/
+
+#pragma once
+
+#ifndef __FRAME_STORE_H__
+#define __FRAME_STORE_H__
+
+#include "MultiRGBDCalibrationUtil.h"
+#include "FrameDecodePool.h"
+#include "FrameSource.h"
+#include "RVLDepthFrame.h"
+#include "..\Utility\FrameArena.h"
+
+class FrameStore
+{
+public:
+	FrameStore();
+	virtual ~FrameStore();
+
+	// release the frames; the slab is kept for the next init()
+	void clear();
+	// the store takes ownership of source
+	void init(FrameSource* source, const size_t budgetBytes = 0);
+	// keep depth frames RVL-compressed in bands of bandHeight rows, set before init()
+	void setDepthCompression(const bool bCompress, const int bandHeight = 16);
+	// decode the color plane as grayscale, set before init()
+	void setGrayDecode(const bool bGray)
+	{
+		m_bGrayDecode = bGray;
+	}
+
+	// queue the frames [frameStart, frameEnd) on the decode pool, only their depth planes without bColor
+	void requestFrames(const int frameStart, const int frameEnd, FrameDecodePool& decodePool, const bool bColor = true);
+	// report failed frames in order after the decode pool has finished
+	void checkFrames(const int frameStart, const int frameEnd);
+	// drop the pixels of the frames [frameStart, frameEnd)
+	void releaseFrames(const int frameStart, const int frameEnd);
+
+	// return the frame, decoding it again if it has been evicted
+	cv::Mat getColor(const int frameId);
+	cv::Mat getGray(const int frameId);
+	cv::Mat getDepth(const int frameId);
+	// return the depth frame with at least the rows [rowStart, rowEnd) valid
+	cv::Mat getDepthRows(const int frameId, const int rowStart, const int rowEnd);
+
+	void printDepthCompressionStats() const;
+
+	int getNumFrame() const
+	{
+		return (int) m_color.size();
+	}
+	bool isStreaming() const
+	{
+		return m_budgetBytes > 0;
+	}
+	// getGray() returns a stored plane instead of converting on every call
+	bool hasGrayPlane() const
+	{
+		return m_bArena || m_bGrayColor;
+	}
+	// the color plane is grayscale
+	bool isGrayColor() const
+	{
+		return m_bGrayColor;
+	}
+	cv::Size getColorSize() const
+	{
+		return m_colorSize;
+	}
+	// average bytes of a color + depth frame, 0 until a frame has been loaded
+	size_t getFrameBytes() const
+	{
+		return m_numAccountedFrame > 0 ? (size_t) (m_totalAccountedBytes / m_numAccountedFrame) : 0;
+	}
+	size_t getResidentBytes() const
+	{
+		return m_residentBytes;
+	}
+	size_t getPeakResidentBytes() const
+	{
+		return m_peakResidentBytes;
+	}
+
+private:
+	enum PLANE_STATE{EMPTY, REQUESTED, LOADED, FAILED};
+
+	void _initArena();
+	// run on the decode workers
+	void _convertGray(const int frameId);
+	void _compressDepth(const int frameId);
+	bool _hasDepth(const int frameId) const;
+	void _accountCompression(const int frameId);
+	void _fetch(const int frameId, const FrameSource::FRAME_PLANE plane);
+	void _account(const int frameId);
+	// evict until requiredBytes more fit, keeping the frames [keepStart, keepEnd)
+	void _evict(const size_t requiredBytes, const int keepStart, const int keepEnd);
+
+	FrameSource* m_source;
+
+	size_t m_budgetBytes;
+	size_t m_residentBytes;
+	size_t m_peakResidentBytes;
+	long long m_totalAccountedBytes;
+	int m_numAccountedFrame;
+	long long m_useCounter;
+	cv::Size m_colorSize;
+
+	// planes are views into the slab when m_bArena is set
+	FrameArena m_arena;
+	bool m_bArena;
+
+	bool m_bGrayDecode;
+	// m_bGrayDecode and supported by the source
+	bool m_bGrayColor;
+
+	bool m_bCompressDepth;
+	int m_depthBandHeight;
+	long long m_rawDepthBytes;
+	long long m_compressedDepthBytes;
+	int64 m_depthEncodeTicks;
+	int m_numEncodedDepth;
+	int64 m_depthDecodeTicks;
+	long long m_numDecodedDepthRows;
+
+	// frameId
+	std::vector<cv::Mat> m_color;
+	std::vector<cv::Mat> m_gray;
+	std::vector<cv::Mat> m_depth;
+	std::vector<RVLDepthFrame> m_compressedDepth;
+	std::vector<unsigned char> m_colorState;
+	std::vector<unsigned char> m_depthState;
+	std::vector<size_t> m_frameBytes;
+	std::vector<long long> m_lastUse;
+};
+
+#endif//__FRAME_STORE_H__
@@ -0,0 +1,98 @@
+#include "ImageFileFrameSource.h"
+#include "..\Utility\ContentKey.h"
+
+ImageFileFrameSource::ImageFileFrameSource(const std::vector<std::string>& colorFilenames,
+	const std::vector<std::string>& depthFilenames,
+	AsyncFileReader* fileReader)
+	: m_colorFilenames(colorFilenames), m_depthFilenames(depthFilenames), m_bPattern(false), m_bGrayColor(false), m_fileReader(fileReader)
+{
+
+}
+
+ImageFileFrameSource::ImageFileFrameSource(const std::string& colorFolder, const FramePattern& colorPattern,
+	const std::string& depthFolder, const FramePattern& depthPattern,
+	const FrameSet& frameSet,
+	AsyncFileReader* fileReader)
+	: m_bPattern(true), m_colorFolder(colorFolder), m_depthFolder(depthFolder),
+	m_colorPattern(colorPattern), m_depthPattern(depthPattern), m_frameSet(frameSet), m_bGrayColor(false), m_fileReader(fileReader)
+{
+
+}
+
+ImageFileFrameSource::~ImageFileFrameSource()
+{
+
+}
+
+bool ImageFileFrameSource::read(const int frameId, const FRAME_PLANE plane, cv::Mat& dst, size_t& numByteRead)
+{
+	std::string filename = getName(frameId, plane);
+
+	numByteRead = 0;
+	if (filename.empty())
+	{
+		dst.release();
+		return false;
+	}
+
+	// read the whole file first so the read and decode volumes can be reported
+	std::vector<uchar> buffer;
+	if (m_fileReader != NULL)
+		m_fileReader->read(filename, buffer);
+	else
+		AsyncFileReader::readFile(filename, buffer);
+
+	numByteRead = buffer.size();
+
+	cv::Mat decoded;
+	if (!buffer.empty())
+	{
+		if (plane == COLOR)
+			decoded = cv::imdecode(buffer, m_bGrayColor ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR, &dst);
+		else
+			decoded = cv::imdecode(buffer, CV_LOAD_IMAGE_ANYDEPTH, &dst); // 16-bit unsigned short
+	}
+
+	if (decoded.data == NULL)
+	{
+		dst.release();
+		return false;
+	}
+	return true;
+}
+
+void ImageFileFrameSource::prefetch(const int frameId, const FRAME_PLANE plane)
+{
+	if (m_fileReader == NULL)
+		return;
+
+	std::string filename = getName(frameId, plane);
+	if (!filename.empty())
+		m_fileReader->prefetch(filename);
+}
+
+bool ImageFileFrameSource::getContentKey(const int frameId, const FRAME_PLANE plane, unsigned long long& key) const
+{
+	std::string filename = getName(frameId, plane);
+	return !filename.empty() && getFileContentKey(filename, key);
+}
+
+std::string ImageFileFrameSource::getName(const int frameId, const FRAME_PLANE plane) const
+{
+	if (m_bPattern)
+	{
+		if (frameId < 0 || frameId >= m_frameSet.getNumFrame())
+			return "";
+
+		int frameNumber = m_frameSet.getFrameNumber(frameId);
+		if (plane == COLOR)
+			return m_colorFolder + "/" + m_colorPattern.format(frameNumber);
+		return m_depthFolder + "/" + m_depthPattern.format(frameNumber);
+	}
+
+	const std::vector<std::string>& filenames = (plane == COLOR) ? m_colorFilenames : m_depthFilenames;
+
+	if (frameId < 0 || frameId >= filenames.size())
+		return "";
+	return filenames[frameId];
+}
\ No newline at end of file
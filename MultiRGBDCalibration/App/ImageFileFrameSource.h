@@ -0,0 +1,61 @@
+/* This class reads frames stored as one image file per color and depth frame.
+*
+* With a shared AsyncFileReader the encoded files are read ahead of the decode
+* threads, so decoding does not wait on per-file open and read latency.
+*/
+
+#pragma once
+
+#ifndef __IMAGE_FILE_FRAME_SOURCE_H__
+#define __IMAGE_FILE_FRAME_SOURCE_H__
+
+#include <vector>
+
+#include "FrameSource.h"
+#include "..\Utility\AsyncFileReader.h"
+#include "..\Utility\FrameSet.h"
+
+class ImageFileFrameSource : public FrameSource
+{
+public:
+	ImageFileFrameSource(const std::vector<std::string>& colorFilenames,
+		const std::vector<std::string>& depthFilenames,
+		AsyncFileReader* fileReader = NULL);
+	// the filenames are resolved from the patterns when a frame is read
+	ImageFileFrameSource(const std::string& colorFolder, const FramePattern& colorPattern,
+		const std::string& depthFolder, const FramePattern& depthPattern,
+		const FrameSet& frameSet,
+		AsyncFileReader* fileReader = NULL);
+	virtual ~ImageFileFrameSource();
+
+	virtual int getNumFrame() const
+	{
+		return m_bPattern ? m_frameSet.getNumFrame() : (int) m_colorFilenames.size();
+	}
+
+	virtual bool read(const int frameId, const FRAME_PLANE plane, cv::Mat& dst, size_t& numByteRead);
+	virtual void prefetch(const int frameId, const FRAME_PLANE plane);
+	virtual bool setGrayColor(const bool bGray)
+	{
+		m_bGrayColor = bGray;
+		return true;
+	}
+	virtual bool getContentKey(const int frameId, const FRAME_PLANE plane, unsigned long long& key) const;
+	virtual std::string getName(const int frameId, const FRAME_PLANE plane) const;
+
+private:
+	std::vector<std::string> m_colorFilenames;
+	std::vector<std::string> m_depthFilenames;
+
+	bool m_bPattern;
+	std::string m_colorFolder, m_depthFolder;
+	FramePattern m_colorPattern, m_depthPattern;
+	FrameSet m_frameSet;
+
+	bool m_bGrayColor;
+
+	// not owned, may be NULL
+	AsyncFileReader* m_fileReader;
+};
+
+#endif//__IMAGE_FILE_FRAME_SOURCE_H__
\ No newline at end of file
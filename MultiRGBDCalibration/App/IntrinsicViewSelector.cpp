@@ -0,0 +1,178 @@
+#include "IntrinsicViewSelector.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#define VIEW_NUM_CELL (VIEW_GRID_COLUMNS * VIEW_GRID_ROWS)
+#define VIEW_NUM_POSE_BIN (VIEW_TILT_BINS * VIEW_TILT_BINS * VIEW_SIZE_BINS)
+
+static int getTiltBin(const float tilt)
+{
+	float t = std::max(-VIEW_MAX_TILT, std::min(VIEW_MAX_TILT, tilt));
+	int bin = (int) ((t + VIEW_MAX_TILT) / (2.0f * VIEW_MAX_TILT) * VIEW_TILT_BINS);
+	return std::min(bin, VIEW_TILT_BINS - 1);
+}
+
+// gain of adding one to a count of the objective
+static float getCountGain(const int count)
+{
+	return std::sqrt((float) count + 1.0f) - std::sqrt((float) count);
+}
+
+IntrinsicViewSelector::IntrinsicViewSelector() : m_poseWeight(0.0f)
+{
+
+}
+
+IntrinsicViewSelector::~IntrinsicViewSelector()
+{
+	clear();
+}
+
+void IntrinsicViewSelector::clear()
+{
+	m_views.clear();
+	m_poseWeight = 0.0f;
+}
+
+void IntrinsicViewSelector::init(const std::vector<corner2d_t>& views, const cv::Size imageSize, const cv::Size patternSize)
+{
+	clear();
+	if (views.empty() || imageSize.area() == 0)
+		return;
+
+	int topLeft = 0;
+	int topRight = patternSize.width - 1;
+	int bottomLeft = (patternSize.height - 1) * patternSize.width;
+	int bottomRight = patternSize.height * patternSize.width - 1;
+
+	// the size bins span the sizes seen, on a log scale
+	std::vector<float> tiltX(views.size()), tiltY(views.size()), logSize(views.size());
+	float minLogSize = FLT_MAX, maxLogSize = -FLT_MAX;
+	m_views.resize(views.size());
+	int totalCells = 0;
+	for (int viewId = 0; viewId < views.size(); viewId++)
+	{
+		const corner2d_t& corners = views[viewId];
+		View& view = m_views[viewId];
+
+		bool bCell[VIEW_NUM_CELL] = {false};
+		for (int cornerId = 0; cornerId < corners.size(); cornerId++)
+		{
+			int col = std::max(0, std::min(VIEW_GRID_COLUMNS - 1, (int) (corners[cornerId].x * VIEW_GRID_COLUMNS / imageSize.width)));
+			int row = std::max(0, std::min(VIEW_GRID_ROWS - 1, (int) (corners[cornerId].y * VIEW_GRID_ROWS / imageSize.height)));
+			bCell[row * VIEW_GRID_COLUMNS + col] = true;
+		}
+		for (int cellId = 0; cellId < VIEW_NUM_CELL; cellId++)
+		{
+			if (bCell[cellId])
+				view.cells.push_back(cellId);
+		}
+		totalCells += (int) view.cells.size();
+
+		// a view without the full board keeps the middle pose bins
+		tiltX[viewId] = 0.0f;
+		tiltY[viewId] = 0.0f;
+		logSize[viewId] = -FLT_MAX;
+		if (corners.size() <= bottomRight)
+			continue;
+
+		const cv::Point2f& tl = corners[topLeft];
+		const cv::Point2f& tr = corners[topRight];
+		const cv::Point2f& bl = corners[bottomLeft];
+		const cv::Point2f& br = corners[bottomRight];
+		float left = (float) cv::norm(bl - tl) + 1e-3f;
+		float right = (float) cv::norm(br - tr) + 1e-3f;
+		float top = (float) cv::norm(tr - tl) + 1e-3f;
+		float bottom = (float) cv::norm(br - bl) + 1e-3f;
+		tiltX[viewId] = std::log(left / right);
+		tiltY[viewId] = std::log(top / bottom);
+
+		// shoelace over the outer quad
+		float area = 0.5f * std::abs((tl.x * tr.y - tr.x * tl.y) + (tr.x * br.y - br.x * tr.y) +
+			(br.x * bl.y - bl.x * br.y) + (bl.x * tl.y - tl.x * bl.y));
+		logSize[viewId] = 0.5f * std::log(std::max(area, 1.0f) / imageSize.area());
+		minLogSize = std::min(minLogSize, logSize[viewId]);
+		maxLogSize = std::max(maxLogSize, logSize[viewId]);
+	}
+
+	float sizeRange = std::max(maxLogSize - minLogSize, 1e-6f);
+	for (int viewId = 0; viewId < m_views.size(); viewId++)
+	{
+		int sizeBin = VIEW_SIZE_BINS / 2;
+		if (logSize[viewId] > -FLT_MAX)
+			sizeBin = std::min((int) ((logSize[viewId] - minLogSize) / sizeRange * VIEW_SIZE_BINS), VIEW_SIZE_BINS - 1);
+		m_views[viewId].poseBin = (getTiltBin(tiltX[viewId]) * VIEW_TILT_BINS + getTiltBin(tiltY[viewId])) * VIEW_SIZE_BINS + sizeBin;
+	}
+	m_poseWeight = (float) totalCells / m_views.size();
+}
+
+std::vector<int> IntrinsicViewSelector::select(const int maxView) const
+{
+	std::vector<int> viewIds;
+	int numView = (int) m_views.size();
+	if (maxView <= 0 || maxView >= numView)
+	{
+		for (int viewId = 0; viewId < numView; viewId++)
+			viewIds.push_back(viewId);
+		return viewIds;
+	}
+
+	std::vector<int> cellCount(VIEW_NUM_CELL, 0);
+	std::vector<int> poseCount(VIEW_NUM_POSE_BIN, 0);
+	std::vector<unsigned char> bPicked(numView, 0);
+	for (int pick = 0; pick < maxView; pick++)
+	{
+		// ties go to the earlier view
+		int bestViewId = -1;
+		float bestGain = -1.0f;
+		for (int viewId = 0; viewId < numView; viewId++)
+		{
+			if (bPicked[viewId])
+				continue;
+
+			const View& view = m_views[viewId];
+			float gain = m_poseWeight * getCountGain(poseCount[view.poseBin]);
+			for (int i = 0; i < view.cells.size(); i++)
+				gain += getCountGain(cellCount[view.cells[i]]);
+			if (gain > bestGain)
+			{
+				bestGain = gain;
+				bestViewId = viewId;
+			}
+		}
+
+		const View& best = m_views[bestViewId];
+		bPicked[bestViewId] = 1;
+		poseCount[best.poseBin]++;
+		for (int i = 0; i < best.cells.size(); i++)
+			cellCount[best.cells[i]]++;
+	}
+
+	for (int viewId = 0; viewId < numView; viewId++)
+	{
+		if (bPicked[viewId])
+			viewIds.push_back(viewId);
+	}
+	return viewIds;
+}
+
+float IntrinsicViewSelector::getCoverage(const std::vector<int>& viewIds) const
+{
+	std::vector<unsigned char> bCovered(VIEW_NUM_CELL, 0);
+	for (int i = 0; i < viewIds.size(); i++)
+	{
+		const View& view = m_views[viewIds[i]];
+		for (int j = 0; j < view.cells.size(); j++)
+			bCovered[view.cells[j]] = 1;
+	}
+	return (float) std::count(bCovered.begin(), bCovered.end(), 1) / VIEW_NUM_CELL;
+}
+
+int IntrinsicViewSelector::getNumPoseBin(const std::vector<int>& viewIds) const
+{
+	std::vector<unsigned char> bReached(VIEW_NUM_POSE_BIN, 0);
+	for (int i = 0; i < viewIds.size(); i++)
+		bReached[m_views[viewIds[i]].poseBin] = 1;
+	return (int) std::count(bReached.begin(), bReached.end(), 1);
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+/* This class picks the views of the board that go into the intrinsic calibration.
+*
+* Each view is described by its 2d corners only: the cells of a coarse image
+* grid its corners fall in, and a pose bin of its tilt and size. The tilt is
+* read from the foreshortening of the outer board edges, the ratio of the left
+* to the right and of the top to the bottom edge, the size from the area of
+* the outer quad, which stands in for the distance of the board.
+*
+* The views are picked greedily by the gain of
+*   sum over cells sqrt(num. of views in the cell)
+*   + w * sum over pose bins sqrt(num. of views in the bin),
+* a concave function of counts and so submodular: a view pays off where the
+* picked views are thin, and a pile of near-identical views adds little.
+* w is the mean num. of cells per view, which weighs a new pose about as much
+* as a view of new image area.
+*/
+
+#pragma once
+
+#ifndef __INTRINSIC_VIEW_SELECTOR_H__
+#define __INTRINSIC_VIEW_SELECTOR_H__
+
+#include "MultiRGBDCalibrationUtil.h"
+
+#define VIEW_GRID_COLUMNS 8
+#define VIEW_GRID_ROWS 6
+#define VIEW_TILT_BINS 5 // per axis
+#define VIEW_MAX_TILT 0.4f // log of the edge ratio at the outer tilt bins
+#define VIEW_SIZE_BINS 4
+
+class IntrinsicViewSelector
+{
+public:
+	IntrinsicViewSelector();
+	virtual ~IntrinsicViewSelector();
+
+	void clear();
+	// views[viewId] holds the corners of a detected board, row by row
+	void init(const std::vector<corner2d_t>& views, const cv::Size imageSize, const cv::Size patternSize);
+
+	// at most maxView views (all if maxView <= 0), as view ids in increasing order
+	std::vector<int> select(const int maxView) const;
+
+	// fraction of the grid cells and num. of pose bins the views reach
+	float getCoverage(const std::vector<int>& viewIds) const;
+	int getNumPoseBin(const std::vector<int>& viewIds) const;
+
+	int getNumView() const
+	{
+		return (int) m_views.size();
+	}
+
+private:
+	struct View
+	{
+		// grid cells holding a corner, each once
+		std::vector<int> cells;
+		int poseBin;
+	};
+
+	// viewId
+	std::vector<View> m_views;
+	float m_poseWeight;
+};
+
+#endif//__INTRINSIC_VIEW_SELECTOR_H__
\ No newline at end of file
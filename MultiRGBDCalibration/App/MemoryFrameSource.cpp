@@ -0,0 +1,115 @@
+#include "MemoryFrameSource.h"
+
+MemoryFrameSource::MemoryFrameSource()
+{
+
+}
+
+MemoryFrameSource::~MemoryFrameSource()
+{
+
+}
+
+cv::Mat MemoryFrameSource::wrap(const void* data, const int width, const int height, const size_t stride, const PIXEL_FORMAT format)
+{
+	if (data == NULL || width <= 0 || height <= 0)
+		return cv::Mat();
+
+	int type = CV_8UC3;
+	switch (format)
+	{
+	case BGRA8:
+	case RGBA8:
+		type = CV_8UC4;
+		break;
+	case GRAY8:
+		type = CV_8UC1;
+		break;
+	case DEPTH16:
+		type = CV_16UC1;
+		break;
+	default:
+		break;
+	}
+
+	// cv::Mat never frees a buffer it doesn't own
+	return cv::Mat(height, width, type, const_cast<void*>(data), stride > 0 ? stride : cv::Mat::AUTO_STEP);
+}
+
+int MemoryFrameSource::addFrame(const cv::Mat& color, const PIXEL_FORMAT colorFormat, const double colorTimestamp,
+	const cv::Mat& depth, const double depthTimestamp)
+{
+	if (colorFormat == DEPTH16 || (depth.data != NULL && depth.type() != CV_16UC1))
+	{
+		printf("Memory frame %d has wrong formats, expected a color frame and a 16-bit depth frame\n", getNumFrame());
+		return -1;
+	}
+
+	m_color.push_back(color);
+	m_depth.push_back(depth);
+	m_colorFormat.push_back(colorFormat);
+	m_colorTimestamp.push_back(colorTimestamp);
+	m_depthTimestamp.push_back(depthTimestamp);
+
+	return getNumFrame() - 1;
+}
+
+bool MemoryFrameSource::read(const int frameId, const FRAME_PLANE plane, cv::Mat& dst, size_t& numByteRead)
+{
+	numByteRead = 0;
+	if (frameId < 0 || frameId >= getNumFrame())
+	{
+		dst.release();
+		return false;
+	}
+
+	const cv::Mat& frame = (plane == COLOR) ? m_color[frameId] : m_depth[frameId];
+	if (frame.data == NULL)
+	{
+		dst.release();
+		return false;
+	}
+	numByteRead = frame.total() * frame.elemSize();
+
+	// hand out the view itself when no conversion is needed
+	if (plane == DEPTH || m_colorFormat[frameId] == BGR8)
+	{
+		dst = frame;
+		return true;
+	}
+
+	switch (m_colorFormat[frameId])
+	{
+	case RGB8:
+		cv::cvtColor(frame, dst, CV_RGB2BGR);
+		break;
+	case BGRA8:
+		cv::cvtColor(frame, dst, CV_BGRA2BGR);
+		break;
+	case RGBA8:
+		cv::cvtColor(frame, dst, CV_RGBA2BGR);
+		break;
+	case GRAY8:
+		cv::cvtColor(frame, dst, CV_GRAY2BGR);
+		break;
+	default:
+		dst.release();
+		break;
+	}
+
+	return dst.data != NULL;
+}
+
+std::string MemoryFrameSource::getName(const int frameId, const FRAME_PLANE plane) const
+{
+	char buffer[64];
+	sprintf_s(buffer, 64, "memory frame %d (%s)", frameId, (plane == COLOR) ? "color" : "depth");
+	return std::string(buffer);
+}
+
+double MemoryFrameSource::getTimestamp(const int frameId, const FRAME_PLANE plane) const
+{
+	if (frameId < 0 || frameId >= getNumFrame())
+		return -1.0;
+	return (plane == COLOR) ? m_colorTimestamp[frameId] : m_depthTimestamp[frameId];
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+/* This class serves frames that live in buffers owned by an embedding application.
+*
+* The buffers are wrapped as cv::Mat views, so 8-bit BGR color and 16-bit depth
+* frames reach the detection without being copied, encoded or decoded. Other
+* color formats are converted when the frame is read. The buffers have to stay
+* valid until the calibration has finished.
+*/
+
+#pragma once
+
+#ifndef __MEMORY_FRAME_SOURCE_H__
+#define __MEMORY_FRAME_SOURCE_H__
+
+#include <vector>
+
+#include "FrameSource.h"
+
+class MemoryFrameSource : public FrameSource
+{
+public:
+	enum PIXEL_FORMAT{BGR8, RGB8, BGRA8, RGBA8, GRAY8, DEPTH16};
+
+	MemoryFrameSource();
+	virtual ~MemoryFrameSource();
+
+	// wrap a caller-owned buffer without copying; stride is in bytes, 0 for tightly packed rows
+	static cv::Mat wrap(const void* data, const int width, const int height, const size_t stride, const PIXEL_FORMAT format);
+
+	// append a frame, returns its frameId or -1 if the formats don't fit the planes.
+	// Not thread-safe, add all frames before the frames are loaded.
+	int addFrame(const cv::Mat& color, const PIXEL_FORMAT colorFormat, const double colorTimestamp,
+		const cv::Mat& depth, const double depthTimestamp);
+
+	virtual int getNumFrame() const
+	{
+		return (int) m_color.size();
+	}
+
+	virtual bool read(const int frameId, const FRAME_PLANE plane, cv::Mat& dst, size_t& numByteRead);
+	virtual bool isZeroCopy() const
+	{
+		return true;
+	}
+	virtual std::string getName(const int frameId, const FRAME_PLANE plane) const;
+
+	double getTimestamp(const int frameId, const FRAME_PLANE plane) const;
+
+private:
+	// frameId
+	std::vector<cv::Mat> m_color;
+	std::vector<cv::Mat> m_depth;
+	std::vector<PIXEL_FORMAT> m_colorFormat;
+	std::vector<double> m_colorTimestamp;
+	std::vector<double> m_depthTimestamp;
+};
+
+#endif//__MEMORY_FRAME_SOURCE_H__
\ No newline at end of file
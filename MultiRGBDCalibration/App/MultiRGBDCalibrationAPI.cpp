@@ -0,0 +1,214 @@
+#include "MultiRGBDCalibrationAPI.h"
+#include "MultiRGBDCalibrationApp.h"
+#include "MemoryFrameSource.h"
+
+struct MRCHandle
+{
+	MultiRGBDCalibrationConfig config;
+	MultiRGBDCalibrationApp app;
+	// camId, handed over to the app by mrcCalibrate()
+	std::vector<MemoryFrameSource*> sources;
+	std::vector<cv::Size> frameSizes;
+	bool bCalibrated;
+	// mrcCalibrate() was called, successful or not; the handle is single-shot
+	bool bCalibrateCalled;
+};
+
+// no exception may cross into the C caller, OpenCV and the allocations throw;
+// called from a catch block
+static void printException()
+{
+	try
+	{
+		throw;
+	}
+	catch (const std::exception& e)
+	{
+		printf("Error! %s\n", e.what());
+	}
+	catch (...)
+	{
+		printf("Error! unknown exception\n");
+	}
+}
+
+static cv::Mat wrapImage(const MRCImage* image)
+{
+	return MemoryFrameSource::wrap(image->data, image->width, image->height, image->stride,
+		(MemoryFrameSource::PIXEL_FORMAT) image->format);
+}
+
+MRCHandle* mrcCreate(const int numCamera,
+	const int patternWidth,
+	const int patternHeight,
+	const float patternLength,
+	const char* configFilename)
+{
+	if (numCamera <= 0)
+		return NULL;
+
+	MRCHandle* handle = NULL;
+	try
+	{
+		handle = new MRCHandle;
+		handle->bCalibrated = false;
+		handle->bCalibrateCalled = false;
+		if (handle->config.loadConfig(configFilename != NULL ? configFilename : "") != 0)
+		{
+			delete handle;
+			return NULL;
+		}
+
+		handle->config.frameLayout = MultiRGBDCalibrationConfig::MEMORY;
+		handle->config.patternWidth = patternWidth;
+		handle->config.patternHeight = patternHeight;
+		handle->config.patternLength = patternLength;
+
+		std::vector<std::string> names(numCamera);
+		for (int camId = 0; camId < numCamera; camId++)
+			names[camId] = "Cam" + std::to_string((long long) camId);
+		handle->config.setCameras(names);
+
+		handle->sources.resize(numCamera, NULL);
+		for (int camId = 0; camId < numCamera; camId++)
+			handle->sources[camId] = new MemoryFrameSource;
+		handle->frameSizes.resize(numCamera);
+
+		return handle;
+	}
+	catch (...)
+	{
+		printException();
+		mrcDestroy(handle);
+		return NULL;
+	}
+}
+
+void mrcDestroy(MRCHandle* handle)
+{
+	if (handle == NULL)
+		return;
+
+	try
+	{
+		for (int camId = 0; camId < handle->sources.size(); camId++)
+			delete handle->sources[camId];
+		delete handle;
+	}
+	catch (...)
+	{
+		printException();
+	}
+}
+
+int mrcAddFrame(MRCHandle* handle, const int camId, const MRCImage* color, const MRCImage* depth)
+{
+	if (handle == NULL || color == NULL || depth == NULL
+		|| camId < 0 || camId >= handle->sources.size() || handle->sources[camId] == NULL)
+		return -1;
+	if (color->data == NULL || depth->data == NULL || color->width != depth->width || color->height != depth->height)
+		return -1;
+
+	try
+	{
+		int frameId = handle->sources[camId]->addFrame(wrapImage(color), (MemoryFrameSource::PIXEL_FORMAT) color->format, color->timestamp,
+			wrapImage(depth), depth->timestamp);
+		if (frameId == 0)
+			handle->frameSizes[camId] = cv::Size(color->width, color->height);
+
+		return frameId;
+	}
+	catch (...)
+	{
+		printException();
+		return -1;
+	}
+}
+
+int mrcCalibrate(MRCHandle* handle)
+{
+	if (handle == NULL || handle->bCalibrateCalled)
+		return 1;
+
+	try
+	{
+		int numFrame = 0;
+		for (int camId = 0; camId < handle->sources.size(); camId++)
+			numFrame = std::max(numFrame, handle->sources[camId]->getNumFrame());
+		handle->config.numFrame = numFrame;
+
+		if (!handle->app.setConfig(handle->config))
+			return 1;
+
+		// the app owns the sources from here on; frames can't be added or the calibration repeated,
+		// even if it fails
+		handle->bCalibrateCalled = true;
+		for (int camId = 0; camId < handle->sources.size(); camId++)
+		{
+			handle->app.setFrameSource(camId, handle->sources[camId]);
+			handle->sources[camId] = NULL;
+		}
+
+		if (!handle->app.startMainLoop())
+			return 1;
+
+		handle->bCalibrated = true;
+		return 0;
+	}
+	catch (...)
+	{
+		printException();
+		return 1;
+	}
+}
+
+int mrcIsPatternDetected(MRCHandle* handle, const int camId, const int frameId)
+{
+	if (handle == NULL || !handle->bCalibrated || camId < 0 || camId >= handle->app.getNumCamera())
+		return 0;
+
+	try
+	{
+		return handle->app.getCamera(camId).isPatternDetected(frameId) ? 1 : 0;
+	}
+	catch (...)
+	{
+		printException();
+		return 0;
+	}
+}
+
+int mrcGetIntrinsic(MRCHandle* handle, const int camId, MRCIntrinsic* intrinsic)
+{
+	if (handle == NULL || intrinsic == NULL || !handle->bCalibrated || camId < 0 || camId >= handle->app.getNumCamera())
+		return 1;
+
+	try
+	{
+		// a camera that never saw the board has no intrinsic
+		const RGBDCamera& camera = handle->app.getCamera(camId);
+		if (camera.getNumIntrinsicView() == 0)
+			return 1;
+
+		cv::Mat cameraMatrix = camera.getCameraMatrix();
+		cv::Mat distCoeffs = camera.getDistCoeffs();
+		if (cameraMatrix.empty() || distCoeffs.total() < 5)
+			return 1;
+
+		intrinsic->width = handle->frameSizes[camId].width;
+		intrinsic->height = handle->frameSizes[camId].height;
+		intrinsic->fx = cameraMatrix.at<double>(0, 0);
+		intrinsic->fy = cameraMatrix.at<double>(1, 1);
+		intrinsic->cx = cameraMatrix.at<double>(0, 2);
+		intrinsic->cy = cameraMatrix.at<double>(1, 2);
+		for (int i = 0; i < 5; i++)
+			intrinsic->dist[i] = distCoeffs.at<double>(i);
+
+		return 0;
+	}
+	catch (...)
+	{
+		printException();
+		return 1;
+	}
+}
\ No newline at end of file
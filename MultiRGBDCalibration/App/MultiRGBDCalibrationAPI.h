@@ -0,0 +1,88 @@
+/* This is the C interface for embedding the calibration in another application.
+*
+* The caller keeps ownership of the frame buffers: mrcAddFrame() only records
+* a view of them, so they have to stay valid and unchanged until mrcCalibrate()
+* has returned. 8-bit BGR color and 16-bit depth in millimeters are used
+* without any copy, other color formats are converted when a frame is read.
+*
+* A handle calibrates once: after mrcCalibrate(), successful or not, frames
+* can't be added any more and only the results can be read. No function
+* throws; an internal error is reported by the return value.
+*
+* Typical use:
+*   MRCHandle* handle = mrcCreate(2, 9, 6, 0.025f, NULL);
+*   mrcAddFrame(handle, 0, &color0, &depth0); ...
+*   mrcCalibrate(handle);
+*   mrcGetIntrinsic(handle, 0, &intrinsic);
+*   mrcDestroy(handle);
+*/
+
+#pragma once
+
+#ifndef __MULTI_RGBD_CALIBRATION_API_H__
+#define __MULTI_RGBD_CALIBRATION_API_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MRCHandle MRCHandle;
+
+typedef enum MRCPixelFormat
+{
+	MRC_BGR8,
+	MRC_RGB8,
+	MRC_BGRA8,
+	MRC_RGBA8,
+	MRC_GRAY8,
+	MRC_DEPTH16
+} MRCPixelFormat;
+
+typedef struct MRCImage
+{
+	const void* data;
+	int width;
+	int height;
+	// bytes between the starts of two rows, 0 for tightly packed rows
+	size_t stride;
+	MRCPixelFormat format;
+	// capture time in the caller's clock, kept for the frame
+	double timestamp;
+} MRCImage;
+
+typedef struct MRCIntrinsic
+{
+	int width, height;
+	double fx, fy;
+	double cx, cy;
+	double dist[5];
+} MRCIntrinsic;
+
+// configFilename may be NULL, then nothing is written to disk; a given config.ini provides the
+// remaining settings (rootFolder for the results, [performance], [memory]) while its frame layout
+// is ignored. Returns NULL if the config couldn't be loaded.
+MRCHandle* mrcCreate(const int numCamera,
+	const int patternWidth,
+	const int patternHeight,
+	const float patternLength,
+	const char* configFilename);
+void mrcDestroy(MRCHandle* handle);
+
+// returns the frameId of the frame in the camera, or -1 on a bad camera or format
+int mrcAddFrame(MRCHandle* handle, const int camId, const MRCImage* color, const MRCImage* depth);
+
+// detect the pattern and compute the intrinsics of every camera; returns 0 on success, 1 if a camera
+// never saw the board. Called once per handle, a failed calibration needs a new handle
+int mrcCalibrate(MRCHandle* handle);
+
+int mrcIsPatternDetected(MRCHandle* handle, const int camId, const int frameId);
+// returns 0 on success, after mrcCalibrate(); 1 if the camera never saw the board
+int mrcGetIntrinsic(MRCHandle* handle, const int camId, MRCIntrinsic* intrinsic);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__MULTI_RGBD_CALIBRATION_API_H__
\ No newline at end of file
@@ -1,4 +1,23 @@
 #include "MultiRGBDCalibrationApp.h"
+#include "CrossCameraRoiPredictor.h"
+#include "DatasetValidator.h"
+#include "ImageFileFrameSource.h"
+#include "MemoryFrameSource.h"
+#include "RGBDSequenceFile.h"
+#include "VideoFrameSource.h"
+#include "..\Utility\ContentKey.h"
+#include "..\Utility\PooledMatAllocator.h"
+
+#include <algorithm>
+
+// the content key of the file, or of its absence, chained to seed
+static unsigned long long hashFileKey(const std::string& filename, const unsigned long long seed)
+{
+	unsigned long long fileKey = 0;
+	if (!getFileContentKey(filename, fileKey))
+		return hashContentString("missing " + filename, seed);
+	return hashContentBytes(&fileKey, sizeof(fileKey), seed);
+}
 
 MultiRGBDCalibrationApp::MultiRGBDCalibrationApp() : m_bConfigLoaded(false), m_numCamera(0), m_numFrame(0)
 {
@@ -7,23 +26,29 @@ MultiRGBDCalibrationApp::MultiRGBDCalibrationApp() : m_bConfigLoaded(false), m_n
 
 MultiRGBDCalibrationApp::~MultiRGBDCalibrationApp()
 {
-
+	clear();
 }
 
 void MultiRGBDCalibrationApp::clear()
 {
 	m_intrinsics.clear();
+	m_fileReader.clear();
+	m_debugWriter.clear();
+
+	for (int camId = 0; camId < m_frameSources.size(); camId++)
+		delete m_frameSources[camId];
+	m_frameSources.clear();
 
 	m_numCamera = 0;
 	m_numFrame = 0;
 }
 
-void MultiRGBDCalibrationApp::init()
+bool MultiRGBDCalibrationApp::init()
 {
 	if (!m_bConfigLoaded)
 	{
 		printf("Config. not loaded! App. initilization failed!\n");
-		exit(0);
+		return false;
 	}
 
 	m_numCamera = m_config.numCamera;
@@ -31,34 +56,99 @@ void MultiRGBDCalibrationApp::init()
 
 	m_intrinsics.resize(m_numCamera);
 	m_bCalibrateIntrinsicEnabled.resize(m_numCamera);
+	m_frameSources.resize(m_numCamera, NULL);
+	return true;
 }
 
 bool MultiRGBDCalibrationApp::loadConfig(const std::string& fn)
 {
-	m_config.loadConfig(fn);
+	if (m_config.loadConfig(fn) != 0)
+		return false;
 	m_bConfigLoaded = true;
 
-	init();
+	if (!init())
+		return false;
+
+	// fail before any frame is decoded
+	if (m_config.bValidateDataset && !_validateDataset())
+		return false;
 
 	return true;
 }
 
-bool MultiRGBDCalibrationApp::startMainLoop()
+bool MultiRGBDCalibrationApp::setConfig(const MultiRGBDCalibrationConfig& config)
 {
-	_checkAppStatus();
-	_loadData();
-	_calibrate();
-	_saveResults();
+	clear();
+
+	m_config = config;
+	m_bConfigLoaded = true;
+
+	if (!init())
+		return false;
+
+	if (m_config.frameLayout != MultiRGBDCalibrationConfig::MEMORY && m_config.bValidateDataset && !_validateDataset())
+		return false;
 
 	return true;
 }
 
-void MultiRGBDCalibrationApp::_checkAppStatus()
+void MultiRGBDCalibrationApp::setFrameSource(const int camId, FrameSource* source)
+{
+	if (camId < 0 || camId >= m_frameSources.size())
+	{
+		delete source;
+		return;
+	}
+
+	delete m_frameSources[camId];
+	m_frameSources[camId] = source;
+}
+
+bool MultiRGBDCalibrationApp::startMainLoop()
+{
+	bool bCountAllocations = m_config.matAllocator == "counting" || m_config.matAllocator == "pooled";
+	if (bCountAllocations)
+		PooledMatAllocator::install(m_config.matAllocator == "pooled");
+
+	bool bSuccess = _checkAppStatus() && _loadData();
+	if (bSuccess)
+	{
+		_calibrate();
+		_saveResults();
+	}
+
+	// the buffers cached by the pool threads are freed with the report
+	if (bCountAllocations)
+	{
+		PooledMatAllocator::printStats();
+		PooledMatAllocator::trim();
+		PooledMatAllocator::uninstall();
+	}
+
+	return bSuccess;
+}
+
+bool MultiRGBDCalibrationApp::_validateDataset()
+{
+	// frame sizes are checked against the initial intrinsics where they exist
+	std::vector<CameraIntrinsicF> intrinsics(m_numCamera);
+	for (int camId = 0; camId < m_numCamera; camId++)
+	{
+		intrinsics[camId].w = 0;
+		intrinsics[camId].h = 0;
+		intrinsics[camId].load(m_config.initIntrinsicFilenames[camId]);
+	}
+
+	DatasetValidator validator;
+	return validator.validate(m_config, intrinsics, m_config.numDecodeThreads);
+}
+
+bool MultiRGBDCalibrationApp::_checkAppStatus()
 {
 	if (!m_bConfigLoaded)
 	{
 		printf("Error! config. not loaded!\n");
-		exit(0);
+		return false;
 	}
 
 	// check if need intrinsic calibration
@@ -70,19 +160,456 @@ void MultiRGBDCalibrationApp::_checkAppStatus()
 			m_bCalibrateIntrinsicEnabled[camId] = true;
 	}
 
+	return true;
 }
 
-void MultiRGBDCalibrationApp::_loadData()
+bool MultiRGBDCalibrationApp::_loadData()
 {
+	FrameDecodePool decodePool;
+	decodePool.init(m_config.numDecodeThreads);
+
+	// one detection job per (camera, frame); slow frames are picked up by idle workers
+	WorkStealingPool detectPool;
+	detectPool.init(m_config.numDetectThreads);
+
+	if (m_config.frameLayout == MultiRGBDCalibrationConfig::PNG_FOLDERS && m_config.bReadAhead)
+		m_fileReader.init(m_config.ioQueueDepth, m_config.ioInFlightBytes);
+	_initDebugWriter();
+
+	if (m_config.bStreaming)
+	{
+		// cameras are streamed one after another so the frame budget holds for the whole run
+		m_rgbdCamera.resize(m_numCamera);
+		int64 budgetEndTick = _getDetectionBudgetEnd();
+		int numAnchor = _getNumRoiAnchor();
+		for (int camId = 0; camId < m_numCamera; camId++)
+		{
+			if (camId == numAnchor)
+				_predictSearchRois(numAnchor);
+			_configureCamera(camId);
+			// a camera with a known intrinsic extracts its 3d corners window by window,
+			// the others once their intrinsic is computed from all windows
+			bool bKnownIntrinsic = !m_bCalibrateIntrinsicEnabled[camId];
+			m_rgbdCamera[camId].setDetectionBudget(budgetEndTick);
+			m_rgbdCamera[camId].streamFrames(_createFrameSource(camId),
+				m_config.patternWidth,
+				m_config.patternHeight,
+				m_config.patternLength,
+				decodePool,
+				detectPool,
+				m_config.frameBudgetBytes,
+				m_config.streamWindow,
+				bKnownIntrinsic ? &m_intrinsics[camId] : NULL,
+				!bKnownIntrinsic);
+		}
+		decodePool.printStats();
+		m_fileReader.printStats();
+		_finishDebugWriter();
+
+		bool bIntrinsic = _calibrateIntrinsics();
+		for (int camId = 0; camId < m_numCamera; camId++)
+		{
+			if (m_bCalibrateIntrinsicEnabled[camId])
+				m_rgbdCamera[camId].initCorners3d();
+		}
+		_exportDetectionStats();
+		return bIntrinsic;
+	}
+
+	// queue the frames of all cameras at once so decoding is not serialized per camera
 	m_rgbdCamera.resize(m_numCamera);
 	for (int camId = 0; camId < m_numCamera; camId++)
 	{
-		m_rgbdCamera[camId].init(m_config.colorFilenames[camId],
-			m_config.depthFilenames[camId],
-			m_config.patternWidth,
+		_configureCamera(camId);
+		m_rgbdCamera[camId].loadFrames(_createFrameSource(camId), decodePool);
+	}
+	decodePool.wait();
+	decodePool.printStats();
+	m_fileReader.printStats();
+
+	if (m_config.dedup != "off")
+	{
+		for (int camId = 0; camId < m_numCamera; camId++)
+			m_rgbdCamera[camId].hashFrames(detectPool);
+		detectPool.wait();
+		_markDuplicateFrames();
+	}
+
+	int64 detectStartTick = cv::getTickCount();
+	int64 budgetEndTick = _getDetectionBudgetEnd();
+	int numAnchor = _getNumRoiAnchor();
+	for (int camId = 0; camId < m_numCamera; camId++)
+	{
+		// the anchor cameras are searched first, the others around the board they found
+		if (camId == numAnchor)
+		{
+			detectPool.wait();
+			_predictSearchRois(numAnchor);
+		}
+		m_rgbdCamera[camId].setDetectionBudget(budgetEndTick);
+		m_rgbdCamera[camId].detectCorners(m_config.patternWidth,
 			m_config.patternHeight,
-			m_config.patternLength);
+			detectPool);
+	}
+	detectPool.wait();
+
+	// the frames given up at the deadline get what is left of the budget
+	if (m_config.bRetryTimedOut)
+	{
+		int numRetry = 0;
+		for (int camId = 0; camId < m_numCamera; camId++)
+			numRetry += m_rgbdCamera[camId].retryTimedOutFrames(detectPool);
+		detectPool.wait();
+		if (numRetry > 0)
+			printf("Retried %d frames given up at the deadline\n", numRetry);
+	}
+	printf("Detected the pattern of %d cameras in %.1f ms on %d threads (%lld jobs stolen)\n",
+		m_numCamera, (cv::getTickCount() - detectStartTick) * 1000.0 / cv::getTickFrequency(),
+		detectPool.getNumThreads(), detectPool.getNumStolen());
+	_finishDebugWriter();
+
+	for (int camId = 0; camId < m_numCamera; camId++)
+		m_rgbdCamera[camId].reportDetection();
+	bool bIntrinsic = _calibrateIntrinsics();
+	for (int camId = 0; camId < m_numCamera; camId++)
+		m_rgbdCamera[camId].initCorners3d();
+	_exportDetectionStats();
+	return bIntrinsic;
+}
+
+bool MultiRGBDCalibrationApp::_calibrateIntrinsics()
+{
+	// calibrateCamera runs on one thread per camera, so the cameras are calibrated side by side;
+	// a camera streamed with its known intrinsic has set it up and printed it already
+	int numCalibrate = 0;
+	std::vector<unsigned char> bSetUp(m_numCamera, 0);
+	for (int camId = 0; camId < m_numCamera; camId++)
+	{
+		if (m_rgbdCamera[camId].getIntrinsic() != NULL)
+			bSetUp[camId] = 1;
+		else if (m_bCalibrateIntrinsicEnabled[camId])
+			numCalibrate++;
+		else
+			m_rgbdCamera[camId].calibrateIntrinsic(m_config.patternWidth, m_config.patternHeight,
+				m_config.patternLength, &m_intrinsics[camId]);
+	}
+
+	int64 startTick = cv::getTickCount();
+	if (numCalibrate > 0)
+	{
+		int numThreads = m_config.numIntrinsicThreads > 0 ? m_config.numIntrinsicThreads : (int) std::thread::hardware_concurrency();
+		ThreadPool calibratePool;
+		calibratePool.init(std::max(1, std::min(numThreads, numCalibrate)));
+
+		std::atomic<int> numDone(0);
+		for (int camId = 0; camId < m_numCamera; camId++)
+		{
+			if (!m_bCalibrateIntrinsicEnabled[camId])
+				continue;
+
+			printf("Camera %d: computing the intrinsic from %d views\n", camId, m_rgbdCamera[camId].getNumDetectedFrame());
+			calibratePool.enqueue(std::bind(&MultiRGBDCalibrationApp::_calibrateIntrinsic, this, camId, &numDone, numCalibrate));
+		}
+		calibratePool.wait();
+		printf("Computed the intrinsics of %d cameras in %.1f s on %d threads\n", numCalibrate,
+			(cv::getTickCount() - startTick) / cv::getTickFrequency(), calibratePool.getNumThreads());
+	}
+
+	// reported and saved in camera order, whichever finished first
+	bool bSuccess = true;
+	for (int camId = 0; camId < m_numCamera; camId++)
+	{
+		if (bSetUp[camId])
+			continue;
+
+		printf("Camera %d intrinsic:\n", camId);
+		m_rgbdCamera[camId].printIntrinsic();
+		if (!m_rgbdCamera[camId].isIntrinsicCalibrated())
+			continue;
+		if (m_rgbdCamera[camId].getNumIntrinsicView() == 0)
+		{
+			bSuccess = false;
+			continue;
+		}
+
+		m_intrinsics[camId].copyFrom(m_rgbdCamera[camId].getIntrinsic());
+		if (m_config.bSaveParams && !m_intrinsics[camId].save(m_config.intrinsicFilenames[camId]))
+			printf("Error! couldn't save the intrinsic to %s\n", m_config.intrinsicFilenames[camId].c_str());
+	}
+	return bSuccess;
+}
+
+void MultiRGBDCalibrationApp::_calibrateIntrinsic(const int camId, std::atomic<int>* numDone, const int numCalibrate)
+{
+	RGBDCamera& camera = m_rgbdCamera[camId];
+	camera.calibrateIntrinsic(m_config.patternWidth, m_config.patternHeight, m_config.patternLength);
+	printf("Camera %d: intrinsic done in %.1f s (%d of %d)\n", camId, camera.getIntrinsicSeconds(), ++(*numDone), numCalibrate);
+}
+
+int64 MultiRGBDCalibrationApp::_getDetectionBudgetEnd() const
+{
+	if (m_config.detectBudgetMs <= 0)
+		return 0;
+	return cv::getTickCount() + (int64) (m_config.detectBudgetMs * cv::getTickFrequency() / 1000.0);
+}
+
+void MultiRGBDCalibrationApp::_exportDetectionStats()
+{
+	if (!m_config.bExportDetectionStats)
+		return;
+
+	for (int camId = 0; camId < m_numCamera; camId++)
+		m_rgbdCamera[camId].exportDetectionStats(m_config.paramFolder + "/DetectionStats-" + m_config.cameraName[camId] + ".csv");
+}
+
+void MultiRGBDCalibrationApp::_initDebugWriter()
+{
+	DebugImageWriter::OUTPUT output = DebugImageWriter::OUTPUT_NONE;
+	if (m_config.debugOutput == "images")
+		output = DebugImageWriter::OUTPUT_IMAGES;
+	else if (m_config.debugOutput == "video")
+		output = DebugImageWriter::OUTPUT_VIDEO;
+	m_debugWriter.init(output, m_config.debugFolder, m_config.debugQueueSize, m_config.debugMaxWidth);
+}
+
+void MultiRGBDCalibrationApp::_finishDebugWriter()
+{
+	if (!m_debugWriter.isEnabled())
+		return;
+
+	m_debugWriter.finish();
+	m_debugWriter.printStats();
+}
+
+unsigned long long MultiRGBDCalibrationApp::_getDetectionSettingsKey() const
+{
+	// the deadline and budget only decide whether a frame gets searched, such frames aren't cached
+	char settings[512];
+	sprintf_s(settings, 512, "pattern %dx%d %g backend %s pyramid %d %d %d gray %d tracking %d %d presence %s %d "
+		"quality %d %g %g dedup %s %d roi %d %d %g depthRoi %d %d fallback %d",
+		m_config.patternWidth, m_config.patternHeight, m_config.patternLength, m_config.detectionBackend.c_str(),
+		(int) m_config.bPyramidDetection, m_config.expectedBoardPixels, m_config.minSquarePixels,
+		(int) m_config.bGrayDecode, (int) m_config.bTracking, m_config.keyframeInterval,
+		m_config.presenceCheck.c_str(), m_config.presenceAudit,
+		(int) m_config.bQualityCheck, m_config.minSharpness, m_config.maxClipped,
+		m_config.dedup.c_str(), m_config.dedupMaxBits,
+		(int) m_config.bRoiPrediction, m_config.roiAnchorCameras, m_config.roiPadding,
+		(int) m_config.bDepthRoi, m_config.depthRoiDownscale, (int) m_config.bRoiFallback);
+	unsigned long long key = hashContentString(settings);
+
+	// where the rois are depends on the init intrinsics and, for the predicted ones, on the extrinsics of
+	// the previous calibration, which a calibration run rewrites
+	if (m_config.bRoiPrediction || m_config.bDepthRoi)
+	{
+		for (int camId = 0; camId < m_numCamera; camId++)
+		{
+			key = hashFileKey(m_config.initIntrinsicFilenames[camId], key);
+			if (m_config.bRoiPrediction)
+				key = hashFileKey(m_config.extrinsicFilenames[camId], key);
+		}
 	}
+	return key;
+}
+
+int MultiRGBDCalibrationApp::_getNumRoiAnchor() const
+{
+	if (!m_config.bRoiPrediction)
+		return m_numCamera;
+	return std::max(1, std::min(m_config.roiAnchorCameras, m_numCamera));
+}
+
+void MultiRGBDCalibrationApp::_predictSearchRois(const int numAnchor)
+{
+	// the intrinsics come from the init files, the extrinsics from a previous calibration
+	std::vector<CameraExtrinsicF> extrinsics(m_numCamera);
+	std::vector<bool> bCalibrated(m_numCamera);
+	for (int camId = 0; camId < m_numCamera; camId++)
+		bCalibrated[camId] = !m_bCalibrateIntrinsicEnabled[camId] && extrinsics[camId].load(m_config.extrinsicFilenames[camId]);
+
+	int numFrame = 0;
+	for (int camId = 0; camId < numAnchor; camId++)
+		numFrame = std::max(numFrame, m_rgbdCamera[camId].getNumFrame());
+
+	CrossCameraRoiPredictor predictor;
+	predictor.init(m_intrinsics, extrinsics, bCalibrated,
+		cv::Size(m_config.patternWidth, m_config.patternHeight), m_config.patternLength, numFrame);
+	for (int camId = 0; camId < numAnchor; camId++)
+	{
+		if (!predictor.isCalibrated(camId))
+			continue;
+
+		for (int frameId = 0; frameId < m_rgbdCamera[camId].getNumFrame(); frameId++)
+		{
+			if (m_rgbdCamera[camId].isPatternDetected(frameId))
+				predictor.addBoard(frameId, camId, m_rgbdCamera[camId].getCorner2d(frameId));
+		}
+	}
+
+	for (int camId = numAnchor; camId < m_numCamera; camId++)
+	{
+		if (!predictor.isCalibrated(camId))
+		{
+			printf("Camera %d has no init intrinsic or extrinsic, searching whole frames\n", camId);
+			continue;
+		}
+
+		std::vector<cv::Rect> rois(numFrame);
+		int numRoi = 0;
+		for (int frameId = 0; frameId < numFrame; frameId++)
+		{
+			rois[frameId] = predictor.predictRoi(frameId, camId, m_config.roiPadding);
+			if (rois[frameId].area() > 0)
+				numRoi++;
+		}
+		m_rgbdCamera[camId].setSearchRois(rois);
+		printf("Camera %d: board predicted in %d of %d frames from %d anchor cameras\n", camId, numRoi, numFrame, numAnchor);
+	}
+}
+
+void MultiRGBDCalibrationApp::_configureCamera(const int camId)
+{
+	RGBDCamera& camera = m_rgbdCamera[camId];
+	camera.setDepthCompression(m_config.bCompressDepth, m_config.depthBandHeight);
+	camera.setGrayDecode(m_config.bGrayDecode);
+	camera.setPyramidDetection(m_config.bPyramidDetection, m_config.expectedBoardPixels, m_config.minSquarePixels);
+	camera.setDetectionBackend(m_config.detectionBackend == "saddle" ?
+		CheckerboardDetector::BACKEND_SADDLE : CheckerboardDetector::BACKEND_OPENCV);
+	camera.setTracking(m_config.bTracking, m_config.keyframeInterval);
+	CheckerboardDetector::PRESENCE_CHECK presenceCheck = CheckerboardDetector::PRESENCE_OFF;
+	if (m_config.presenceCheck == "fast")
+		presenceCheck = CheckerboardDetector::PRESENCE_FAST;
+	else if (m_config.presenceCheck == "conservative")
+		presenceCheck = CheckerboardDetector::PRESENCE_CONSERVATIVE;
+	camera.setPresenceCheck(presenceCheck, m_config.presenceAudit);
+	camera.setQualityCheck(m_config.bQualityCheck, m_config.minSharpness, m_config.maxClipped);
+	// the board size in pixels needs the focal length before the detection
+	bool bIntrinsic = !m_bCalibrateIntrinsicEnabled[camId];
+	if (m_config.bDepthRoi && !bIntrinsic)
+		printf("Camera %d has no init intrinsic, searching whole frames instead of depth rois\n", camId);
+	camera.setDepthRoi(m_config.bDepthRoi && bIntrinsic, m_config.patternLength,
+		bIntrinsic ? m_intrinsics[camId].fx : 0.0f, m_config.depthRoiDownscale);
+	camera.setRoiFallback(m_config.bRoiFallback);
+	camera.setDetectionDeadline(m_config.detectDeadlineMs, m_config.bRetryTimedOut);
+	camera.setDetectionBenchmark(m_config.bDetectionBenchmark);
+	camera.setIntrinsicViewSelection(m_config.maxIntrinsicViews, m_config.bCompareIntrinsicViews);
+	camera.setDebugWriter(m_debugWriter.isEnabled() ? &m_debugWriter : NULL, m_config.cameraName[camId]);
+	camera.setDetectionCache(m_config.bDetectionCache ? m_config.paramFolder + "/DetectionCache-" + m_config.cameraName[camId] + ".bin" : "",
+		_getDetectionSettingsKey(), cv::Size(m_config.patternWidth, m_config.patternHeight));
+	// without all frames at hand, a streamed camera can only be deduplicated on its own
+	camera.setStreamDedup(m_config.dedup != "off" ? m_config.dedupMaxBits : -1);
+}
+
+void MultiRGBDCalibrationApp::_markDuplicateFrames()
+{
+	if (m_config.dedup != "synchronized")
+	{
+		for (int camId = 0; camId < m_numCamera; camId++)
+		{
+			int numDuplicate = m_rgbdCamera[camId].markDuplicateFrames(m_config.dedupMaxBits);
+			printf("Camera %d: skipping %d of %d frames as near-duplicates\n", camId, numDuplicate, m_rgbdCamera[camId].getNumFrame());
+		}
+		return;
+	}
+
+	// a frame is skipped only if every camera sees nearly the same as on the last kept frame
+	int numFrame = m_numCamera > 0 ? m_rgbdCamera[0].getNumFrame() : 0;
+	for (int camId = 1; camId < m_numCamera; camId++)
+		numFrame = std::min(numFrame, m_rgbdCamera[camId].getNumFrame());
+
+	int repFrameId = -1;
+	int numDuplicate = 0;
+	for (int frameId = 0; frameId < numFrame; frameId++)
+	{
+		bool bHashed = true;
+		bool bDuplicate = repFrameId >= 0;
+		for (int camId = 0; camId < m_numCamera; camId++)
+		{
+			const RGBDCamera& camera = m_rgbdCamera[camId];
+			if (!camera.hasFrameHash(frameId))
+			{
+				bHashed = false;
+				bDuplicate = false;
+				break;
+			}
+			if (bDuplicate && frameHashDistance(camera.getFrameHash(repFrameId), camera.getFrameHash(frameId)) > m_config.dedupMaxBits)
+				bDuplicate = false;
+		}
+
+		for (int camId = 0; camId < m_numCamera; camId++)
+			m_rgbdCamera[camId].setDuplicateFrame(frameId, bDuplicate);
+
+		// a frame missing in any camera can't represent the ones after it
+		if (bDuplicate)
+			numDuplicate++;
+		else if (bHashed)
+			repFrameId = frameId;
+	}
+	printf("Skipping %d of %d synchronized frames as near-duplicates in all %d cameras\n", numDuplicate, numFrame, m_numCamera);
+}
+
+FrameSource* MultiRGBDCalibrationApp::_createFrameSource(const int camId)
+{
+	// the camera takes over a source set by the embedding application
+	if (m_frameSources[camId] != NULL)
+	{
+		FrameSource* source = m_frameSources[camId];
+		m_frameSources[camId] = NULL;
+		return source;
+	}
+
+	if (m_config.frameLayout == MultiRGBDCalibrationConfig::MEMORY)
+	{
+		printf("No frames handed over for camera %d\n", camId);
+		return new MemoryFrameSource;
+	}
+
+	if (m_config.frameLayout == MultiRGBDCalibrationConfig::RGBD_SEQUENCE)
+	{
+		RGBDSequenceFile* sequence = new RGBDSequenceFile;
+		sequence->open(m_config.sequenceFilenames[camId]);
+		return sequence;
+	}
+
+	if (m_config.frameLayout == MultiRGBDCalibrationConfig::VIDEO)
+	{
+		return new VideoFrameSource(m_config.colorVideoFilenames[camId],
+			m_config.depthVideoFilenames[camId],
+			m_config.frameStart,
+			m_config.frameStride,
+			m_config.numFrame,
+			m_config.videoReadAhead);
+	}
+
+	return new ImageFileFrameSource(m_config.colorFolders[camId], m_config.colorPattern,
+		m_config.depthFolders[camId], m_config.depthPattern,
+		m_config.frameSet,
+		&m_fileReader);
+}
+
+bool MultiRGBDCalibrationApp::convertToSequence()
+{
+	if (!m_bConfigLoaded)
+	{
+		printf("Error! config. not loaded!\n");
+		return false;
+	}
+
+	RGBDSequenceFile::PLANE_CODEC codec =
+		(m_config.sequenceCodec == "raw") ? RGBDSequenceFile::RAW : RGBDSequenceFile::PNG;
+
+	bool bSuccess = true;
+	for (int camId = 0; camId < m_numCamera; camId++)
+	{
+		printf("Converting %s to %s\n", m_config.cameraName[camId].c_str(), m_config.sequenceFilenames[camId].c_str());
+
+		ImageFileFrameSource source(m_config.colorFolders[camId], m_config.colorPattern,
+			m_config.depthFolders[camId], m_config.depthPattern,
+			m_config.frameSet);
+		if (!RGBDSequenceFile::convert(source, m_config.sequenceFilenames[camId], codec))
+			bSuccess = false;
+	}
+
+	return bSuccess;
 }
 
 void MultiRGBDCalibrationApp::_calibrate()
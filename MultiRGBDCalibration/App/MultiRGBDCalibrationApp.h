@@ -7,7 +7,12 @@
 
 #include "MultiRGBDCalibrationConfig.h"
 #include "MultiRGBDCalibrationUtil.h"
+#include "DebugImageWriter.h"
 #include "RGBDCamera.h"
+#include "..\Utility\AsyncFileReader.h"
+#include "..\Utility\ThreadPool.h"
+
+#include <atomic>
 
 class MultiRGBDCalibrationApp
 {
@@ -16,18 +21,61 @@ public:
 	virtual ~MultiRGBDCalibrationApp();
 
 	void clear();
-	void init();
+	bool init();
 
 	// Load the program configuration
 	bool loadConfig(const std::string& fn);
+	// use a configuration built by an embedding application, e.g. for the MEMORY layout
+	bool setConfig(const MultiRGBDCalibrationConfig& config);
+
+	// read the frames of a camera from source instead of the configured files;
+	// the app takes ownership of source
+	void setFrameSource(const int camId, FrameSource* source);
 
+	// false if the run failed, e.g. a camera to calibrate never saw the board
 	bool startMainLoop();
 
+	// pack the png folders of every camera into .rgbdseq containers
+	bool convertToSequence();
+
+	int getNumCamera() const
+	{
+		return m_numCamera;
+	}
+	const RGBDCamera& getCamera(const int camId) const
+	{
+		return m_rgbdCamera[camId];
+	}
+	RGBDCamera& getCamera(const int camId)
+	{
+		return m_rgbdCamera[camId];
+	}
+
 private:
-	void _checkAppStatus();
-	void _loadData();
+	bool _validateDataset();
+	bool _checkAppStatus();
+	bool _loadData();
 	void _calibrate();
 	void _saveResults();
+	// apply the memory and detection settings before the frames are loaded
+	void _configureCamera(const int camId);
+	void _markDuplicateFrames();
+	// cv::getTickCount() value the detection budget ends at, 0 if unlimited
+	int64 _getDetectionBudgetEnd() const;
+	void _exportDetectionStats();
+	// calibrate the cameras without an init intrinsic side by side, given ones are copied;
+	// false if a camera got no intrinsic
+	bool _calibrateIntrinsics();
+	void _calibrateIntrinsic(const int camId, std::atomic<int>* numDone, const int numCalibrate);
+	void _initDebugWriter();
+	// write the debug frames still queued, before the frames are released
+	void _finishDebugWriter();
+	// key of every setting and roi input file that can change the detected corners, for the detection cache
+	unsigned long long _getDetectionSettingsKey() const;
+	// num. of cameras searched in full before the others are searched around the predicted board
+	int _getNumRoiAnchor() const;
+	void _predictSearchRois(const int numAnchor);
+	FrameSource* _createFrameSource(const int camId);
 	
 	MultiRGBDCalibrationConfig m_config;
 
@@ -38,8 +86,11 @@ private:
 	/* ----- Data ----- */
 	int m_numCamera;
 	int m_numFrame;
+	AsyncFileReader					m_fileReader; // shared by the png frame sources
+	DebugImageWriter				m_debugWriter; // fed by the detection of all cameras
 	std::vector<CameraIntrinsicF>	m_intrinsics; // m_intrinsics[camId]
 	std::vector<RGBDCamera>			m_rgbdCamera; // m_rgbdCamera[camId]
+	std::vector<FrameSource*>		m_frameSources; // m_frameSources[camId], set by setFrameSource()
 
 
 };
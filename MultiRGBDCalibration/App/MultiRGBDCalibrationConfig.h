@@ -21,7 +21,21 @@
 *   Color-[CamXXName]/
 *      color[XXXX].png
 *      ...
-*   (other Color folders)...
+*   (other Color folders)...
+*  
+*   (optional) [CamXXName].rgbdseq
+*   ...
+*
+* The png names follow colorPattern and depthPattern in the [input] section
+* (default color%04d.png and depth%04d.png). The frames are frameStart,
+* frameStart + frameStride, ... unless "frames" lists them, e.g.
+* "frames = 0-99, 200-400:10", or is "scan" to use the frames found in every
+* Color and Depth folder.
+*
+* With "layout = rgbdseq" in the [input] section the frames are read from the
+* packed [CamXXName].rgbdseq containers instead of the Depth/Color folders.
+* With "layout = video" they are read from the Color-[CamXXName].[ext] and
+* Depth-[CamXXName].[ext] videos in ROOT_FOLDER, [ext] being videoExtension.
 *
 */
 
@@ -35,12 +49,14 @@
 #include <direct.h>
 
 #include "..\Utility\dirent.h"
+#include "..\Utility\FrameSet.h"
 #include "..\Utility\INIReader.h"
 
 struct MultiRGBDCalibrationConfig
 {
 public:
 	enum EXTRINSIC_CALIB_METHOD{GLOBAL_VIS, GLOBAL_GEOM, LOCAL};
+	enum FRAME_LAYOUT{PNG_FOLDERS, RGBD_SEQUENCE, VIDEO, MEMORY};
 
 	// calibration method - 0 : global, 1 : local
 	EXTRINSIC_CALIB_METHOD calibMethod;
@@ -53,8 +69,17 @@ public:
 	int numCamera;
 	// num. of rgb-d frames used for calibration
 	int numFrame;
+	// first recorded frame and step between the recorded frames used for calibration
+	int frameStart, frameStride;
+	// recorded frame number of each frameId
+	FrameSet frameSet;
 	// name of rgb-d cameras
 	std::vector<std::string> cameraName;
+	// storage of the frames - png folders, packed .rgbdseq containers, videos, or buffers
+	// handed over by an embedding application
+	FRAME_LAYOUT frameLayout;
+	// codec of the planes written by the .rgbdseq converter - "raw" or "png"
+	std::string sequenceCodec;
 
 	/* ----- Checkerboard ----- */
 	int patternWidth, patternHeight;
@@ -65,19 +90,134 @@ public:
 	float stX, stY, stZ;
 	float edX, edY, edZ;
 
+	// check every input file before loading
+	bool bValidateDataset;
+
+	/* ----- Detection ----- */
+	// corner search - "opencv" (findChessboardCorners) or "saddle" (saddle points, no pyramid)
+	std::string detectionBackend;
+	// search the board on a downscaled pyramid level first
+	bool bPyramidDetection;
+	// decode the color frames straight to grayscale, on by default with the pyramid
+	bool bGrayDecode;
+	// expected board width in pixels, 0 = a third of the frame width
+	int expectedBoardPixels;
+	// smallest board square in pixels on the searched pyramid level
+	int minSquarePixels;
+	// track the corners between consecutive frames, searching on keyframes and lost boards only
+	bool bTracking;
+	int keyframeInterval;
+	// reject frames without a board before the search - "off", "fast" or "conservative"
+	std::string presenceCheck;
+	// search every n-th rejected frame anyway to measure the false negatives, 0 = never
+	int presenceAudit;
+	// skip near-duplicate frames - "off", "camera" (each camera on its own) or "synchronized"
+	// (only frames that repeat in every camera, so the camera pairs stay complete)
+	std::string dedup;
+	// max. num. of differing bits of the 256-bit frame hashes of two duplicates
+	int dedupMaxBits;
+	// search the board only around where the first roiAnchorCameras cameras saw it, which needs the
+	// init intrinsics and the extrinsics of a previous calibration
+	bool bRoiPrediction;
+	int roiAnchorCameras;
+	// padding around the predicted board, times its size
+	float roiPadding;
+	// search only around the planar blobs of the board's size in the depth frame, needs the init intrinsic
+	bool bDepthRoi;
+	// the depth frame is segmented at 1 / depthRoiDownscale of its size
+	int depthRoiDownscale;
+	// search the whole frame when the board isn't found in the predicted or depth roi
+	bool bRoiFallback;
+	// score sharpness and exposure first and skip the blurred or badly exposed frames
+	bool bQualityCheck;
+	// min. variance of the Laplacian of the grayscale frame
+	float minSharpness;
+	// max. fraction of crushed (< 16) or saturated (>= 240) pixels, each
+	float maxClipped;
+	// compare every detection with the full resolution search
+	bool bDetectionBenchmark;
+
+	/* ----- Performance ----- */
+	// num. of threads decoding frames, 0 = one per hardware thread
+	int numDecodeThreads;
+	// num. of threads detecting the pattern, shared by all cameras, 0 = one per hardware thread
+	int numDetectThreads;
+	// num. of cameras calibrating their intrinsic at once, 0 = one per hardware thread
+	int numIntrinsicThreads;
+	// calibrate each intrinsic from at most this many views, picked for image coverage and pose
+	// diversity, 0 = all detected views
+	int maxIntrinsicViews;
+	// when fewer views are selected than detected, also calibrate from all views and report the time and
+	// error of both; on by default so a run shows what the subset costs in accuracy
+	bool bCompareIntrinsicViews;
+	// num. of frames each video reader decodes ahead of the requests
+	int videoReadAhead;
+	// read png files ahead of the decode threads
+	bool bReadAhead;
+	// max. num. of file reads in flight
+	int ioQueueDepth;
+	// max. bytes read ahead and not yet decoded
+	size_t ioInFlightBytes;
+	// give up the search of a frame after this many ms, 0 = never
+	double detectDeadlineMs;
+	// search the frames cut short at the deadline again at full resolution while the budget lasts
+	bool bRetryTimedOut;
+	// ms for the detection of all cameras, frames after it aren't searched, 0 = unlimited
+	double detectBudgetMs;
+	// write DetectionStats-<camera>.csv with the status and timings of every frame to the param folder
+	bool bExportDetectionStats;
+	// keep the detections in DetectionCache-<camera>.bin in the param folder and reuse them for
+	// unchanged frames, so a rerun with the same detection settings skips decoding and searching them
+	bool bDetectionCache;
+	// allocator of the cv::Mat buffers - "default" (OpenCV's), "counting" (OpenCV's, counting the
+	// allocations of each stage) or "pooled" (recycled per thread in the detection and solver loops)
+	std::string matAllocator;
+
+	/* ----- Memory ----- */
+	// decode, detect and drop frames instead of keeping all of them resident
+	bool bStreaming;
+	// max. num. of frames decoded at once in streaming mode
+	int streamWindow;
+	// max. bytes of resident frames per camera in streaming mode
+	size_t frameBudgetBytes;
+	// keep depth frames RVL-compressed in bands of depthBandHeight rows
+	bool bCompressDepth;
+	int depthBandHeight;
+
+	/* ----- Debug ----- */
+	// draw the corners of every searched frame in the background - "off", "images" (a jpg per frame)
+	// or "video" (a video of contact sheets per camera), written to debugFolder
+	std::string debugOutput;
+	std::string debugFolder;
+	// max. num. of frames waiting for the writer, further frames are dropped
+	int debugQueueSize;
+	// width of an image or of a contact sheet, 0 = frame size
+	int debugMaxWidth;
+
 	/* ----- Folders ----- */
 	std::string rootFolder;
 	 
 	// folder containing calibration parameters
 	std::string paramFolder;
+	// create paramFolder and save the intrinsics there; off for the default configuration,
+	// which an embedding application uses without touching the disk
+	bool bSaveParams;
 
 	// folders containing depth images
 	std::vector<std::string> depthFolders; // depthFolders[camId]
-	std::vector<std::vector<std::string>> depthFilenames; //depthFilenames[camId][frameId]
+	FramePattern depthPattern;
 
 	// folders containing color images
 	std::vector<std::string> colorFolders; // colorFolders[camId]
-	std::vector<std::vector<std::string>> colorFilenames; // colorFilenames[camId][frameId]
+	FramePattern colorPattern;
+
+	// packed containers holding both color and depth frames
+	std::vector<std::string> sequenceFilenames; // sequenceFilenames[camId]
+
+	// videos holding the color and depth frames
+	std::string videoExtension;
+	std::vector<std::string> colorVideoFilenames; // colorVideoFilenames[camId]
+	std::vector<std::string> depthVideoFilenames; // depthVideoFilenames[camId]
 
 	// rgbd calibration
 	std::string intrinsicFolder;
@@ -85,15 +225,23 @@ public:
 	std::vector<std::string> intrinsicFilenames;
 	std::vector<std::string> extrinsicFilenames;
 
-	int loadConfig(const std::string& fn)
+	std::string getColorFilename(const int camId, const int frameId) const
 	{
-		char buffer[255];
+		return colorFolders[camId] + "/" + colorPattern.format(frameSet.getFrameNumber(frameId));
+	}
+	std::string getDepthFilename(const int camId, const int frameId) const
+	{
+		return depthFolders[camId] + "/" + depthPattern.format(frameSet.getFrameNumber(frameId));
+	}
 
+	// an empty fn gives the default configuration
+	int loadConfig(const std::string& fn)
+	{
 		configFilename = fn;
 
 		INIReader reader(fn);
 
-		if (reader.ParseError() < 0)
+		if (reader.ParseError() < 0 && !fn.empty())
 		{
 			printf("Couldn't load %s\n", fn.c_str());
 			return 1;
@@ -101,58 +249,63 @@ public:
 
 		/* ----- Path ----- */
 		rootFolder	= reader.Get("input", "rootFolder", ".");
-		sprintf_s(buffer, 255, "%s/CalibrationParam", rootFolder.c_str());
-		paramFolder = std::string(buffer);
-		_checkFolder(paramFolder);
+		paramFolder = rootFolder + "/CalibrationParam";
+		bSaveParams = !fn.empty();
+		if (bSaveParams)
+			_checkFolder(paramFolder);
 
 		numFrame	= reader.GetInteger("input", "numFrame", -1);
 		numCamera	= reader.GetInteger("input", "numCamera", -1);
+		frameStart	= reader.GetInteger("input", "frameStart", 0);
+		frameStride	= reader.GetInteger("input", "frameStride", 1);
+		if (frameStride < 1)
+			frameStride = 1;
+
+		std::string layout = reader.Get("input", "layout", "png");
+		if (layout == "rgbdseq")
+			frameLayout = RGBD_SEQUENCE;
+		else if (layout == "video")
+			frameLayout = VIDEO;
+		else
+			frameLayout = PNG_FOLDERS;
+		sequenceCodec = reader.Get("input", "sequenceCodec", "png");
+		videoExtension = reader.Get("input", "videoExtension", "mkv");
+		if (!colorPattern.init(reader.Get("input", "colorPattern", "color%04d.png"))
+			|| !depthPattern.init(reader.Get("input", "depthPattern", "depth%04d.png")))
+			return 1;
+		bValidateDataset = reader.GetBoolean("input", "validate", true);
 
 		/* ----- Camera ----- */
-		cameraName.resize(numCamera);
-		depthFolders.resize(numCamera);
-		colorFolders.resize(numCamera);
-		depthFilenames.resize(numCamera);
-		colorFilenames.resize(numCamera);
-		initIntrinsicFilenames.resize(numCamera);
-		intrinsicFilenames.resize(numCamera);
-		extrinsicFilenames.resize(numCamera);
+		std::vector<std::string> names;
 		for (int camId = 0; camId < numCamera; camId++)
-		{
-			sprintf_s(buffer, 255, "CamName%d", camId);
-			cameraName[camId] = reader.Get("input", std::string(buffer), "");
-
-			// folders
-			sprintf_s(buffer, 255, "%s/Depth-%s", rootFolder.c_str(), cameraName[camId].c_str());
-			depthFolders[camId] = std::string(buffer);
-			_checkFolder(depthFolders[camId]);
-
-			depthFilenames[camId].resize(numFrame);
-			for (int frameId = 0; frameId < numFrame; frameId++)
-			{
-				sprintf_s(buffer, 255, "%s/depth%04d.png", depthFolders[camId].c_str(), frameId);
-				depthFilenames[camId][frameId] = std::string(buffer);
-			}
-
-			sprintf_s(buffer, 255, "%s/Color-%s", rootFolder.c_str(), cameraName[camId].c_str());
-			colorFolders[camId] = std::string(buffer);
-			_checkFolder(colorFolders[camId]);
+			names.push_back(reader.Get("input", "CamName" + std::to_string((long long) camId), ""));
+		setCameras(names);
 
-			colorFilenames[camId].resize(numFrame);
-			for (int frameId = 0; frameId < numFrame; frameId++)
+		// frame paths are resolved on use, numFrame may be left unset for videos which then use every frame
+		std::string frames = reader.Get("input", "frames", "");
+		if (frames == "scan")
+		{
+			std::vector<std::string> folders;
+			std::vector<FramePattern> patterns;
+			for (int camId = 0; camId < numCamera; camId++)
 			{
-				sprintf_s(buffer, 255, "%s/color%04d.png", colorFolders[camId].c_str(), frameId);
-				colorFilenames[camId][frameId] = std::string(buffer);
+				folders.push_back(colorFolders[camId]);
+				patterns.push_back(colorPattern);
+				folders.push_back(depthFolders[camId]);
+				patterns.push_back(depthPattern);
 			}
-
-			// parameter paths
-			sprintf_s(buffer, 255, "%s/%s_init.intr", paramFolder.c_str(), cameraName[camId].c_str());
-			initIntrinsicFilenames[camId] = std::string(buffer);
-			sprintf_s(buffer, 255, "%s/%s.intr", paramFolder.c_str(), cameraName[camId].c_str());
-			intrinsicFilenames[camId] = std::string(buffer);
-			sprintf_s(buffer, 255, "%s/%s_%s.extr", paramFolder.c_str(), cameraName[camId].c_str(), _getMethodName(calibMethod).c_str());
-			extrinsicFilenames[camId] = std::string(buffer);
+			if (!frameSet.initScan(folders, patterns))
+				return 1;
+			numFrame = frameSet.getNumFrame();
 		}
+		else if (!frames.empty())
+		{
+			if (!frameSet.initList(frames))
+				return 1;
+			numFrame = frameSet.getNumFrame();
+		}
+		else
+			frameSet.initRange(frameStart, frameStride, numFrame);
 		
 		/* ----- Checkerboard ----- */
 		patternWidth = reader.GetInteger("checkerboard", "width", -1);
@@ -172,9 +325,100 @@ public:
 		edY = reader.GetReal("localvolume", "endY", 1.8);
 		edZ = reader.GetReal("localvolume", "endZ", 4.5);
 
+		/* ----- Detection ----- */
+		detectionBackend = reader.Get("detection", "backend", "opencv");
+		bPyramidDetection = reader.GetBoolean("detection", "pyramid", false);
+		bGrayDecode = reader.GetBoolean("detection", "grayDecode", bPyramidDetection);
+		expectedBoardPixels = reader.GetInteger("detection", "expectedBoardPixels", 0);
+		minSquarePixels = reader.GetInteger("detection", "minSquarePixels", 12);
+		bTracking = reader.GetBoolean("detection", "tracking", false);
+		keyframeInterval = reader.GetInteger("detection", "keyframeInterval", 30);
+		presenceCheck = reader.Get("detection", "presenceCheck", "off");
+		presenceAudit = reader.GetInteger("detection", "presenceAudit", 0);
+		dedup = reader.Get("detection", "dedup", "off");
+		dedupMaxBits = reader.GetInteger("detection", "dedupMaxBits", 6);
+		bRoiPrediction = reader.GetBoolean("detection", "roiPrediction", false);
+		roiAnchorCameras = reader.GetInteger("detection", "roiAnchorCameras", 1);
+		roiPadding = (float) reader.GetReal("detection", "roiPadding", 0.25);
+		bDepthRoi = reader.GetBoolean("detection", "depthRoi", false);
+		depthRoiDownscale = reader.GetInteger("detection", "depthRoiDownscale", 4);
+		bRoiFallback = reader.GetBoolean("detection", "roiFallback", true);
+		bQualityCheck = reader.GetBoolean("detection", "qualityCheck", false);
+		minSharpness = (float) reader.GetReal("detection", "minSharpness", 30.0);
+		maxClipped = (float) reader.GetReal("detection", "maxClipped", 0.6);
+		bDetectionBenchmark = reader.GetBoolean("detection", "benchmark", false);
+
+		/* ----- Performance ----- */
+		numDecodeThreads = reader.GetInteger("performance", "numDecodeThreads", 0);
+		numDetectThreads = reader.GetInteger("performance", "numDetectThreads", 0);
+		numIntrinsicThreads = reader.GetInteger("performance", "numIntrinsicThreads", 0);
+		maxIntrinsicViews = reader.GetInteger("performance", "maxIntrinsicViews", 50);
+		bCompareIntrinsicViews = reader.GetBoolean("performance", "compareIntrinsicViews", true);
+		videoReadAhead = reader.GetInteger("performance", "videoReadAhead", 8);
+		bReadAhead = reader.GetBoolean("performance", "readAhead", true);
+		ioQueueDepth = reader.GetInteger("performance", "ioQueueDepth", 32);
+		ioInFlightBytes = (size_t) reader.GetInteger("performance", "ioInFlightMB", 256) * 1024 * 1024;
+		detectDeadlineMs = reader.GetReal("performance", "detectDeadlineMs", 0.0);
+		bRetryTimedOut = reader.GetBoolean("performance", "retryTimedOut", false);
+		detectBudgetMs = reader.GetReal("performance", "detectBudgetMs", 0.0);
+		bExportDetectionStats = reader.GetBoolean("performance", "exportDetectionStats", false);
+		bDetectionCache = reader.GetBoolean("performance", "detectionCache", false);
+		matAllocator = reader.Get("performance", "matAllocator", "default");
+
+		/* ----- Memory ----- */
+		bStreaming = reader.GetBoolean("memory", "streaming", false);
+		streamWindow = reader.GetInteger("memory", "streamWindow", 16);
+		frameBudgetBytes = (size_t) reader.GetInteger("memory", "frameBudgetMB", 2048) * 1024 * 1024;
+		bCompressDepth = reader.GetBoolean("memory", "compressDepth", false);
+		depthBandHeight = reader.GetInteger("memory", "depthBandHeight", 16);
+
+		/* ----- Debug ----- */
+		debugOutput = reader.Get("debug", "output", "off");
+		debugFolder = rootFolder + "/DebugDetection";
+		if (debugOutput != "off")
+			_checkFolder(debugFolder);
+		debugQueueSize = reader.GetInteger("debug", "queueSize", 32);
+		debugMaxWidth = reader.GetInteger("debug", "maxWidth", 1280);
+
 		return 0;
 	}
 
+	// set numCamera and the per-camera paths from the camera names
+	void setCameras(const std::vector<std::string>& names)
+	{
+		numCamera = (int) names.size();
+		cameraName = names;
+		depthFolders.resize(numCamera);
+		colorFolders.resize(numCamera);
+		sequenceFilenames.resize(numCamera);
+		colorVideoFilenames.resize(numCamera);
+		depthVideoFilenames.resize(numCamera);
+		initIntrinsicFilenames.resize(numCamera);
+		intrinsicFilenames.resize(numCamera);
+		extrinsicFilenames.resize(numCamera);
+		for (int camId = 0; camId < numCamera; camId++)
+		{
+			sequenceFilenames[camId] = rootFolder + "/" + cameraName[camId] + ".rgbdseq";
+
+			colorVideoFilenames[camId] = rootFolder + "/Color-" + cameraName[camId] + "." + videoExtension;
+			depthVideoFilenames[camId] = rootFolder + "/Depth-" + cameraName[camId] + "." + videoExtension;
+
+			// folders
+			depthFolders[camId] = rootFolder + "/Depth-" + cameraName[camId];
+			colorFolders[camId] = rootFolder + "/Color-" + cameraName[camId];
+			if (frameLayout == PNG_FOLDERS)
+			{
+				_checkFolder(depthFolders[camId]);
+				_checkFolder(colorFolders[camId]);
+			}
+
+			// parameter paths
+			initIntrinsicFilenames[camId] = paramFolder + "/" + cameraName[camId] + "_init.intr";
+			intrinsicFilenames[camId] = paramFolder + "/" + cameraName[camId] + ".intr";
+			extrinsicFilenames[camId] = paramFolder + "/" + cameraName[camId] + "_" + _getMethodName(calibMethod) + ".extr";
+		}
+	}
+
 	inline
 		std::string _getMethodName(const EXTRINSIC_CALIB_METHOD calibMethod)
 	{
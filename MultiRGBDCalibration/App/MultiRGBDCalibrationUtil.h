@@ -39,7 +39,7 @@ struct CameraIntrinsic
 
 	bool save(const std::string& fn)
 	{
-		std::ifstream intrFile(fn, std::ios::in);
+		std::ofstream intrFile(fn, std::ios::out);
 		if (intrFile.is_open())
 		{
 			intrFile << w << " " << h << std::endl;
@@ -83,8 +83,28 @@ typedef CameraIntrinsic<float> CameraIntrinsicF;
 template <typename T>
 struct CameraExtrinsic
 {
+	// x_ref = Rotation * x_cam + Translation, in meters
 	T Rotation[3][3];
 	T Translation[3];
+
+	// rotation row by row, then translation
+	bool load(const std::string& fn)
+	{
+		std::ifstream extrFile(fn, std::ios::in);
+		if (extrFile.is_open())
+		{
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 3; j++)
+					extrFile >> Rotation[i][j];
+			for (int i = 0; i < 3; i++)
+				extrFile >> Translation[i];
+			bool bRead = !extrFile.fail();
+			extrFile.close();
+			return bRead;
+		}
+		else
+			return false;
+	}
 };
 
 typedef CameraExtrinsic<float> CameraExtrinsicF;
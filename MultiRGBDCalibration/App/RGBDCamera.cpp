@@ -1,6 +1,17 @@
 #include "RGBDCamera.h"
+#include "ImageFileFrameSource.h"
 
-RGBDCamera::RGBDCamera() : m_intrinsic(NULL)
+#include <algorithm>
+
+RGBDCamera::RGBDCamera() : m_intrinsic(NULL), m_numIntrinsicView(-1), m_reprojectionError(-1.0f), m_intrinsicTicks(0),
+	m_maxIntrinsicView(0), m_bCompareIntrinsicViews(false), m_numIntrinsicCandidate(0), m_intrinsicCoverage(0.0f),
+	m_fullIntrinsicCoverage(0.0f), m_numIntrinsicPoseBin(0), m_numFullIntrinsicPoseBin(0), m_intrinsicSolveTicks(0),
+	m_fullIntrinsicSolveTicks(-1), m_fullReprojectionError(-1.0f), m_allViewReprojectionError(-1.0f),
+	m_debugWriter(NULL), m_bDetectionBenchmark(false),
+	m_bQualityCheck(false), m_minSharpness(0.0f), m_maxClippedFraction(1.0f), m_bTracking(false), m_keyframeInterval(30),
+	m_presenceAuditInterval(0), m_frameDeadlineTicks(0), m_detectBudgetEndTick(0), m_bRetryTimedOut(false), m_bRoiFallback(true),
+	m_bDepthRoi(false), m_depthRoiPatternLength(0.0f), m_depthRoiFx(0.0f), m_depthRoiDownscale(4),
+	m_dedupRepFrameId(-1), m_streamDedupMaxDistance(-1), m_detectionSettingsKey(0)
 {
 
 }
@@ -18,17 +29,7 @@ void RGBDCamera::clear()
 		m_intrinsic = NULL;
 	}
 
-	for (int frameId = 0; frameId < m_color.size(); frameId++)
-	{
-		m_color[frameId]->release();
-	}
-	m_color.clear();
-
-	for (int frameId = 0; frameId < m_depth.size(); frameId++)
-	{
-		m_depth[frameId]->release();
-	}
-	m_depth.clear();
+	m_frameStore.clear();
 
 	for (int frameId = 0; frameId < m_corners2d.size(); frameId++)
 	{
@@ -42,6 +43,17 @@ void RGBDCamera::clear()
 	}
 	m_corners3d.clear();
 
+	m_frameHash.clear();
+	m_bHashed.clear();
+	m_bDuplicate.clear();
+	m_hashTicks.clear();
+	m_dedupRepFrameId = -1;
+
+	m_detectionCache.clear();
+	m_frameKey.clear();
+	m_bKeyed.clear();
+	m_cacheResult.clear();
+
 	if (m_cameraMatrix.data != NULL)
 	{
 		m_cameraMatrix.release();
@@ -61,21 +73,436 @@ void RGBDCamera::init(const std::vector<std::string> colorFilenames,
 	const int& patternHeight,
 	const float& patternLength,
 	const CameraIntrinsicF* intrinsic)
+{
+	FrameDecodePool decodePool;
+	decodePool.init(0);
+
+	loadFrames(new ImageFileFrameSource(colorFilenames, depthFilenames), decodePool);
+	decodePool.wait();
+
+	initFromLoadedFrames(patternWidth, patternHeight, patternLength, intrinsic);
+}
+
+void RGBDCamera::loadFrames(FrameSource* source, FrameDecodePool& decodePool)
 {
 	clear();
 
-	m_numFrame = (int) colorFilenames.size();
+	m_numFrame = source->getNumFrame();
+	_initFrameHashes();
+	_readDetectionCache(source);
+
+	m_frameStore.init(source);
+	_requestFrames(0, m_numFrame, decodePool);
+}
+
+void RGBDCamera::initFromLoadedFrames(const int& patternWidth,
+	const int& patternHeight,
+	const float& patternLength,
+	const CameraIntrinsicF* intrinsic)
+{
+	WorkStealingPool detectPool;
+	detectPool.init(0);
+
+	detectCorners(patternWidth, patternHeight, detectPool);
+	detectPool.wait();
+
+	initFromDetectedCorners(patternWidth, patternHeight, patternLength, intrinsic);
+}
+
+void RGBDCamera::hashFrames(WorkStealingPool& detectPool)
+{
+	m_frameStore.checkFrames(0, m_numFrame);
+
+	_initFrameHashes();
+	_queueFrameHashes(0, m_numFrame, detectPool);
+}
+
+int RGBDCamera::markDuplicateFrames(const int maxDistance)
+{
+	m_dedupRepFrameId = -1;
+	return _markDuplicates(0, m_numFrame, maxDistance);
+}
+
+void RGBDCamera::detectCorners(const int& patternWidth,
+	const int& patternHeight,
+	WorkStealingPool& detectPool)
+{
+	m_frameStore.checkFrames(0, m_numFrame);
+
+	_initCorners();
+	_applyDetectionCache(0, m_numFrame);
+	_queueCorners2d(0, m_numFrame, cv::Size(patternWidth, patternHeight), detectPool);
+}
+
+int RGBDCamera::retryTimedOutFrames(WorkStealingPool& detectPool)
+{
+	return _queueRetries(0, m_numFrame, detectPool);
+}
+
+void RGBDCamera::initFromDetectedCorners(const int& patternWidth,
+	const int& patternHeight,
+	const float& patternLength,
+	const CameraIntrinsicF* intrinsic)
+{
+	reportDetection();
+	calibrateIntrinsic(patternWidth, patternHeight, patternLength, intrinsic);
+	printIntrinsic();
+	initCorners3d();
+}
 
-	_loadColor(colorFilenames);
-	_loadDepth(depthFilenames);
-	_extractCorners2dCheckerboard(cv::Size(patternWidth, patternHeight));
+void RGBDCamera::reportDetection()
+{
+	_checkCorners2d(0, m_numFrame);
+	printDetectionStats();
+	_writeDetectionCache();
+}
+
+void RGBDCamera::calibrateIntrinsic(const int& patternWidth,
+	const int& patternHeight,
+	const float& patternLength,
+	const CameraIntrinsicF* intrinsic)
+{
+	int64 startTick = cv::getTickCount();
+	_initIntrinsic(cv::Size(patternWidth, patternHeight), patternLength, intrinsic);
+	m_intrinsicTicks = cv::getTickCount() - startTick;
+}
 
+void RGBDCamera::printIntrinsic() const
+{
+	if (m_intrinsic == NULL)
+		return;
+
+	if (isIntrinsicCalibrated())
+	{
+		if (m_numIntrinsicView == 0)
+		{
+			printf("No board found to compute the intrinsic from!\n");
+			return;
+		}
+		printf("Computed the intrinsic from %d of %d views in %.1f s (solve %.1f s)\n", m_numIntrinsicView,
+			m_numIntrinsicCandidate, getIntrinsicSeconds(), m_intrinsicSolveTicks / cv::getTickFrequency());
+		if (m_numIntrinsicView < m_numIntrinsicCandidate)
+		{
+			printf("Selected views cover %.0f%% of the image and %d pose bins (all views %.0f%%, %d)\n",
+				m_intrinsicCoverage * 100.0f, m_numIntrinsicPoseBin, m_fullIntrinsicCoverage * 100.0f, m_numFullIntrinsicPoseBin);
+		}
+		printf("Reprojection Error is %f\n", m_reprojectionError);
+		if (m_fullIntrinsicSolveTicks >= 0)
+		{
+			printf("All %d views: solve %.1f s, reprojection error %f; the selected intrinsic reprojects them with error %f\n",
+				m_numIntrinsicCandidate, m_fullIntrinsicSolveTicks / cv::getTickFrequency(),
+				m_fullReprojectionError, m_allViewReprojectionError);
+		}
+	}
+	m_intrinsic->printParam();
+}
+
+void RGBDCamera::initCorners3d()
+{
+	// a streamed camera fetches its depth frames again one by one
+	bool bStreaming = m_frameStore.isStreaming();
+	for (int frameId = 0; frameId < m_numFrame; frameId++)
+	{
+		_extractCorners3d(frameId);
+		if (bStreaming)
+			m_frameStore.releaseFrames(frameId, frameId + 1);
+	}
+
+	m_frameStore.printDepthCompressionStats();
+}
+
+void RGBDCamera::streamFrames(FrameSource* source,
+	const int& patternWidth,
+	const int& patternHeight,
+	const float& patternLength,
+	FrameDecodePool& decodePool,
+	WorkStealingPool& detectPool,
+	const size_t budgetBytes,
+	const int windowSize,
+	const CameraIntrinsicF* intrinsic,
+	const bool bDeferIntrinsic)
+{
+	clear();
+
+	cv::Size patternSize(patternWidth, patternHeight);
+	m_numFrame = source->getNumFrame();
+
+	_initFrameHashes();
+	_readDetectionCache(source);
+	m_frameStore.init(source, budgetBytes);
+	_initCorners();
+	_applyDetectionCache(0, m_numFrame);
+
+	// 3d corners can be extracted inside the window only if the intrinsic is known
+	if (intrinsic != NULL)
+		_initIntrinsic(patternSize, patternLength, intrinsic);
+
+	int frameStart = 0;
+	while (frameStart < m_numFrame)
+	{
+		// start with a single frame to measure the frame size, then fill the budget
+		int numWindowFrame = 1;
+		size_t frameBytes = m_frameStore.getFrameBytes();
+		if (frameBytes > 0)
+			numWindowFrame = std::max(1, std::min(windowSize, (int) (budgetBytes / frameBytes)));
+		int frameEnd = std::min(frameStart + numWindowFrame, m_numFrame);
+
+		_requestFrames(frameStart, frameEnd, decodePool);
+		decodePool.wait();
+		m_frameStore.checkFrames(frameStart, frameEnd);
+
+		if (m_streamDedupMaxDistance >= 0)
+		{
+			_queueFrameHashes(frameStart, frameEnd, detectPool);
+			detectPool.wait();
+			_markDuplicates(frameStart, frameEnd, m_streamDedupMaxDistance);
+		}
+
+		_queueCorners2d(frameStart, frameEnd, patternSize, detectPool);
+		detectPool.wait();
+		if (m_bRetryTimedOut && _queueRetries(frameStart, frameEnd, detectPool) > 0)
+			detectPool.wait();
+		_checkCorners2d(frameStart, frameEnd);
+
+		if (intrinsic != NULL)
+		{
+			for (int frameId = frameStart; frameId < frameEnd; frameId++)
+				_extractCorners3d(frameId);
+		}
+
+		m_frameStore.releaseFrames(frameStart, frameEnd);
+		frameStart = frameEnd;
+	}
+
+	printDetectionStats();
+	_writeDetectionCache();
+
+	// the 3d corners were extracted inside the windows if the intrinsic was known,
+	// otherwise the depth frames are fetched again on demand
+	if (intrinsic != NULL)
+	{
+		printIntrinsic();
+		m_frameStore.printDepthCompressionStats();
+	}
+	else if (!bDeferIntrinsic)
+	{
+		calibrateIntrinsic(patternWidth, patternHeight, patternLength, intrinsic);
+		printIntrinsic();
+		initCorners3d();
+	}
+
+	printf("Peak resident frame memory %.1f MB (budget %.1f MB)\n",
+		m_frameStore.getPeakResidentBytes() / (1024.0 * 1024.0),
+		budgetBytes / (1024.0 * 1024.0));
+}
+
+void RGBDCamera::_initCorners()
+{
+	m_bPatternDetected.assign(m_numFrame, 0);
+	m_detectTicks.assign(m_numFrame, 0);
+	m_detectLatencyTicks.assign(m_numFrame, 0);
+	m_detectLevel.assign(m_numFrame, 0);
+	m_bTracked.assign(m_numFrame, 0);
+	m_bRejected.assign(m_numFrame, 0);
+	m_presenceTicks.assign(m_numFrame, 0);
+	m_auditResult.assign(m_numFrame, 0);
+	m_auditTicks.assign(m_numFrame, 0);
+	m_frameQuality.assign(m_numFrame, FrameQuality());
+	m_qualityResult.assign(m_numFrame, QUALITY_OK);
+	m_qualityTicks.assign(m_numFrame, 0);
+	m_roiResult.assign(m_numFrame, 0);
+	m_depthRoiResult.assign(m_numFrame, 0);
+	m_depthRoiFraction.assign(m_numFrame, 0.0f);
+	m_depthRoiTicks.assign(m_numFrame, 0);
+	m_timeoutResult.assign(m_numFrame, TIMEOUT_NONE);
+	m_bRetried.assign(m_numFrame, 0);
+	m_benchmarkTicks.assign(m_numFrame, 0);
+	m_bBenchmarkDetected.assign(m_numFrame, 0);
+	m_benchmarkError.assign(m_numFrame, -1.0f);
+	m_corners2d.assign(m_numFrame, corner2d_t());
+	m_corners3d.assign(m_numFrame, corner3d_t());
+}
+
+void RGBDCamera::_readDetectionCache(FrameSource* source)
+{
+	m_detectionCache.clear();
+	m_frameKey.assign(m_numFrame, 0);
+	m_bKeyed.assign(m_numFrame, 0);
+	m_cacheResult.assign(m_numFrame, CACHE_MISS);
+	if (m_detectionCacheFilename.empty())
+		return;
+
+	int64 startTick = cv::getTickCount();
+	m_detectionCache.load(m_detectionCacheFilename, m_detectionSettingsKey, m_detectionCachePatternSize);
+
+	int numCached = 0;
+	for (int frameId = 0; frameId < m_numFrame; frameId++)
+	{
+		if (!source->getContentKey(frameId, FrameSource::COLOR, m_frameKey[frameId]))
+			continue;
+		m_bKeyed[frameId] = 1;
+
+		bool bFound = false;
+		corner2d_t corners;
+		if (!m_detectionCache.find(m_frameKey[frameId], bFound, corners))
+			continue;
+		m_cacheResult[frameId] = bFound ? CACHE_BOARD : CACHE_NO_BOARD;
+		numCached++;
+	}
+
+	printf("Detection cache: %d of %d frames in %s (%.1f ms)\n", numCached, m_numFrame, m_detectionCacheFilename.c_str(),
+		(cv::getTickCount() - startTick) * 1000.0 / cv::getTickFrequency());
+}
+
+void RGBDCamera::_requestFrames(const int frameStart, const int frameEnd, FrameDecodePool& decodePool)
+{
+	// runs of frames that need the same planes
+	int runStart = frameStart, runResult = -1;
+	for (int frameId = frameStart; frameId <= frameEnd; frameId++)
+	{
+		int result = (frameId < frameEnd) ? m_cacheResult[frameId] : -1;
+		if (result == runResult)
+			continue;
+
+		if (runResult == CACHE_MISS)
+			m_frameStore.requestFrames(runStart, frameId, decodePool);
+		else if (runResult == CACHE_BOARD)
+			m_frameStore.requestFrames(runStart, frameId, decodePool, false);
+		runStart = frameId;
+		runResult = result;
+	}
+}
+
+void RGBDCamera::_applyDetectionCache(const int frameStart, const int frameEnd)
+{
+	for (int frameId = frameStart; frameId < frameEnd; frameId++)
+	{
+		if (m_cacheResult[frameId] == CACHE_MISS)
+			continue;
+
+		bool bFound = false;
+		m_detectionCache.find(m_frameKey[frameId], bFound, m_corners2d[frameId]);
+		m_bPatternDetected[frameId] = bFound ? 1 : 0;
+	}
+}
+
+void RGBDCamera::_writeDetectionCache()
+{
+	if (m_detectionCacheFilename.empty())
+		return;
+
+	// only the frames of this run are kept; frames without a final result, e.g. given up at
+	// the deadline, are searched again next time
+	DetectionCache cache;
+	cache.init(m_detectionSettingsKey, m_detectionCachePatternSize);
+	cache.setColorSize(_getColorSize());
+	int numNew = 0;
+	for (int frameId = 0; frameId < m_numFrame; frameId++)
+	{
+		if (!m_bKeyed[frameId])
+			continue;
+
+		if (m_cacheResult[frameId] == CACHE_MISS)
+		{
+			DETECT_STATUS status = getDetectStatus(frameId);
+			if (status == DETECT_NOT_SEARCHED || status == DETECT_TIMEOUT || status == DETECT_OVER_BUDGET)
+				continue;
+			numNew++;
+		}
+		cache.add(m_frameKey[frameId], m_bPatternDetected[frameId] != 0, m_corners2d[frameId]);
+	}
+	if (numNew == 0 && cache.getNumEntry() == m_detectionCache.getNumEntry())
+		return;
+
+	if (cache.save(m_detectionCacheFilename))
+		printf("Detection cache: stored %d frames, %d of them new, in %s\n", cache.getNumEntry(), numNew,
+			m_detectionCacheFilename.c_str());
+}
+
+cv::Size RGBDCamera::_getColorSize() const
+{
+	cv::Size colorSize = m_frameStore.getColorSize();
+	return (colorSize.area() > 0) ? colorSize : m_detectionCache.getColorSize();
+}
+
+void RGBDCamera::_initFrameHashes()
+{
+	m_frameHash.assign(m_numFrame, FrameHash());
+	m_bHashed.assign(m_numFrame, 0);
+	m_bDuplicate.assign(m_numFrame, 0);
+	m_hashTicks.assign(m_numFrame, 0);
+	m_dedupRepFrameId = -1;
+}
+
+void RGBDCamera::_queueFrameHashes(const int frameStart, const int frameEnd, WorkStealingPool& detectPool)
+{
+	bool bGrayPlane = m_frameStore.hasGrayPlane();
+	for (int frameId = frameStart; frameId < frameEnd; frameId++)
+	{
+		m_bHashed[frameId] = 0;
+		if (m_cacheResult[frameId] != CACHE_MISS)
+			continue;
+
+		cv::Mat frameMat = bGrayPlane ? m_frameStore.getGray(frameId) : m_frameStore.getColor(frameId);
+		if (frameMat.data == NULL)
+			continue;
+
+		detectPool.enqueue(std::bind(&RGBDCamera::_computeFrameHash, this, frameId, frameMat));
+	}
+}
+
+void RGBDCamera::_computeFrameHash(const int frameId, const cv::Mat frameMat)
+{
+	AllocationStage allocationStage(STAGE_DETECT);
+
+	int64 startTick = cv::getTickCount();
+	m_frameHash[frameId] = computeFrameHash(frameMat);
+	m_hashTicks[frameId] = cv::getTickCount() - startTick;
+	m_bHashed[frameId] = 1;
+}
+
+int RGBDCamera::_markDuplicates(const int frameStart, const int frameEnd, const int maxDistance)
+{
+	// compare with the first frame of the group rather than the previous one,
+	// so a slow drift still starts a new group
+	int numDuplicate = 0;
+	for (int frameId = frameStart; frameId < frameEnd; frameId++)
+	{
+		m_bDuplicate[frameId] = 0;
+		if (!m_bHashed[frameId])
+			continue;
+
+		if (m_dedupRepFrameId >= 0
+			&& frameHashDistance(m_frameHash[m_dedupRepFrameId], m_frameHash[frameId]) <= maxDistance)
+		{
+			m_bDuplicate[frameId] = 1;
+			numDuplicate++;
+		}
+		else
+			m_dedupRepFrameId = frameId;
+	}
+	return numDuplicate;
+}
+
+bool RGBDCamera::_isDuplicateGap(const int prevFrameId, const int frameId) const
+{
+	for (int gapFrameId = prevFrameId + 1; gapFrameId < frameId; gapFrameId++)
+	{
+		if (!isDuplicateFrame(gapFrameId))
+			return false;
+	}
+	return prevFrameId < frameId;
+}
+
+void RGBDCamera::_initIntrinsic(const cv::Size patternSize, const float& patternLength, const CameraIntrinsicF* intrinsic)
+{
 	m_intrinsic = new CameraIntrinsicF;
+	m_numIntrinsicView = -1;
+	m_reprojectionError = -1.0f;
 	if (intrinsic == NULL)
 	{
 		// perform intrinsic calibration when needed
-		printf("Need to compute intrinsic!\n");
-		_computeIntrinsic(cv::Size(patternWidth, patternHeight), patternLength);
+		_computeIntrinsic(patternSize, patternLength);
 	}
 	else {
 		m_intrinsic->copyFrom(intrinsic);
@@ -90,162 +517,822 @@ void RGBDCamera::init(const std::vector<std::string> colorFilenames,
 	}
 }
 
-void RGBDCamera::_loadColor(const std::vector<std::string> colorFilenames)
+void RGBDCamera::_queueCorners2d(const int frameStart, const int frameEnd, const cv::Size patternSize, WorkStealingPool& detectPool)
 {
-	int numColor = (int) colorFilenames.size();
+	m_detector.init(patternSize);
+	if (m_bDepthRoi)
+		m_depthFinder.init(patternSize, m_depthRoiPatternLength, m_depthRoiFx, m_depthRoiDownscale);
+
+	int64 queueTick = cv::getTickCount();
 
-	m_color.resize(numColor);
-	for (int frameId = 0; frameId < numColor; frameId++)
+	// one job per frame, or per run of frames from one keyframe to the next when tracking.
+	// The frames are taken from the store here, the workers only see their own matrices
+	bool bGrayPlane = m_frameStore.hasGrayPlane();
+	std::vector<int> frameIds;
+	std::vector<cv::Mat> colorMats, grayMats, depthMats;
+	for (int frameId = frameStart; frameId < frameEnd; frameId++)
 	{
-		cv::Mat colorMat = cv::imread(colorFilenames[frameId]);
-		if (colorMat.data != NULL)
+		// the cached result is already in place
+		if (m_cacheResult[frameId] != CACHE_MISS)
+			continue;
+
+		m_bPatternDetected[frameId] = 0;
+		m_corners2d[frameId].clear();
+
+		// a near-duplicate is represented by an earlier frame
+		if (isDuplicateFrame(frameId))
+			continue;
+
+		cv::Mat colorMat = m_frameStore.getColor(frameId);
+		if (colorMat.data == NULL)
+			continue;
+
+		if (!frameIds.empty() && (!m_bTracking || frameId % m_keyframeInterval == 0))
 		{
-			m_color[frameId] = new cv::Mat;
-			*m_color[frameId] = colorMat;
+			detectPool.enqueue(std::bind(&RGBDCamera::_extractCorners2dCheckerboard, this,
+				frameIds, colorMats, grayMats, depthMats, queueTick, false));
+			frameIds.clear();
+			colorMats.clear();
+			grayMats.clear();
+			depthMats.clear();
 		}
-		else {
-			m_color[frameId] = NULL;
-			printf("Loading color frame %d failed! - %s\n", frameId, colorFilenames[frameId].c_str());
-		}
-		colorMat.release();
+
+		frameIds.push_back(frameId);
+		colorMats.push_back(colorMat);
+		grayMats.push_back(bGrayPlane ? m_frameStore.getGray(frameId) : cv::Mat());
+		depthMats.push_back(m_bDepthRoi ? m_frameStore.getDepth(frameId) : cv::Mat());
+	}
+
+	if (!frameIds.empty())
+	{
+		detectPool.enqueue(std::bind(&RGBDCamera::_extractCorners2dCheckerboard, this,
+			frameIds, colorMats, grayMats, depthMats, queueTick, false));
 	}
 }
 
-void RGBDCamera::_loadDepth(const std::vector<std::string> depthFilenames)
+int RGBDCamera::_queueRetries(const int frameStart, const int frameEnd, WorkStealingPool& detectPool)
 {
-	int numDepth = (int) depthFilenames.size();
+	if (m_detectBudgetEndTick > 0 && cv::getTickCount() > m_detectBudgetEndTick)
+		return 0;
 
-	m_depth.resize(numDepth);
-	for (int frameId = 0; frameId < numDepth; frameId++)
+	// one job per frame, the frames around a timed out one are done
+	int64 queueTick = cv::getTickCount();
+	bool bGrayPlane = m_frameStore.hasGrayPlane();
+	int numRetry = 0;
+	for (int frameId = frameStart; frameId < frameEnd; frameId++)
 	{
-		cv::Mat depthMat = cv::imread(depthFilenames[frameId], CV_LOAD_IMAGE_ANYDEPTH); // 16-bit unsigned short
-		if (depthMat.data != NULL)
+		if (m_timeoutResult[frameId] != TIMEOUT_FRAME)
+			continue;
+
+		cv::Mat colorMat = m_frameStore.getColor(frameId);
+		if (colorMat.data == NULL)
+			continue;
+
+		detectPool.enqueue(std::bind(&RGBDCamera::_extractCorners2dCheckerboard, this,
+			std::vector<int>(1, frameId), std::vector<cv::Mat>(1, colorMat),
+			std::vector<cv::Mat>(1, bGrayPlane ? m_frameStore.getGray(frameId) : cv::Mat()),
+			std::vector<cv::Mat>(1, m_bDepthRoi ? m_frameStore.getDepth(frameId) : cv::Mat()), queueTick, true));
+		numRetry++;
+	}
+	return numRetry;
+}
+
+void RGBDCamera::_extractCorners2dCheckerboard(const std::vector<int> frameIds,
+	const std::vector<cv::Mat> colorMats, const std::vector<cv::Mat> grayMats, const std::vector<cv::Mat> depthMats,
+	const int64 queueTick, const bool bRetry)
+{
+	AllocationStage allocationStage(STAGE_DETECT);
+
+	// reused from frame to frame of the job; the pyramids are only read while prevFrameId is set,
+	// which needs them to be rebuilt, so they are kept allocated instead of cleared
+	std::vector<cv::Mat> prevPyramid, pyramid;
+	cv::Mat grayScratch;
+	corner2d_t frameCorners;
+	int prevFrameId = -1;
+
+	for (int i = 0; i < frameIds.size(); i++)
+	{
+		int frameId = frameIds[i];
+		int64 startTick = cv::getTickCount();
+
+		// past the budget the frame isn't searched at all, a retry keeps its first result
+		if (m_detectBudgetEndTick > 0 && startTick > m_detectBudgetEndTick)
+		{
+			if (!bRetry)
+				m_timeoutResult[frameId] = TIMEOUT_BUDGET;
+			_finishDetection(frameId, startTick, queueTick);
+			prevFrameId = -1;
+			continue;
+		}
+
+		// a retry is only bound by the budget
+		int64 deadlineTick = m_detectBudgetEndTick;
+		if (m_frameDeadlineTicks > 0 && !bRetry && (deadlineTick == 0 || startTick + m_frameDeadlineTicks < deadlineTick))
+			deadlineTick = startTick + m_frameDeadlineTicks;
+		m_timeoutResult[frameId] = TIMEOUT_NONE;
+		m_bRetried[frameId] = bRetry ? 1 : 0;
+
+		cv::Mat frameGrayMat = grayMats[i];
+		if (frameGrayMat.data == NULL)
+		{
+			cv::cvtColor(colorMats[i], grayScratch, CV_RGB2GRAY);
+			frameGrayMat = grayScratch;
+		}
+
+		// a blurred or badly exposed frame is not searched at all and breaks the tracking
+		if (m_bQualityCheck)
+		{
+			int64 qualityTick = cv::getTickCount();
+			const FrameQuality& quality = m_frameQuality[frameId] = computeFrameQuality(frameGrayMat);
+			m_qualityTicks[frameId] = cv::getTickCount() - qualityTick;
+
+			if (quality.sharpness < m_minSharpness)
+				m_qualityResult[frameId] = QUALITY_BLURRED;
+			else if (quality.darkFraction > m_maxClippedFraction || quality.brightFraction > m_maxClippedFraction)
+				m_qualityResult[frameId] = QUALITY_EXPOSURE;
+			else
+				m_qualityResult[frameId] = QUALITY_OK;
+
+			if (m_qualityResult[frameId] != QUALITY_OK)
+			{
+				_finishDetection(frameId, startTick, queueTick);
+				if (m_debugWriter != NULL)
+					_pushDebugImage(frameId, colorMats[i]);
+				prevFrameId = -1;
+				continue;
+			}
+		}
+
+		// the pyramid is only needed to track from the previous or into the next frame of the job;
+		// skipped duplicates in between look like the previous frame
+		bool bTrackFrom = prevFrameId >= 0 && _isDuplicateGap(prevFrameId, frameId);
+		if (bTrackFrom || i + 1 < frameIds.size())
+			m_detector.buildTrackingPyramid(frameGrayMat, pyramid);
+
+		// search from scratch on the keyframe and whenever the board was lost
+		frameCorners.clear();
+		int level = 0;
+		bool bTracked = bTrackFrom
+			&& m_detector.track(prevPyramid, m_corners2d[prevFrameId], pyramid, frameGrayMat, frameCorners);
+
+		// the presence check only guards the expensive search, a retried frame has passed it
+		bool bRejected = false;
+		if (!bTracked && !bRetry && m_detector.getPresenceCheck() != CheckerboardDetector::PRESENCE_OFF)
+		{
+			int64 checkTick = cv::getTickCount();
+			bRejected = !m_detector.isBoardPresent(frameGrayMat);
+			m_presenceTicks[frameId] = cv::getTickCount() - checkTick;
+		}
+
+		// a predicted roi is searched first, then the depth rois; the search is cut short when a step
+		// isn't started for the deadline. The retry of a frame cut short runs the one search it never
+		// finished, findChessboardCorners on the whole frame at full resolution, and keeps the roi results
+		bool bDetected = bTracked;
+		bool bCutShort = false;
+		if (bRetry)
 		{
-			m_depth[frameId] = new cv::Mat;
-			*m_depth[frameId] = depthMat;
+			bDetected = m_detector.detectFullResolution(frameGrayMat, frameCorners);
 		}
-		else {
-			m_depth[frameId] = NULL;
-			printf("Loading depth frame %d failed! - %s\n", frameId, depthFilenames[frameId].c_str());
+		else
+		{
+			bool bSearch = !bTracked && !bRejected;
+			m_roiResult[frameId] = 0;
+			if (bSearch && frameId < m_searchRois.size() && m_searchRois[frameId].area() > 0)
+			{
+				bDetected = m_detector.detectInRoi(frameGrayMat, m_searchRois[frameId], frameCorners, &level,
+					deadlineTick, &bCutShort);
+				m_roiResult[frameId] = bDetected ? 1 : 2;
+				bSearch = !bDetected && !bCutShort && m_bRoiFallback;
+			}
+			m_depthRoiResult[frameId] = 0;
+			if (bSearch && m_bDepthRoi && depthMats[i].data != NULL)
+			{
+				bDetected = _detectInDepthRois(frameId, frameGrayMat, depthMats[i], frameCorners, &level,
+					deadlineTick, &bCutShort);
+				bSearch = !bDetected && !bCutShort && m_bRoiFallback;
+			}
+			if (bSearch)
+				bDetected = m_detector.detect(frameGrayMat, frameCorners, &level, deadlineTick, &bCutShort);
 		}
-		depthMat.release();
+		m_bRejected[frameId] = bRejected ? 1 : 0;
+
+		m_bPatternDetected[frameId] = bDetected ? 1 : 0;
+		m_bTracked[frameId] = bTracked ? 1 : 0;
+		m_corners2d[frameId] = frameCorners;
+		m_detectLevel[frameId] = level;
+
+		// only a search cut short is given up, one that ran to its end past the deadline is just slow
+		int64 endTick = _finishDetection(frameId, startTick, queueTick);
+		if (bCutShort)
+			m_timeoutResult[frameId] = (m_detectBudgetEndTick > 0 && endTick > m_detectBudgetEndTick) ? TIMEOUT_BUDGET : TIMEOUT_FRAME;
+
+		// a board found by the audit is kept, only the statistics tell it was missed
+		if (bRejected && m_presenceAuditInterval > 0 && frameId % m_presenceAuditInterval == 0)
+		{
+			int64 auditTick = cv::getTickCount();
+			bDetected = m_detector.detect(frameGrayMat, frameCorners, &level);
+			m_auditTicks[frameId] = cv::getTickCount() - auditTick;
+			m_auditResult[frameId] = bDetected ? 2 : 1;
+			m_bPatternDetected[frameId] = bDetected ? 1 : 0;
+			m_corners2d[frameId] = frameCorners;
+			m_detectLevel[frameId] = level;
+		}
+
+		if (m_bDetectionBenchmark)
+			_benchmarkCorners2d(frameId, frameGrayMat);
+		if (m_debugWriter != NULL)
+			_pushDebugImage(frameId, colorMats[i]);
+
+		prevPyramid.swap(pyramid);
+		prevFrameId = bDetected ? frameId : -1;
 	}
 }
 
-void RGBDCamera::_extractCorners2dCheckerboard(const cv::Size patternSize)
+bool RGBDCamera::_detectInDepthRois(const int frameId, const cv::Mat& grayMat, const cv::Mat& depthMat,
+	corner2d_t& corners, int* level, const int64 deadlineTick, bool* bCutShort)
 {
-	cv::Mat grayMat;
+	int64 startTick = cv::getTickCount();
+	std::vector<cv::Rect> rois;
+	m_depthFinder.findCandidates(depthMat, grayMat.size(), rois);
+	m_depthRoiTicks[frameId] = cv::getTickCount() - startTick;
 
-	m_corners2d.clear();
-	m_bPatternDetected.resize(m_numFrame);
+	int roiArea = 0;
+	for (int roiId = 0; roiId < rois.size(); roiId++)
+		roiArea += rois[roiId].area();
+	m_depthRoiFraction[frameId] = (float) roiArea / grayMat.size().area();
+
+	if (rois.empty())
+	{
+		m_depthRoiResult[frameId] = 3;
+		return false;
+	}
+
+	for (int roiId = 0; roiId < rois.size(); roiId++)
+	{
+		if (m_detector.detectInRoi(grayMat, rois[roiId], corners, level, deadlineTick, bCutShort))
+		{
+			m_depthRoiResult[frameId] = 1;
+			return true;
+		}
+		if (*bCutShort)
+			break;
+	}
+	m_depthRoiResult[frameId] = 2;
+	return false;
+}
+
+int64 RGBDCamera::_finishDetection(const int frameId, const int64 startTick, const int64 queueTick)
+{
+	// the latency is the one of the first attempt
+	int64 endTick = cv::getTickCount();
+	m_detectTicks[frameId] += endTick - startTick;
+	if (m_detectLatencyTicks[frameId] == 0)
+		m_detectLatencyTicks[frameId] = endTick - queueTick;
+	return endTick;
+}
+
+void RGBDCamera::_benchmarkCorners2d(const int frameId, const cv::Mat& grayMat)
+{
+	int64 startTick = cv::getTickCount();
+	corner2d_t fullCorners;
+	bool bDetected = m_detector.detectFullResolution(grayMat, fullCorners);
+	m_benchmarkTicks[frameId] = cv::getTickCount() - startTick;
+	m_bBenchmarkDetected[frameId] = bDetected ? 1 : 0;
+
+	const corner2d_t& frameCorners = m_corners2d[frameId];
+	if (!bDetected || !m_bPatternDetected[frameId] || fullCorners.size() != frameCorners.size())
+		return;
+
+	// the saddle point backend may order a board turned upside down from the last corner
+	int numCorner = (int) frameCorners.size();
+	double sumSquaredError = 0, sumSquaredReversedError = 0;
+	for (int cornerId = 0; cornerId < numCorner; cornerId++)
+	{
+		cv::Point2f diff = frameCorners[cornerId] - fullCorners[cornerId];
+		cv::Point2f reversedDiff = frameCorners[cornerId] - fullCorners[numCorner - 1 - cornerId];
+		sumSquaredError += diff.x * diff.x + diff.y * diff.y;
+		sumSquaredReversedError += reversedDiff.x * reversedDiff.x + reversedDiff.y * reversedDiff.y;
+	}
+	m_benchmarkError[frameId] = (float) std::sqrt(std::min(sumSquaredError, sumSquaredReversedError) / numCorner);
+}
+
+void RGBDCamera::_pushDebugImage(const int frameId, const cv::Mat& colorMat)
+{
+	// a frame given up at the deadline is pushed again by its retry
+	std::string label = getDetectStatusName(getDetectStatus(frameId));
+	if (m_bTracked[frameId])
+		label += " (tracked)";
+	else if (m_bPatternDetected[frameId] && m_detectLevel[frameId] > 0)
+		label += " (level " + std::to_string((long long) m_detectLevel[frameId]) + ")";
+	m_debugWriter->push(m_debugName, frameId, colorMat, m_corners2d[frameId], m_detector.getPatternSize(),
+		m_bPatternDetected[frameId] != 0, label);
+}
+
+void RGBDCamera::_checkCorners2d(const int frameStart, const int frameEnd)
+{
+	for (int frameId = frameStart; frameId < frameEnd; frameId++)
+	{
+		// a cached frame is neither decoded nor searched
+		if (m_cacheResult[frameId] != CACHE_MISS)
+			continue;
+
+		if (m_qualityResult[frameId] == QUALITY_BLURRED)
+			printf("Skipped blurred frame %d (sharpness %.1f)\n", frameId, m_frameQuality[frameId].sharpness);
+		else if (m_qualityResult[frameId] == QUALITY_EXPOSURE)
+			printf("Skipped badly exposed frame %d (%.0f%% dark, %.0f%% saturated)\n", frameId,
+				100.0f * m_frameQuality[frameId].darkFraction, 100.0f * m_frameQuality[frameId].brightFraction);
+		else if (m_timeoutResult[frameId] == TIMEOUT_FRAME)
+			printf("Gave up on frame %d after %.0f ms!\n", frameId, m_detectTicks[frameId] * 1000.0 / cv::getTickFrequency());
+		else if (m_timeoutResult[frameId] == TIMEOUT_BUDGET)
+			continue;
+		else if (!m_bPatternDetected[frameId] && m_detectLatencyTicks[frameId] > 0)
+			printf("Pattern not found in frame %d!\n", frameId);
+	}
+}
+
+RGBDCamera::DETECT_STATUS RGBDCamera::getDetectStatus(int frameId) const
+{
+	if (isDuplicateFrame(frameId))
+		return DETECT_DUPLICATE;
+	if (m_bPatternDetected[frameId])
+		return DETECT_FOUND;
+	if (m_cacheResult[frameId] != CACHE_MISS)
+		return DETECT_NOT_FOUND;
+	if (m_timeoutResult[frameId] == TIMEOUT_FRAME)
+		return DETECT_TIMEOUT;
+	if (m_timeoutResult[frameId] == TIMEOUT_BUDGET)
+		return DETECT_OVER_BUDGET;
+	if (m_detectLatencyTicks[frameId] == 0)
+		return DETECT_NOT_SEARCHED;
+	if (m_qualityResult[frameId] != QUALITY_OK)
+		return DETECT_LOW_QUALITY;
+	if (m_bRejected[frameId])
+		return DETECT_REJECTED;
+	return DETECT_NOT_FOUND;
+}
+
+const char* RGBDCamera::getDetectStatusName(const DETECT_STATUS status)
+{
+	static const char* statusNames[] = {"found", "not_found", "not_searched", "duplicate", "low_quality",
+		"rejected", "timeout", "over_budget"};
+	return statusNames[status];
+}
+
+bool RGBDCamera::exportDetectionStats(const std::string& filename) const
+{
+	FILE* file = fopen(filename.c_str(), "w");
+	if (file == NULL)
+	{
+		printf("Couldn't write detection stats to %s\n", filename.c_str());
+		return false;
+	}
+
+	double tickPerMs = cv::getTickFrequency() / 1000.0;
+	fprintf(file, "frameId,status,detectMs,latencyMs,level,tracked,retried,cached\n");
 	for (int frameId = 0; frameId < m_numFrame; frameId++)
 	{
-		// init flags
-		m_bPatternDetected[frameId] = true;
+		fprintf(file, "%d,%s,%.3f,%.3f,%d,%d,%d,%d\n", frameId, getDetectStatusName(getDetectStatus(frameId)),
+			m_detectTicks[frameId] / tickPerMs, m_detectLatencyTicks[frameId] / tickPerMs,
+			m_detectLevel[frameId], m_bTracked[frameId], m_bRetried[frameId], isCachedFrame(frameId) ? 1 : 0);
+	}
+	fclose(file);
+	return true;
+}
 
-		cv::cvtColor(*m_color[frameId], grayMat, CV_RGB2GRAY);
+int RGBDCamera::getNumDetectedFrame() const
+{
+	int numDetected = 0;
+	for (int frameId = 0; frameId < m_numFrame; frameId++)
+	{
+		if (m_bPatternDetected[frameId])
+			numDetected++;
+	}
+	return numDetected;
+}
 
-		corner2d_t frameCorners;
-		frameCorners.clear();
+void RGBDCamera::printDetectionStats() const
+{
+	std::vector<int64> latencyTicks;
+	int64 totalDetectTicks = 0;
+	int numDetected = 0;
+	int slowestFrameId = -1;
+	for (int frameId = 0; frameId < m_numFrame; frameId++)
+	{
+		if (m_detectLatencyTicks[frameId] == 0)
+			continue;
+
+		latencyTicks.push_back(m_detectLatencyTicks[frameId]);
+		totalDetectTicks += m_detectTicks[frameId];
+		if (m_bPatternDetected[frameId])
+			numDetected++;
+		if (slowestFrameId < 0 || m_detectTicks[frameId] > m_detectTicks[slowestFrameId])
+			slowestFrameId = frameId;
+	}
+	if (latencyTicks.empty())
+		return;
 
-		bool patternfound =
-			cv::findChessboardCorners(grayMat,
-			patternSize,
-			frameCorners,
-			cv::CALIB_CB_ADAPTIVE_THRESH +
-			cv::CALIB_CB_NORMALIZE_IMAGE);
+	double tickPerMs = cv::getTickFrequency() / 1000.0;
+	std::sort(latencyTicks.begin(), latencyTicks.end());
+	printf("Pattern found in %d of %d frames: detection %.1f ms avg, slowest %.1f ms (frame %d); "
+		"latency from queueing %.1f ms median, %.1f ms max\n",
+		numDetected, (int) latencyTicks.size(),
+		totalDetectTicks / tickPerMs / latencyTicks.size(),
+		m_detectTicks[slowestFrameId] / tickPerMs, slowestFrameId,
+		latencyTicks[latencyTicks.size() / 2] / tickPerMs,
+		latencyTicks.back() / tickPerMs);
 
-		if (!patternfound)
+	if (m_detector.isPyramid())
+	{
+		int numCoarse = 0;
+		for (int frameId = 0; frameId < m_numFrame; frameId++)
 		{
-			printf("Pattern not found in frame %d!\n", frameId);
-			m_bPatternDetected[frameId] = false;
+			if (m_bPatternDetected[frameId] && m_detectLevel[frameId] > 0)
+				numCoarse++;
 		}
-		else {
-			cv::cornerSubPix(grayMat, frameCorners, patternSize,
-				cv::Size(-1, -1), cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 300, 0.01));
+		printf("  pyramid level %d: %d boards found coarse, %d frames searched again at full resolution\n",
+			m_detector.getPyramidLevel(m_frameStore.getColorSize()), numCoarse, (int) latencyTicks.size() - numCoarse);
+	}
+
+	if (m_bTracking)
+	{
+		int numTracked = 0, numSearched = 0;
+		int64 trackedTicks = 0, searchedTicks = 0;
+		for (int frameId = 0; frameId < m_numFrame; frameId++)
+		{
+			if (m_detectLatencyTicks[frameId] == 0 || m_qualityResult[frameId] != QUALITY_OK)
+				continue;
+
+			if (m_bTracked[frameId])
+			{
+				numTracked++;
+				trackedTicks += m_detectTicks[frameId];
+			}
+			else {
+				numSearched++;
+				searchedTicks += m_detectTicks[frameId];
+			}
 		}
-		m_corners2d.push_back(frameCorners);
+		printf("  tracking: %d frames tracked (%.1f ms avg), %d searched (%.1f ms avg), keyframe every %d frames\n",
+			numTracked, numTracked > 0 ? trackedTicks / tickPerMs / numTracked : 0.0,
+			numSearched, numSearched > 0 ? searchedTicks / tickPerMs / numSearched : 0.0,
+			m_keyframeInterval);
+	}
+
+	if (m_bQualityCheck)
+		_printQualityStats();
+
+	if (m_frameDeadlineTicks > 0 || m_detectBudgetEndTick > 0)
+		_printTimeoutStats();
+
+	if (!m_searchRois.empty())
+		_printRoiStats();
+
+	if (m_bDepthRoi)
+		_printDepthRoiStats();
 
-#if DEBUG_SHOW_DETECTED_CORNERS
-		cv::Mat cornerShowMat = m_color[frameId]->clone();
-		cv::drawChessboardCorners(cornerShowMat,
-			patternSize,
-			cv::Mat(frameCorners),
-			1);
-		cv::namedWindow("ShowCorner", 1);
-		cv::imshow("ShowCorner", cornerShowMat);
-		cv::waitKey(0);
-#endif
+	if (m_detector.getPresenceCheck() != CheckerboardDetector::PRESENCE_OFF)
+		_printPresenceStats();
+
+	if (!m_bHashed.empty())
+		_printDedupStats(totalDetectTicks / tickPerMs / latencyTicks.size());
+
+	if (m_bDetectionBenchmark)
+		_printBenchmark();
+}
+
+void RGBDCamera::_printDedupStats(const double detectMs) const
+{
+	int numHashed = 0, numDuplicate = 0;
+	int64 hashTicks = 0;
+	for (int frameId = 0; frameId < m_numFrame; frameId++)
+	{
+		if (!m_bHashed[frameId])
+			continue;
+
+		numHashed++;
+		hashTicks += m_hashTicks[frameId];
+		if (m_bDuplicate[frameId])
+			numDuplicate++;
 	}
+	if (numHashed == 0)
+		return;
+
+	// a skipped frame would have cost the average detection time
+	double tickPerMs = cv::getTickFrequency() / 1000.0;
+	double savedMs = numDuplicate * detectMs - hashTicks / tickPerMs;
+	printf("  dedup: skipped %d of %d frames as near-duplicates, hashing %.2f ms/frame, saved about %.1f s of detection\n",
+		numDuplicate, numHashed, hashTicks / tickPerMs / numHashed, savedMs / 1000.0);
 }
 
-void RGBDCamera::_extractCorners3d()
+void RGBDCamera::_printQualityStats() const
 {
-	int w = m_intrinsic->w;
-	int h = m_intrinsic->h;
+	std::vector<float> sharpness;
+	int numBlurred = 0, numExposure = 0;
+	int64 qualityTicks = 0;
+	for (int frameId = 0; frameId < m_numFrame; frameId++)
+	{
+		if (m_frameQuality[frameId].sharpness < 0)
+			continue;
 
-	m_corners3d.resize(m_corners2d.size());
+		sharpness.push_back(m_frameQuality[frameId].sharpness);
+		qualityTicks += m_qualityTicks[frameId];
+		if (m_qualityResult[frameId] == QUALITY_BLURRED)
+			numBlurred++;
+		else if (m_qualityResult[frameId] == QUALITY_EXPOSURE)
+			numExposure++;
+	}
+	if (sharpness.empty())
+		return;
+
+	double tickPerMs = cv::getTickFrequency() / 1000.0;
+	std::sort(sharpness.begin(), sharpness.end());
+	printf("  quality: %.2f ms/frame, skipped %d blurred and %d badly exposed of %d frames; sharpness %.1f min, %.1f median\n",
+		qualityTicks / tickPerMs / sharpness.size(), numBlurred, numExposure, (int) sharpness.size(),
+		sharpness.front(), sharpness[sharpness.size() / 2]);
+}
+
+void RGBDCamera::_printTimeoutStats() const
+{
+	std::vector<int64> searchTicks;
+	int numTimedOut = 0, numOverBudget = 0, numRetried = 0, numRetryFound = 0;
 	for (int frameId = 0; frameId < m_numFrame; frameId++)
 	{
-		m_corners3d[frameId].resize(m_corners2d[frameId].size());
+		if (m_detectLatencyTicks[frameId] == 0)
+			continue;
+
+		if (m_timeoutResult[frameId] == TIMEOUT_FRAME)
+			numTimedOut++;
+		if (m_timeoutResult[frameId] == TIMEOUT_BUDGET)
+			numOverBudget++;
+		else
+			searchTicks.push_back(m_detectTicks[frameId]);
+		if (m_bRetried[frameId])
+		{
+			numRetried++;
+			if (m_bPatternDetected[frameId])
+				numRetryFound++;
+		}
+	}
+	if (searchTicks.empty() && numOverBudget == 0)
+		return;
 
-		// skip if no pattern detected
-		if (!m_bPatternDetected[frameId]) continue;
+	// the percentiles tell which deadline would have cut how many frames
+	double tickPerMs = cv::getTickFrequency() / 1000.0;
+	std::sort(searchTicks.begin(), searchTicks.end());
+	printf("  deadline %.0f ms: %d frames gave up, %d retried (%d found), %d past the budget\n",
+		m_frameDeadlineTicks / tickPerMs, numTimedOut, numRetried, numRetryFound, numOverBudget);
+	if (!searchTicks.empty())
+		printf("  deadline: detection %.1f ms p50, %.1f ms p90, %.1f ms p99, %.1f ms max\n",
+			searchTicks[searchTicks.size() / 2] / tickPerMs, searchTicks[searchTicks.size() * 9 / 10] / tickPerMs,
+			searchTicks[searchTicks.size() * 99 / 100] / tickPerMs, searchTicks.back() / tickPerMs);
+}
 
-		for (int cornerId = 0; cornerId < m_corners2d[frameId].size(); cornerId++)
+void RGBDCamera::_printRoiStats() const
+{
+	int numRoi = 0, numFound = 0, numFallbackFound = 0;
+	double roiFraction = 0;
+	cv::Size frameSize = m_frameStore.getColorSize();
+	for (int frameId = 0; frameId < m_numFrame; frameId++)
+	{
+		if (m_roiResult[frameId] == 0)
+			continue;
+
+		numRoi++;
+		if (frameSize.area() > 0)
+			roiFraction += (double) m_searchRois[frameId].area() / frameSize.area();
+		if (m_roiResult[frameId] == 1)
+			numFound++;
+		else if (m_bPatternDetected[frameId])
+			numFallbackFound++;
+	}
+	if (numRoi == 0)
+		return;
+
+	printf("  roi: %d frames searched in the predicted roi (%.0f%% of the frame avg), %d found there",
+		numRoi, 100.0 * roiFraction / numRoi, numFound);
+	if (m_bRoiFallback)
+		printf(", %d found by the whole frame search after a miss", numFallbackFound);
+	printf("\n");
+}
+
+void RGBDCamera::_printDepthRoiStats() const
+{
+	int numSegmented = 0, numWithRoi = 0, numFound = 0, numFallbackFound = 0;
+	double roiFraction = 0;
+	int64 segmentTicks = 0;
+	for (int frameId = 0; frameId < m_numFrame; frameId++)
+	{
+		if (m_depthRoiResult[frameId] == 0)
+			continue;
+
+		numSegmented++;
+		segmentTicks += m_depthRoiTicks[frameId];
+		if (m_depthRoiResult[frameId] != 3)
+		{
+			numWithRoi++;
+			roiFraction += m_depthRoiFraction[frameId];
+		}
+		if (m_depthRoiResult[frameId] == 1)
+			numFound++;
+		else if (m_bPatternDetected[frameId])
+			numFallbackFound++;
+	}
+	if (numSegmented == 0)
+		return;
+
+	double tickPerMs = cv::getTickFrequency() / 1000.0;
+	printf("  depth roi: %.2f ms/frame, %d of %d frames with a planar blob of the board's size (%.1f%% of the frame avg), %d found there",
+		segmentTicks / tickPerMs / numSegmented, numWithRoi, numSegmented,
+		numWithRoi > 0 ? 100.0 * roiFraction / numWithRoi : 0.0, numFound);
+	if (m_bRoiFallback)
+		printf(", %d found by the whole frame search after a miss", numFallbackFound);
+	printf("\n");
+}
+
+void RGBDCamera::_printPresenceStats() const
+{
+	int numChecked = 0, numRejected = 0, numAudited = 0, numMissed = 0;
+	int numBoardFreeSearch = 0;
+	int64 checkTicks = 0, auditTicks = 0, boardFreeSearchTicks = 0;
+	for (int frameId = 0; frameId < m_numFrame; frameId++)
+	{
+		if (m_detectLatencyTicks[frameId] == 0 || m_bTracked[frameId] || m_qualityResult[frameId] != QUALITY_OK)
+			continue;
+
+		numChecked++;
+		checkTicks += m_presenceTicks[frameId];
+		if (m_bRejected[frameId])
+			numRejected++;
+		if (m_auditResult[frameId] != 0)
 		{
-			// get 2d coord.
-			cv::Point2f uf(m_corners2d[frameId][cornerId].x,
-				m_corners2d[frameId][cornerId].y);
+			numAudited++;
+			auditTicks += m_auditTicks[frameId];
+			if (m_auditResult[frameId] == 2)
+				numMissed++;
+		}
+		// searches that passed the check and found nothing
+		if (!m_bRejected[frameId] && !m_bPatternDetected[frameId])
+		{
+			numBoardFreeSearch++;
+			boardFreeSearchTicks += m_detectTicks[frameId] - m_presenceTicks[frameId];
+		}
+	}
+	if (numChecked == 0)
+		return;
+
+	// the search time a rejected frame would have cost, measured on the audited frames if there are any
+	double tickPerMs = cv::getTickFrequency() / 1000.0;
+	double searchMs = 0;
+	if (numAudited > 0)
+		searchMs = auditTicks / tickPerMs / numAudited;
+	else if (numBoardFreeSearch > 0)
+		searchMs = boardFreeSearchTicks / tickPerMs / numBoardFreeSearch;
+	double savedMs = numRejected * searchMs - checkTicks / tickPerMs;
+
+	printf("  presence check (%s): %.2f ms/frame, rejected %d of %d searched frames, saved about %.1f s of search\n",
+		m_detector.getPresenceCheck() == CheckerboardDetector::PRESENCE_CONSERVATIVE ? "conservative" : "fast",
+		checkTicks / tickPerMs / numChecked, numRejected, numChecked, savedMs / 1000.0);
+	if (numAudited > 0)
+		printf("  presence check: %d of %d audited rejected frames had a board (false negative rate %.1f%%)\n",
+			numMissed, numAudited, 100.0 * numMissed / numAudited);
+}
+
+void RGBDCamera::_printBenchmark() const
+{
+	int64 totalBenchmarkTicks = 0, totalDetectTicks = 0, maxBenchmarkTicks = 0, maxDetectTicks = 0;
+	int numFrame = 0, numDetected = 0, numBenchmarkDetected = 0, numCompared = 0;
+	double sumSquaredError = 0;
+	float maxError = 0;
+	for (int frameId = 0; frameId < m_numFrame; frameId++)
+	{
+		if (m_detectLatencyTicks[frameId] == 0 || m_qualityResult[frameId] != QUALITY_OK)
+			continue;
+
+		numFrame++;
+		totalDetectTicks += m_detectTicks[frameId];
+		totalBenchmarkTicks += m_benchmarkTicks[frameId];
+		maxDetectTicks = std::max(maxDetectTicks, m_detectTicks[frameId]);
+		maxBenchmarkTicks = std::max(maxBenchmarkTicks, m_benchmarkTicks[frameId]);
+		if (m_bPatternDetected[frameId])
+			numDetected++;
+		if (m_bBenchmarkDetected[frameId])
+			numBenchmarkDetected++;
+		if (m_benchmarkError[frameId] >= 0)
+		{
+			numCompared++;
+			sumSquaredError += m_benchmarkError[frameId] * m_benchmarkError[frameId];
+			maxError = std::max(maxError, m_benchmarkError[frameId]);
+		}
+	}
+	if (numFrame == 0)
+		return;
+
+	const char* searchName = "configured search";
+	if (m_detector.getBackend() == CheckerboardDetector::BACKEND_SADDLE)
+		searchName = "saddle point";
+	else if (m_detector.isPyramid())
+		searchName = "pyramid";
+
+	double tickPerMs = cv::getTickFrequency() / 1000.0;
+	printf("  benchmark: full resolution %.1f ms/frame, %d found; %s %.1f ms/frame, %d found (%.2fx)\n",
+		totalBenchmarkTicks / tickPerMs / numFrame, numBenchmarkDetected,
+		searchName,
+		totalDetectTicks / tickPerMs / numFrame, numDetected,
+		totalDetectTicks > 0 ? (double) totalBenchmarkTicks / totalDetectTicks : 0.0);
+	// the slowest frame shows how much the time depends on the frame content
+	printf("  benchmark: slowest frame full resolution %.1f ms, %s %.1f ms\n",
+		maxBenchmarkTicks / tickPerMs, searchName, maxDetectTicks / tickPerMs);
+	if (numCompared > 0)
+		printf("  benchmark: corners differ by %.3f px RMS, %.3f px max over %d frames found by both\n",
+			std::sqrt(sumSquaredError / numCompared), maxError, numCompared);
+}
+
+void RGBDCamera::_extractCorners3d(const int frameId)
+{
+	AllocationStage allocationStage(STAGE_CORNERS3D);
+
+	int h = m_intrinsic->h;
+
+	// corners without a valid depth stay at z = 0, see getCorner3d()
+	m_corners3d[frameId].assign(m_corners2d[frameId].size(), cv::Point3f(0, 0, 0));
+
+	// skip if no pattern detected
+	if (!m_bPatternDetected[frameId]) return;
+
+	// only the rows around the corners are sampled
+	int rowStart = h, rowEnd = 0;
+	for (int cornerId = 0; cornerId < m_corners2d[frameId].size(); cornerId++)
+	{
+		int y = static_cast<int>(std::floor(m_corners2d[frameId][cornerId].y));
+		rowStart = std::min(rowStart, y);
+		rowEnd = std::max(rowEnd, y + DEPTH_SAMPLE_RANGE + 1);
+	}
+
+	cv::Mat depthMat = m_frameStore.getDepthRows(frameId, rowStart, rowEnd);
+	if (depthMat.data == NULL) return;
+
+	// the corners are in color pixels, the depth frame may be smaller
+	int w = depthMat.cols;
+	h = depthMat.rows;
+
+	for (int cornerId = 0; cornerId < m_corners2d[frameId].size(); cornerId++)
+	{
+		// get 2d coord.
+		cv::Point2f uf(m_corners2d[frameId][cornerId].x,
+			m_corners2d[frameId][cornerId].y);
 
-			// get depth
-			cv::Point2i ui, nnui;
-			ui.x = static_cast<int>(std::floor(uf.x));
-			ui.y = static_cast<int>(std::floor(uf.y));
+		// get depth
+		cv::Point2i ui, nnui;
+		ui.x = static_cast<int>(std::floor(uf.x));
+		ui.y = static_cast<int>(std::floor(uf.y));
 
-			float z = m_depth[frameId]->at<ushort>(ui.y, ui.x);
-			float z_avg = 0;
-			int count = 0;
+		if (ui.x < 0 || ui.x >= w || ui.y < 0 || ui.y >= h)
+			continue;
 
-			for (int det_x = 0; det_x <= DEPTH_SAMPLE_RANGE; det_x++)
-				for (int det_y = 0; det_y <= DEPTH_SAMPLE_RANGE; det_y++)
+		float z = depthMat.at<ushort>(ui.y, ui.x);
+		float z_avg = 0;
+		int count = 0;
+
+		for (int det_x = 0; det_x <= DEPTH_SAMPLE_RANGE; det_x++)
+			for (int det_y = 0; det_y <= DEPTH_SAMPLE_RANGE; det_y++)
+			{
+				nnui.x = ui.x + det_x;
+				nnui.y = ui.y + det_y;
+
+				// check if inside image
+				if (nnui.x >= 0 && nnui.x < w && nnui.y >= 0 && nnui.y < h
+					&& depthMat.at<ushort>(nnui.y, nnui.x) > 0
+					&& std::abs(z - depthMat.at<ushort>(nnui.y, nnui.x)) < DEPTH_SIMILARITY_THRESHOLD)
 				{
-					nnui.x = ui.x + det_x;
-					nnui.y = ui.y + det_y;
-
-					// check if inside image
-					if (nnui.x >= 0 && nnui.x < w && nnui.y >= 0 && nnui.y < h
-						&& m_depth[frameId]->at<ushort>(nnui.y, nnui.x) > 0
-						&& std::abs(z - m_depth[frameId]->at<ushort>(nnui.y, nnui.x)) < DEPTH_SIMILARITY_THRESHOLD)
-					{
-						z_avg += std::abs(z - m_depth[frameId]->at<ushort>(nnui.y, nnui.x));
-						count++;
-					}
+					z_avg += depthMat.at<ushort>(nnui.y, nnui.x);
+					count++;
 				}
+			}
 
-			// find averaged depth in mm
-			z_avg /= count;
+		// no valid depth around the corner (z = 0 matches nothing)
+		if (count == 0)
+			continue;
 
-			// mm to meters
-			z_avg /= 1000.0f;
+		// find averaged depth in mm
+		z_avg /= count;
 
-			// compute 3d coord.
-			m_corners3d[frameId][cornerId].z = z_avg; 
-			m_corners3d[frameId][cornerId].x = (uf.x - m_intrinsic->cx) / m_intrinsic->fx * z_avg;
-			m_corners3d[frameId][cornerId].y = (uf.y - m_intrinsic->cy) / m_intrinsic->fy * z_avg;	
-		}
+		// mm to meters
+		z_avg /= 1000.0f;
+
+		// compute 3d coord.
+		m_corners3d[frameId][cornerId].z = z_avg; 
+		m_corners3d[frameId][cornerId].x = (uf.x - m_intrinsic->cx) / m_intrinsic->fx * z_avg;
+		m_corners3d[frameId][cornerId].y = (uf.y - m_intrinsic->cy) / m_intrinsic->fy * z_avg;	
 	}
 }
 
 void RGBDCamera::_computeIntrinsic(const cv::Size patternSize, const float& patternLength)
 {
-	std::vector<cv::Mat> rvecs, tvecs;
-	std::vector<float> reprojErrs;
-	float totalAvgErr = 0;
+	AllocationStage allocationStage(STAGE_INTRINSIC);
 
 	// get image size
-	int imageWidth = m_color[0]->cols;
-	int imageHeight = m_color[0]->rows;
+	int imageWidth = _getColorSize().width;
+	int imageHeight = _getColorSize().height;
 
 	// get checkerboard corners
 	corner3d_t corner3dRef;
@@ -264,53 +1351,118 @@ void RGBDCamera::_computeIntrinsic(const cv::Size patternSize, const float& patt
 		}
 	}
 
+	m_numIntrinsicCandidate = (int) corners2dForIntrinsic.size();
+	m_fullIntrinsicSolveTicks = -1;
+	m_fullReprojectionError = -1.0f;
+	m_allViewReprojectionError = -1.0f;
+
+	// calibrateCamera throws without a view; the intrinsic is left empty, printIntrinsic() reports it
+	// and the empty camera matrix tells the callers there is none
+	if (corners2dForIntrinsic.empty())
+	{
+		m_numIntrinsicView = 0;
+		memset(m_intrinsic, 0, sizeof(CameraIntrinsicF));
+		m_intrinsic->w = imageWidth;
+		m_intrinsic->h = imageHeight;
+		m_cameraMatrix = cv::Mat();
+		m_distCoeffs = cv::Mat();
+		return;
+	}
+
+	// the LM cost of calibrateCamera grows with the views, most of which repeat each other
+	IntrinsicViewSelector selector;
+	selector.init(corners2dForIntrinsic, cv::Size(imageWidth, imageHeight), patternSize);
+	std::vector<int> viewIds = selector.select(m_maxIntrinsicView);
+	std::vector<int> allViewIds = selector.select(0);
+	m_intrinsicCoverage = selector.getCoverage(viewIds);
+	m_fullIntrinsicCoverage = selector.getCoverage(allViewIds);
+	m_numIntrinsicPoseBin = selector.getNumPoseBin(viewIds);
+	m_numFullIntrinsicPoseBin = selector.getNumPoseBin(allViewIds);
+
+	std::vector<corner2d_t> selectedViews(viewIds.size());
+	for (int i = 0; i < viewIds.size(); i++)
+		selectedViews[i] = corners2dForIntrinsic[viewIds[i]];
+	m_numIntrinsicView = (int) selectedViews.size();
+
 	// compute intrinsic params.
-	cv::Mat cameraMatrix = cv::Mat::eye(3, 3, CV_64F);
-	cv::Mat disCoeffs = cv::Mat::zeros(8, 1, CV_64F);
+	cv::Mat cameraMatrix, disCoeffs;
+	m_intrinsicSolveTicks = _solveIntrinsic(selectedViews, corner3dRef, cameraMatrix, disCoeffs, m_reprojectionError);
+
+	if (m_bCompareIntrinsicViews && selectedViews.size() < corners2dForIntrinsic.size())
+	{
+		cv::Mat fullCameraMatrix, fullDistCoeffs;
+		m_fullIntrinsicSolveTicks = _solveIntrinsic(corners2dForIntrinsic, corner3dRef, fullCameraMatrix, fullDistCoeffs,
+			m_fullReprojectionError);
+
+		// the selected intrinsic on every view, so both errors are over the same corners
+		corner2d_t corner2dPerFrame;
+		cv::Mat rvec, tvec;
+		int totalPoints = 0;
+		float totalError = 0;
+		for (int viewId = 0; viewId < corners2dForIntrinsic.size(); viewId++)
+		{
+			cv::solvePnP(corner3dRef, corners2dForIntrinsic[viewId], cameraMatrix, disCoeffs, rvec, tvec);
+			cv::projectPoints(corner3dRef, rvec, tvec, cameraMatrix, disCoeffs, corner2dPerFrame);
+			float err = (float) cv::norm(corners2dForIntrinsic[viewId], corner2dPerFrame, CV_L2);
+			totalError += err * err;
+			totalPoints += (int) corner3dRef.size();
+		}
+		m_allViewReprojectionError = std::sqrt(totalError / totalPoints);
+	}
+
+	// update result
+	m_intrinsic->w = imageWidth;
+	m_intrinsic->h = imageHeight;
+	m_intrinsic->fx = (float) cameraMatrix.at<double>(0, 0);
+	m_intrinsic->fy = (float) cameraMatrix.at<double>(1, 1);
+	m_intrinsic->cx = (float) cameraMatrix.at<double>(0, 2);
+	m_intrinsic->cy = (float) cameraMatrix.at<double>(1, 2);
+	for (int i = 0; i < 5; i++)
+		m_intrinsic->dist[i] = (float) disCoeffs.at<double>(i);
+
+	m_cameraMatrix = cameraMatrix;
+	m_distCoeffs = disCoeffs;
+}
+
+int64 RGBDCamera::_solveIntrinsic(const std::vector<corner2d_t>& views, const corner3d_t& corner3dRef,
+	cv::Mat& cameraMatrix, cv::Mat& distCoeffs, float& error) const
+{
+	int64 startTick = cv::getTickCount();
+
+	std::vector<cv::Mat> rvecs, tvecs;
+	cameraMatrix = cv::Mat::eye(3, 3, CV_64F);
+	distCoeffs = cv::Mat::zeros(8, 1, CV_64F);
 	std::vector<corner3d_t> objectPoints;
-	objectPoints.resize(corners2dForIntrinsic.size(), corner3dRef);
+	objectPoints.resize(views.size(), corner3dRef);
 	cv::calibrateCamera(objectPoints,
-		corners2dForIntrinsic,
-		cv::Size(imageWidth, imageHeight),
+		views,
+		_getColorSize(),
 		cameraMatrix,
-		disCoeffs,
+		distCoeffs,
 		rvecs, tvecs);
 
+	int64 solveTicks = cv::getTickCount() - startTick;
+
 	// evaluate calibration results
 	corner2d_t corner2dPerFrame;
 	int totalPoints = 0;
 	float totalError = 0, err;
-	for (int frameId = 0; frameId < corners2dForIntrinsic.size(); frameId++)
+	for (int frameId = 0; frameId < views.size(); frameId++)
 	{
 		cv::projectPoints(objectPoints[frameId],
 			rvecs[frameId],
 			tvecs[frameId],
 			cameraMatrix,
-			disCoeffs,
+			distCoeffs,
 			corner2dPerFrame);
 		
-		err = (float) cv::norm(corners2dForIntrinsic[frameId], corner2dPerFrame, CV_L2);
+		err = (float) cv::norm(views[frameId], corner2dPerFrame, CV_L2);
 
 		int n = (int)objectPoints[frameId].size();
 		totalError += err * err;
 		totalPoints += n;
 	}
-	totalAvgErr = std::sqrt(totalError / totalPoints);
+	error = std::sqrt(totalError / totalPoints);
 
-	printf("Reprojection Error is %f\n", totalAvgErr);
-
-	// update result
-	m_intrinsic->w = imageWidth;
-	m_intrinsic->h = imageHeight;
-	m_intrinsic->fx = (float) cameraMatrix.at<double>(0, 0);
-	m_intrinsic->fy = (float) cameraMatrix.at<double>(1, 1);
-	m_intrinsic->cx = (float) cameraMatrix.at<double>(0, 2);
-	m_intrinsic->cy = (float) cameraMatrix.at<double>(1, 2);
-	for (int i = 0; i < 5; i++)
-		m_intrinsic->dist[i] = (float) disCoeffs.at<double>(i);
-
-	m_intrinsic->printParam();
-
-	m_cameraMatrix = cameraMatrix;
-	m_distCoeffs = disCoeffs;
+	return solveTicks;
 }
\ No newline at end of file
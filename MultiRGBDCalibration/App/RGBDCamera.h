@@ -6,16 +6,27 @@
 #define __RGBD_CAMERA_H__
 
 #include "MultiRGBDCalibrationUtil.h"
+#include "CheckerboardDetector.h"
+#include "DebugImageWriter.h"
+#include "DepthBoardFinder.h"
+#include "DetectionCache.h"
+#include "FrameStore.h"
+#include "IntrinsicViewSelector.h"
+#include "..\Utility\FrameHash.h"
+#include "..\Utility\FrameQuality.h"
+#include "..\Utility\PooledMatAllocator.h"
+#include "..\Utility\WorkStealingPool.h"
 
 #define DEPTH_SAMPLE_RANGE 1 // pixels
 #define DEPTH_SIMILARITY_THRESHOLD 100 // mm
 
-// for debug
-#define DEBUG_SHOW_DETECTED_CORNERS 1
-
 class RGBDCamera
 {
 public:
+	// why a frame has or hasn't got corners
+	enum DETECT_STATUS{DETECT_FOUND, DETECT_NOT_FOUND, DETECT_NOT_SEARCHED, DETECT_DUPLICATE, DETECT_LOW_QUALITY,
+		DETECT_REJECTED, DETECT_TIMEOUT, DETECT_OVER_BUDGET};
+
 	RGBDCamera();
 	virtual ~RGBDCamera();
 
@@ -27,6 +38,183 @@ public:
 		const float& patternLength,
 		const CameraIntrinsicF* intrinsic = NULL);
 
+	// queue the frames on a shared decode pool; call initFromLoadedFrames() after decodePool.wait().
+	// The camera takes ownership of source.
+	void loadFrames(FrameSource* source, FrameDecodePool& decodePool);
+	void initFromLoadedFrames(const int& patternWidth,
+		const int& patternHeight,
+		const float& patternLength,
+		const CameraIntrinsicF* intrinsic = NULL);
+
+	// initFromLoadedFrames() in two steps, so the detection of all cameras shares one pool:
+	// queue one detection job per loaded frame, then call initFromDetectedCorners() after detectPool.wait()
+	void detectCorners(const int& patternWidth,
+		const int& patternHeight,
+		WorkStealingPool& detectPool);
+	void initFromDetectedCorners(const int& patternWidth,
+		const int& patternHeight,
+		const float& patternLength,
+		const CameraIntrinsicF* intrinsic = NULL);
+
+	// initFromDetectedCorners() in steps, so the intrinsics of all cameras are calibrated side by side:
+	// report the detection, calibrate (prints nothing, several cameras may calibrate concurrently),
+	// then print the intrinsic and extract the 3d corners in camera order
+	void reportDetection();
+	void calibrateIntrinsic(const int& patternWidth,
+		const int& patternHeight,
+		const float& patternLength,
+		const CameraIntrinsicF* intrinsic = NULL);
+	void printIntrinsic() const;
+	void initCorners3d();
+
+	// decode, detect and drop frames window by window, keeping at most budgetBytes of frames resident.
+	// with a known intrinsic the 3d corners are extracted while the window is resident; without one and
+	// with bDeferIntrinsic, calibrateIntrinsic() and initCorners3d() are left to the caller
+	void streamFrames(FrameSource* source,
+		const int& patternWidth,
+		const int& patternHeight,
+		const float& patternLength,
+		FrameDecodePool& decodePool,
+		WorkStealingPool& detectPool,
+		const size_t budgetBytes,
+		const int windowSize,
+		const CameraIntrinsicF* intrinsic = NULL,
+		const bool bDeferIntrinsic = false);
+
+	// hash the loaded frames on the pool for the near-duplicate check; mark the duplicates
+	// after detectPool.wait() and before detectCorners(), duplicate frames are neither detected nor solved
+	void hashFrames(WorkStealingPool& detectPool);
+	// skip every frame within maxDistance bits of the last kept frame; returns the num. of frames skipped
+	int markDuplicateFrames(const int maxDistance);
+	void setDuplicateFrame(const int frameId, const bool bDuplicate)
+	{
+		m_bDuplicate[frameId] = bDuplicate ? 1 : 0;
+	}
+	bool hasFrameHash(const int frameId) const
+	{
+		return frameId >= 0 && frameId < m_bHashed.size() && m_bHashed[frameId] != 0;
+	}
+	const FrameHash& getFrameHash(const int frameId) const
+	{
+		return m_frameHash[frameId];
+	}
+	bool isDuplicateFrame(const int frameId) const
+	{
+		return frameId >= 0 && frameId < m_bDuplicate.size() && m_bDuplicate[frameId] != 0;
+	}
+
+	// keep depth frames RVL-compressed, set before loading
+	void setDepthCompression(const bool bCompress, const int bandHeight = 16)
+	{
+		m_frameStore.setDepthCompression(bCompress, bandHeight);
+	}
+	// decode the color frames straight to grayscale, set before loading
+	void setGrayDecode(const bool bGray)
+	{
+		m_frameStore.setGrayDecode(bGray);
+	}
+	// search the board on a downscaled pyramid level first, see CheckerboardDetector
+	void setPyramidDetection(const bool bPyramid, const int expectedBoardPixels, const int minSquarePixels)
+	{
+		m_detector.setPyramid(bPyramid, expectedBoardPixels, minSquarePixels);
+	}
+	void setDetectionBackend(const CheckerboardDetector::DETECT_BACKEND backend)
+	{
+		m_detector.setBackend(backend);
+	}
+	// track the corners from frame to frame, searching only on every keyframeInterval-th frame
+	// and where the tracking fails
+	void setTracking(const bool bTracking, const int keyframeInterval)
+	{
+		m_bTracking = bTracking;
+		m_keyframeInterval = std::max(keyframeInterval, 1);
+	}
+	// reject frames without a board before the search; every auditInterval-th rejected frame
+	// (by frameId, 0 = none) is searched anyway to measure the false negatives
+	void setPresenceCheck(const CheckerboardDetector::PRESENCE_CHECK presenceCheck, const int auditInterval)
+	{
+		m_detector.setPresenceCheck(presenceCheck);
+		m_presenceAuditInterval = auditInterval;
+	}
+	// score every frame before the detection and skip it when the Laplacian variance is below minSharpness
+	// or more than maxClippedFraction of the pixels are crushed or saturated
+	void setQualityCheck(const bool bQualityCheck, const float minSharpness, const float maxClippedFraction)
+	{
+		m_bQualityCheck = bQualityCheck;
+		m_minSharpness = minSharpness;
+		m_maxClippedFraction = maxClippedFraction;
+	}
+	// skip near-duplicates while streaming (-1 = off), the windows are hashed as they are decoded
+	void setStreamDedup(const int maxDistance)
+	{
+		m_streamDedupMaxDistance = maxDistance;
+	}
+	// search only inside rois[frameId] where it isn't empty, e.g. around the board predicted from the other
+	// cameras. Kept until set again
+	void setSearchRois(const std::vector<cv::Rect>& rois)
+	{
+		m_searchRois = rois;
+	}
+	// search only around the planar blobs of the board's size in the depth frame, downscaled by downscale;
+	// fx of the color camera gives the size of the board in pixels
+	void setDepthRoi(const bool bDepthRoi, const float patternLength, const float fx, const int downscale)
+	{
+		m_bDepthRoi = bDepthRoi && fx > 0;
+		m_depthRoiPatternLength = patternLength;
+		m_depthRoiFx = fx;
+		m_depthRoiDownscale = downscale;
+	}
+	// search the whole frame when the board isn't in the predicted or depth rois
+	void setRoiFallback(const bool bFallback)
+	{
+		m_bRoiFallback = bFallback;
+	}
+	// cut the search of a frame short after frameDeadlineMs (0 = none); with bRetry the frames cut short
+	// are searched at full resolution without the deadline at the end of the detection, or at the end
+	// of each streamed window
+	void setDetectionDeadline(const double frameDeadlineMs, const bool bRetry)
+	{
+		m_frameDeadlineTicks = (int64) (frameDeadlineMs * cv::getTickFrequency() / 1000.0);
+		m_bRetryTimedOut = bRetry;
+	}
+	// frames starting after budgetEndTick (a cv::getTickCount() value, 0 = none) aren't searched,
+	// shared by the cameras of a run
+	void setDetectionBudget(const int64 budgetEndTick)
+	{
+		m_detectBudgetEndTick = budgetEndTick;
+	}
+	// queue the frames cut short at the deadline again for a full resolution search without it;
+	// call before initFromDetectedCorners()
+	// and wait for the pool. Returns the num. of frames queued
+	int retryTimedOutFrames(WorkStealingPool& detectPool);
+	// reuse the detections of earlier runs stored in filename (empty = off) and store the new ones there;
+	// settingsKey covers patternSize and every detection parameter. Set before loading
+	void setDetectionCache(const std::string& filename, const unsigned long long settingsKey, const cv::Size patternSize)
+	{
+		m_detectionCacheFilename = filename;
+		m_detectionSettingsKey = settingsKey;
+		m_detectionCachePatternSize = patternSize;
+	}
+	// hand the result of every searched frame to writer (NULL = off), labelled name; the writer
+	// only references the frames, so finish it before clear() or another load
+	void setDebugWriter(DebugImageWriter* writer, const std::string& name)
+	{
+		m_debugWriter = writer;
+		m_debugName = name;
+	}
+	// also run the full resolution search on every frame and compare time and corners
+	void setDetectionBenchmark(const bool bBenchmark)
+	{
+		m_bDetectionBenchmark = bBenchmark;
+	}
+	// calibrate the intrinsic from at most maxView of the detected views (0 = all), see IntrinsicViewSelector;
+	// with bCompare, also solve all views and report time and error of both
+	void setIntrinsicViewSelection(const int maxView, const bool bCompare)
+	{
+		m_maxIntrinsicView = maxView;
+		m_bCompareIntrinsicViews = bCompare;
+	}
+
 	const int getNumFrame() const
 	{
 		return m_numFrame;
@@ -36,6 +224,26 @@ public:
 		return m_numFrame;
 	}
 
+	const CameraIntrinsicF* getIntrinsic() const
+	{
+		return m_intrinsic;
+	}
+	// the intrinsic was calibrated from the frames, rather than copied from an initial one
+	bool isIntrinsicCalibrated() const
+	{
+		return m_numIntrinsicView >= 0;
+	}
+	// num. of views and seconds of the last calibration
+	int getNumIntrinsicView() const
+	{
+		return m_numIntrinsicView;
+	}
+	double getIntrinsicSeconds() const
+	{
+		return m_intrinsicTicks / cv::getTickFrequency();
+	}
+
+	// empty if the intrinsic was computed from no view
 	const cv::Mat getCameraMatrix() const
 	{
 		return m_cameraMatrix;
@@ -57,6 +265,7 @@ public:
 	{
 		return m_corners2d[frameId];
 	}
+	// in meters, z = 0 where the corner has no valid depth
 	corner3d_t& getCorner3d(int frameId)
 	{
 		return m_corners3d[frameId];
@@ -67,25 +276,179 @@ public:
 	{
 		if (frameId < 0 || frameId >= m_numFrame)
 			return false;
-		return m_bPatternDetected[frameId];
+		return m_bPatternDetected[frameId] != 0;
 	}
+	int getNumDetectedFrame() const;
+
+	// scores of the last detection, sharpness is -1 if the frame was not scored
+	const FrameQuality& getFrameQuality(int frameId) const
+	{
+		return m_frameQuality[frameId];
+	}
+	bool isLowQualityFrame(int frameId) const
+	{
+		return frameId >= 0 && frameId < m_qualityResult.size() && m_qualityResult[frameId] != QUALITY_OK;
+	}
+	// the result of the frame was taken from the detection cache, it was neither decoded nor searched
+	bool isCachedFrame(int frameId) const
+	{
+		return frameId >= 0 && frameId < m_cacheResult.size() && m_cacheResult[frameId] != CACHE_MISS;
+	}
+
+	DETECT_STATUS getDetectStatus(int frameId) const;
+	static const char* getDetectStatusName(const DETECT_STATUS status);
+	// one line per frame with its status and timings, for tuning the deadline and budget
+	bool exportDetectionStats(const std::string& filename) const;
+
+	// time from queueing the detection of the frame to its result
+	double getDetectionLatencyMs(int frameId) const
+	{
+		if (frameId < 0 || frameId >= m_detectLatencyTicks.size())
+			return 0.0;
+		return m_detectLatencyTicks[frameId] * 1000.0 / cv::getTickFrequency();
+	}
+
+	void printDetectionStats() const;
 
 private:
-	void _loadColor(const std::vector<std::string> colorFilenames);
-	void _loadDepth(const std::vector<std::string> depthFilenames);
-	void _extractCorners2dCheckerboard(const cv::Size patternSize);
-	void _extractCorners3d();
+	enum QUALITY_RESULT{QUALITY_OK, QUALITY_BLURRED, QUALITY_EXPOSURE};
+	enum TIMEOUT_RESULT{TIMEOUT_NONE, TIMEOUT_FRAME, TIMEOUT_BUDGET};
+	enum CACHE_RESULT{CACHE_MISS, CACHE_NO_BOARD, CACHE_BOARD};
+
+	void _initCorners();
+	// look the frames of the source up in the detection cache, before the store takes the source over
+	void _readDetectionCache(FrameSource* source);
+	// queue the frames on the decode pool, of a cached frame only the depth of its board
+	void _requestFrames(const int frameStart, const int frameEnd, FrameDecodePool& decodePool);
+	void _applyDetectionCache(const int frameStart, const int frameEnd);
+	void _writeDetectionCache();
+	// of the decoded frames, or of the cached ones when none was decoded
+	cv::Size _getColorSize() const;
+	void _initIntrinsic(const cv::Size patternSize, const float& patternLength, const CameraIntrinsicF* intrinsic);
+	void _initFrameHashes();
+	void _queueFrameHashes(const int frameStart, const int frameEnd, WorkStealingPool& detectPool);
+	// run on the detection workers
+	void _computeFrameHash(const int frameId, const cv::Mat frameMat);
+	// the representative carries over from the previous call, so windows are compared across their borders
+	int _markDuplicates(const int frameStart, const int frameEnd, const int maxDistance);
+	// frames between the two are all duplicates, so the board can be tracked across them
+	bool _isDuplicateGap(const int prevFrameId, const int frameId) const;
+	void _printDedupStats(const double detectMs) const;
+	void _queueCorners2d(const int frameStart, const int frameEnd, const cv::Size patternSize, WorkStealingPool& detectPool);
+	int _queueRetries(const int frameStart, const int frameEnd, WorkStealingPool& detectPool);
+	// run on the detection workers
+	// detect the frames in order, tracking from one to the next when enabled
+	void _extractCorners2dCheckerboard(const std::vector<int> frameIds,
+		const std::vector<cv::Mat> colorMats, const std::vector<cv::Mat> grayMats, const std::vector<cv::Mat> depthMats,
+		const int64 queueTick, const bool bRetry);
+	bool _detectInDepthRois(const int frameId, const cv::Mat& grayMat, const cv::Mat& depthMat,
+		corner2d_t& corners, int* level, const int64 deadlineTick, bool* bCutShort);
+	// add the time of this attempt, returns the end tick
+	int64 _finishDetection(const int frameId, const int64 startTick, const int64 queueTick);
+	void _benchmarkCorners2d(const int frameId, const cv::Mat& grayMat);
+	void _pushDebugImage(const int frameId, const cv::Mat& colorMat);
+	void _printBenchmark() const;
+	void _printPresenceStats() const;
+	void _printQualityStats() const;
+	void _printTimeoutStats() const;
+	void _printRoiStats() const;
+	void _printDepthRoiStats() const;
+	// report the results of the frames [frameStart, frameEnd) in order after the detection pool has finished
+	void _checkCorners2d(const int frameStart, const int frameEnd);
+	void _extractCorners3d(const int frameId);
 	void _computeIntrinsic(const cv::Size patternSize, const float& patternLength);
+	// calibrateCamera on views, error is the RMS reprojection error over their corners; returns the ticks taken
+	int64 _solveIntrinsic(const std::vector<corner2d_t>& views, const corner3d_t& corner3dRef,
+		cv::Mat& cameraMatrix, cv::Mat& distCoeffs, float& error) const;
 
 	int m_numFrame;
 	CameraIntrinsicF* m_intrinsic;
+	// -1 if the intrinsic was given
+	int m_numIntrinsicView;
+	float m_reprojectionError;
+	int64 m_intrinsicTicks;
+	// view selection of the last calibration; the full set is only solved with m_bCompareIntrinsicViews,
+	// its error and ticks are -1 otherwise
+	int m_maxIntrinsicView;
+	bool m_bCompareIntrinsicViews;
+	int m_numIntrinsicCandidate;
+	float m_intrinsicCoverage;
+	float m_fullIntrinsicCoverage;
+	int m_numIntrinsicPoseBin;
+	int m_numFullIntrinsicPoseBin;
+	int64 m_intrinsicSolveTicks;
+	int64 m_fullIntrinsicSolveTicks;
+	float m_fullReprojectionError;
+	// of the selected views' intrinsic over all views, the poses of the others solved with solvePnP
+	float m_allViewReprojectionError;
 	cv::Mat m_cameraMatrix;
 	cv::Mat m_distCoeffs;
 
-	// frameId
-	std::vector<bool> m_bPatternDetected;
-	std::vector<cv::Mat*> m_color;
-	std::vector<cv::Mat*> m_depth;
+	// frameId; not vector<bool>, the frames are detected concurrently
+	std::vector<unsigned char> m_bPatternDetected;
+	std::vector<int64> m_detectTicks;
+	std::vector<int64> m_detectLatencyTicks;
+	std::vector<int> m_detectLevel;
+	std::vector<unsigned char> m_bTracked;
+	// presence check; audit result 0 = not audited, 1 = no board, 2 = board missed by the check
+	std::vector<unsigned char> m_bRejected;
+	std::vector<int64> m_presenceTicks;
+	std::vector<unsigned char> m_auditResult;
+	std::vector<int64> m_auditTicks;
+	// frame quality, result is a QUALITY_RESULT
+	std::vector<FrameQuality> m_frameQuality;
+	std::vector<unsigned char> m_qualityResult;
+	std::vector<int64> m_qualityTicks;
+	// roi search, result 0 = whole frame searched, 1 = board found in the roi, 2 = missed in the roi
+	std::vector<cv::Rect> m_searchRois;
+	std::vector<unsigned char> m_roiResult;
+	// depth rois, result 0 = not used, 1 = board found in a roi, 2 = missed in the rois, 3 = no roi
+	std::vector<unsigned char> m_depthRoiResult;
+	std::vector<float> m_depthRoiFraction;
+	std::vector<int64> m_depthRoiTicks;
+	// deadline and budget, result is a TIMEOUT_RESULT
+	std::vector<unsigned char> m_timeoutResult;
+	std::vector<unsigned char> m_bRetried;
+	// full resolution search of the benchmark, error is the corner RMS difference or -1
+	std::vector<int64> m_benchmarkTicks;
+	std::vector<unsigned char> m_bBenchmarkDetected;
+	std::vector<float> m_benchmarkError;
+	// near-duplicate frames, not reset by _initCorners() since they are marked before the detection
+	std::vector<FrameHash> m_frameHash;
+	std::vector<unsigned char> m_bHashed;
+	std::vector<unsigned char> m_bDuplicate;
+	std::vector<int64> m_hashTicks;
+	// detection cache, set when the frames are loaded; the key of the color plane is valid if keyed,
+	// result is a CACHE_RESULT
+	DetectionCache m_detectionCache;
+	std::vector<unsigned long long> m_frameKey;
+	std::vector<unsigned char> m_bKeyed;
+	std::vector<unsigned char> m_cacheResult;
+	std::string m_detectionCacheFilename;
+	cv::Size m_detectionCachePatternSize;
+	FrameStore m_frameStore;
+	CheckerboardDetector m_detector;
+	DepthBoardFinder m_depthFinder;
+	DebugImageWriter* m_debugWriter;
+	std::string m_debugName;
+	bool m_bDetectionBenchmark;
+	bool m_bQualityCheck;
+	float m_minSharpness;
+	float m_maxClippedFraction;
+	bool m_bTracking;
+	int m_keyframeInterval;
+	int m_presenceAuditInterval;
+	int64 m_frameDeadlineTicks;
+	int64 m_detectBudgetEndTick;
+	bool m_bRetryTimedOut;
+	bool m_bRoiFallback;
+	bool m_bDepthRoi;
+	float m_depthRoiPatternLength;
+	float m_depthRoiFx;
+	int m_depthRoiDownscale;
+	int m_dedupRepFrameId;
+	int m_streamDedupMaxDistance;
+	unsigned long long m_detectionSettingsKey;
 
 	// frameId, cornerId
 	std::vector<corner2d_t> m_corners2d;
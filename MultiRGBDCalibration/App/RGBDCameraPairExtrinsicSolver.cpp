@@ -21,6 +21,8 @@ void RGBDCameraPairExtrinsicSolver::solveGlobalVisual(const int& patternWidth,
 		return;
 	}
 
+	AllocationStage allocationStage(STAGE_EXTRINSIC);
+
 	// get checkerboard corners
 	corner3d_t corner3dRef;
 	for (int j = 0; j < patternHeight; j++)
@@ -35,6 +37,7 @@ void RGBDCameraPairExtrinsicSolver::solveGlobalVisual(const int& patternWidth,
 		m_corners3d[camId].clear();
 	}
 
+	corner3d_t tempCorner3dwrtCamCoord;
 	for (int frameId = 0; frameId < numFrame; frameId++)
 	{
 		// skip if checkerboard is not detected
@@ -44,7 +47,6 @@ void RGBDCameraPairExtrinsicSolver::solveGlobalVisual(const int& patternWidth,
 
 		for (int camId = 0; camId < numCamera; camId++)
 		{
-			corner3d_t tempCorner3dwrtCamCoord;
 			// find points in 3d
 			_extractCorners3d(corner3dRef,
 				rgbdCamera[camId]->getCorner2d(frameId),
@@ -70,6 +72,8 @@ void RGBDCameraPairExtrinsicSolver::solveGlobalGeom(const int& patternWidth,
 		return;
 	}
 
+	AllocationStage allocationStage(STAGE_EXTRINSIC);
+
 	int numFrame = (int)rgbdCamera[0]->getNumFrame();
 	int numCamera = (int)rgbdCamera.size();
 
@@ -82,14 +86,18 @@ void RGBDCameraPairExtrinsicSolver::solveGlobalGeom(const int& patternWidth,
 	{
 		// skip if checkerboard is not detected
 		if (!rgbdCamera[0]->isPatternDetected(frameId)
-			|| !rgbdCamera[0]->isPatternDetected(frameId))
+			|| !rgbdCamera[1]->isPatternDetected(frameId))
 			continue;
 
-		for (int camId = 0; camId < numCamera; camId++)
+		// update from depth, only the corners with a depth in both cameras so the pairs stay aligned
+		const corner3d_t& corners0 = rgbdCamera[0]->getCorner3d(frameId);
+		const corner3d_t& corners1 = rgbdCamera[1]->getCorner3d(frameId);
+		for (int cornerId = 0; cornerId < corners0.size() && cornerId < corners1.size(); cornerId++)
 		{
-			// update from depth
-			for (int cornerId = 0; cornerId < rgbdCamera[camId]->getCorner3d(frameId).size(); cornerId++)
-				m_corners3d[camId].push_back(rgbdCamera[camId]->getCorner3d(frameId)[cornerId]);
+			if (corners0[cornerId].z <= 0 || corners1[cornerId].z <= 0)
+				continue;
+			m_corners3d[0].push_back(corners0[cornerId]);
+			m_corners3d[1].push_back(corners1[cornerId]);
 		}
 	}
 }
@@ -100,11 +108,10 @@ void RGBDCameraPairExtrinsicSolver::_extractCorners3d(const corner3d_t& objectPo
 	const cv::Mat& distCoeffs,
 	corner3d_t& corner3dwrtCamCoord)
 {
-	cv::Mat rmat(3, 3, CV_64F);
-	cv::Mat rvec(3, 1, CV_64F);
-	cv::Mat tvec(3, 1, CV_64F);
-	cv::Mat p_ref(3, 1, CV_64F);
-	cv::Mat p_cam(3, 1, CV_64F);
+	// fixed size matrices live on the stack, the corners are transformed without temporaries
+	cv::Matx33d rmat;
+	cv::Vec3d rvec;
+	cv::Vec3d tvec;
 
 	cv::solvePnP(objectPoints,
 		cameraPoints,
@@ -120,15 +127,13 @@ void RGBDCameraPairExtrinsicSolver::_extractCorners3d(const corner3d_t& objectPo
 	corner3dwrtCamCoord.resize(numPoint);
 	for (int cornerId = 0; cornerId < numPoint; cornerId++)
 	{
-		p_ref.at<double>(0) = objectPoints[cornerId].x;
-		p_ref.at<double>(1) = objectPoints[cornerId].y;
-		p_ref.at<double>(2) = objectPoints[cornerId].z;
+		cv::Vec3d p_ref(objectPoints[cornerId].x, objectPoints[cornerId].y, objectPoints[cornerId].z);
 
-		p_cam = rmat * p_ref + tvec;
+		cv::Vec3d p_cam = rmat * p_ref + tvec;
 
-		corner3dwrtCamCoord[cornerId].x = (float) p_cam.at<double>(0);
-		corner3dwrtCamCoord[cornerId].y = (float) p_cam.at<double>(0);
-		corner3dwrtCamCoord[cornerId].z = (float) p_cam.at<double>(0);
+		corner3dwrtCamCoord[cornerId].x = (float) p_cam[0];
+		corner3dwrtCamCoord[cornerId].y = (float) p_cam[1];
+		corner3dwrtCamCoord[cornerId].z = (float) p_cam[2];
 	}
 }
 
@@ -0,0 +1,367 @@
+#include "RGBDSequenceFile.h"
+#include "..\Utility\ContentKey.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#define ftell64 _ftelli64
+#define fseek64 _fseeki64
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ftell64 ftello
+#define fseek64 fseeko
+#endif
+
+#define RGBD_SEQUENCE_MAGIC "RGBDSEQ"
+#define RGBD_SEQUENCE_VERSION 1
+#define RGBD_SEQUENCE_ALIGNMENT 64 // bytes
+
+RGBDSequenceFile::RGBDSequenceFile() : m_mapped(NULL), m_mappedSize(0),
+	m_fileHandle(NULL), m_mappingHandle(NULL), m_header(NULL), m_index(NULL), m_bGrayColor(false), m_writeFile(NULL)
+{
+
+}
+
+RGBDSequenceFile::~RGBDSequenceFile()
+{
+	close();
+	if (m_writeFile != NULL)
+	{
+		fclose(m_writeFile);
+		m_writeFile = NULL;
+	}
+}
+
+bool RGBDSequenceFile::open(const std::string& fn)
+{
+	close();
+
+	if (!_map(fn))
+	{
+		printf("Couldn't map %s\n", fn.c_str());
+		return false;
+	}
+	m_filename = fn;
+
+	m_header = (const FileHeader*) m_mapped;
+	if (m_mappedSize < sizeof(FileHeader)
+		|| memcmp(m_header->magic, RGBD_SEQUENCE_MAGIC, sizeof(RGBD_SEQUENCE_MAGIC)) != 0
+		|| m_header->version != RGBD_SEQUENCE_VERSION
+		|| m_header->indexOffset + m_header->numFrame * sizeof(IndexEntry) > m_mappedSize)
+	{
+		printf("Invalid rgbd sequence %s\n", fn.c_str());
+		close();
+		return false;
+	}
+	m_index = (const IndexEntry*) (m_mapped + m_header->indexOffset);
+
+	return true;
+}
+
+void RGBDSequenceFile::close()
+{
+	_unmap();
+	m_header = NULL;
+	m_index = NULL;
+}
+
+bool RGBDSequenceFile::read(const int frameId, const FRAME_PLANE plane, cv::Mat& dst, size_t& numByteRead)
+{
+	numByteRead = 0;
+	const PlaneHeader* planeHeader = _getPlaneHeader(frameId, plane);
+	if (planeHeader == NULL || planeHeader->dataSize == 0)
+	{
+		dst.release();
+		return false;
+	}
+
+	uchar* data = (uchar*) (m_mapped + planeHeader->dataOffset);
+	numByteRead = (size_t) planeHeader->dataSize;
+
+	if (planeHeader->codec == RAW)
+	{
+		// view into the mapped file, no copy
+		dst = cv::Mat(planeHeader->height, planeHeader->width, planeHeader->type, data);
+	}
+	else if (planeHeader->codec == PNG)
+	{
+		cv::Mat buffer(1, (int) planeHeader->dataSize, CV_8U, data);
+		int flags = CV_LOAD_IMAGE_ANYDEPTH;
+		if (plane == COLOR)
+			flags = m_bGrayColor ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+		cv::Mat decoded = cv::imdecode(buffer, flags, &dst);
+		if (decoded.data == NULL)
+			dst.release();
+	}
+	else {
+		dst.release();
+	}
+
+	return dst.data != NULL;
+}
+
+bool RGBDSequenceFile::isZeroCopy() const
+{
+	const PlaneHeader* planeHeader = _getPlaneHeader(0, COLOR);
+	return planeHeader != NULL && planeHeader->codec == RAW;
+}
+
+bool RGBDSequenceFile::setGrayColor(const bool bGray)
+{
+	const PlaneHeader* planeHeader = _getPlaneHeader(0, COLOR);
+	m_bGrayColor = bGray && planeHeader != NULL && planeHeader->codec == PNG;
+	return m_bGrayColor == bGray;
+}
+
+bool RGBDSequenceFile::getContentKey(const int frameId, const FRAME_PLANE plane, unsigned long long& key) const
+{
+	// the frames are told apart by their names in the sequence
+	if (frameId < 0 || frameId >= getNumFrame() || !getFileContentKey(m_filename, key))
+		return false;
+	key = hashContentString(getName(frameId, plane), key);
+	return true;
+}
+
+std::string RGBDSequenceFile::getName(const int frameId, const FRAME_PLANE plane) const
+{
+	char buffer[32];
+	sprintf_s(buffer, 32, "#%d (%s)", frameId, (plane == COLOR) ? "color" : "depth");
+	return m_filename + std::string(buffer);
+}
+
+const RGBDSequenceFile::PlaneHeader* RGBDSequenceFile::_getPlaneHeader(const int frameId, const FRAME_PLANE plane) const
+{
+	if (frameId < 0 || frameId >= getNumFrame())
+		return NULL;
+
+	uint64_t planeOffset = (plane == COLOR) ? m_index[frameId].colorOffset : m_index[frameId].depthOffset;
+	if (planeOffset + sizeof(PlaneHeader) > m_mappedSize)
+		return NULL;
+
+	const PlaneHeader* planeHeader = (const PlaneHeader*) (m_mapped + planeOffset);
+	if (planeHeader->dataOffset + planeHeader->dataSize > m_mappedSize)
+		return NULL;
+
+	return planeHeader;
+}
+
+bool RGBDSequenceFile::create(const std::string& fn)
+{
+	close();
+
+	m_writeFile = fopen(fn.c_str(), "wb");
+	if (m_writeFile == NULL)
+	{
+		printf("Couldn't create %s\n", fn.c_str());
+		return false;
+	}
+	m_filename = fn;
+	m_writeIndex.clear();
+
+	// the header is written again with the index offset in finish()
+	FileHeader header;
+	memset(&header, 0, sizeof(FileHeader));
+	return fwrite(&header, sizeof(FileHeader), 1, m_writeFile) == 1;
+}
+
+bool RGBDSequenceFile::writeFrame(const cv::Mat& color, const cv::Mat& depth, const PLANE_CODEC codec, const uint64_t timestamp)
+{
+	if (m_writeFile == NULL)
+		return false;
+
+	IndexEntry entry;
+	if (!_writePlane(color, codec, timestamp, entry.colorOffset)
+		|| !_writePlane(depth, codec, timestamp, entry.depthOffset))
+		return false;
+
+	m_writeIndex.push_back(entry);
+	return true;
+}
+
+bool RGBDSequenceFile::finish()
+{
+	if (m_writeFile == NULL)
+		return false;
+
+	FileHeader header;
+	memset(&header, 0, sizeof(FileHeader));
+	memcpy(header.magic, RGBD_SEQUENCE_MAGIC, sizeof(RGBD_SEQUENCE_MAGIC));
+	header.version = RGBD_SEQUENCE_VERSION;
+	header.numFrame = (uint32_t) m_writeIndex.size();
+	header.indexOffset = (uint64_t) ftell64(m_writeFile);
+
+	bool bSuccess = true;
+	if (!m_writeIndex.empty())
+		bSuccess = fwrite(&m_writeIndex[0], sizeof(IndexEntry), m_writeIndex.size(), m_writeFile) == m_writeIndex.size();
+
+	fseek64(m_writeFile, 0, SEEK_SET);
+	bSuccess = bSuccess && fwrite(&header, sizeof(FileHeader), 1, m_writeFile) == 1;
+	bSuccess = (fclose(m_writeFile) == 0) && bSuccess;
+
+	m_writeFile = NULL;
+	m_writeIndex.clear();
+
+	return bSuccess;
+}
+
+bool RGBDSequenceFile::convert(FrameSource& source, const std::string& fn, const PLANE_CODEC codec)
+{
+	RGBDSequenceFile sequence;
+	if (!sequence.create(fn))
+		return false;
+
+	int numFrame = source.getNumFrame();
+	for (int frameId = 0; frameId < numFrame; frameId++)
+	{
+		cv::Mat color, depth;
+		size_t numByteRead;
+		if (!source.read(frameId, COLOR, color, numByteRead))
+			printf("Loading color frame %d failed! - %s\n", frameId, source.getName(frameId, COLOR).c_str());
+		if (!source.read(frameId, DEPTH, depth, numByteRead))
+			printf("Loading depth frame %d failed! - %s\n", frameId, source.getName(frameId, DEPTH).c_str());
+
+		// failed frames are kept as empty planes so frame ids stay aligned
+		if (!sequence.writeFrame(color, depth, codec, frameId))
+		{
+			printf("Writing frame %d to %s failed!\n", frameId, fn.c_str());
+			sequence.finish();
+			return false;
+		}
+	}
+
+	return sequence.finish();
+}
+
+bool RGBDSequenceFile::_writePlane(const cv::Mat& plane, const PLANE_CODEC codec, const uint64_t timestamp, uint64_t& planeOffset)
+{
+	static const uchar padding[RGBD_SEQUENCE_ALIGNMENT] = { 0 };
+
+	PlaneHeader planeHeader;
+	memset(&planeHeader, 0, sizeof(PlaneHeader));
+	planeHeader.width = plane.cols;
+	planeHeader.height = plane.rows;
+	planeHeader.type = plane.type();
+	planeHeader.codec = codec;
+	planeHeader.timestamp = timestamp;
+
+	std::vector<uchar> encoded;
+	cv::Mat continuous;
+	const uchar* data = NULL;
+	if (plane.data != NULL)
+	{
+		if (codec == PNG)
+		{
+			// fastest png level, the container is about avoiding per-file overhead
+			std::vector<int> params;
+			params.push_back(cv::IMWRITE_PNG_COMPRESSION);
+			params.push_back(1);
+			if (!cv::imencode(".png", plane, encoded, params))
+				return false;
+			data = encoded.empty() ? NULL : &encoded[0];
+			planeHeader.dataSize = encoded.size();
+		}
+		else {
+			continuous = plane.isContinuous() ? plane : plane.clone();
+			data = continuous.data;
+			planeHeader.dataSize = continuous.total() * continuous.elemSize();
+		}
+	}
+
+	planeOffset = (uint64_t) ftell64(m_writeFile);
+	uint64_t dataOffset = planeOffset + sizeof(PlaneHeader);
+	size_t numPad = (size_t) ((RGBD_SEQUENCE_ALIGNMENT - dataOffset % RGBD_SEQUENCE_ALIGNMENT) % RGBD_SEQUENCE_ALIGNMENT);
+	planeHeader.dataOffset = dataOffset + numPad;
+
+	if (fwrite(&planeHeader, sizeof(PlaneHeader), 1, m_writeFile) != 1)
+		return false;
+	if (numPad > 0 && fwrite(padding, 1, numPad, m_writeFile) != numPad)
+		return false;
+	if (planeHeader.dataSize > 0 && fwrite(data, 1, (size_t) planeHeader.dataSize, m_writeFile) != planeHeader.dataSize)
+		return false;
+
+	return true;
+}
+
+bool RGBDSequenceFile::_map(const std::string& fn)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(fn.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (mapped == NULL)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_fileHandle = file;
+	m_mappingHandle = mapping;
+	m_mapped = (const uchar*) mapped;
+	m_mappedSize = (size_t) fileSize.QuadPart;
+#else
+	int fd = ::open(fn.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* mapped = mmap(NULL, (size_t) fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED)
+		return false;
+
+	// frames are mostly consumed front to back
+	madvise(mapped, (size_t) fileStat.st_size, MADV_SEQUENTIAL);
+
+	m_mapped = (const uchar*) mapped;
+	m_mappedSize = (size_t) fileStat.st_size;
+#endif
+	return true;
+}
+
+void RGBDSequenceFile::_unmap()
+{
+	if (m_mapped == NULL)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_mapped);
+	CloseHandle((HANDLE) m_mappingHandle);
+	CloseHandle((HANDLE) m_fileHandle);
+#else
+	munmap((void*) m_mapped, m_mappedSize);
+#endif
+
+	m_mapped = NULL;
+	m_mappedSize = 0;
+	m_fileHandle = NULL;
+	m_mappingHandle = NULL;
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+/* This class reads and writes the packed rgbd sequence container (.rgbdseq).
+*
+* One container holds all color and depth frames of one camera:
+*  [FileHeader]
+*  [PlaneHeader][pad][color plane of frame 0]
+*  [PlaneHeader][pad][depth plane of frame 0]
+*  ...
+*  [IndexEntry x numFrame]
+*
+* Plane data starts on a 64-byte boundary. Raw planes are returned as cv::Mat
+* views into the memory-mapped file without copying, so they are read-only and
+* only valid while the container is open.
+*/
+
+#pragma once
+
+#ifndef __RGBD_SEQUENCE_FILE_H__
+#define __RGBD_SEQUENCE_FILE_H__
+
+#include <cstdint>
+#include <cstdio>
+
+#include "FrameSource.h"
+
+class RGBDSequenceFile : public FrameSource
+{
+public:
+	enum PLANE_CODEC{RAW, PNG};
+
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t numFrame;
+		uint64_t indexOffset;
+	};
+
+	struct IndexEntry
+	{
+		// offsets of the plane headers
+		uint64_t colorOffset;
+		uint64_t depthOffset;
+	};
+
+	struct PlaneHeader
+	{
+		uint32_t width;
+		uint32_t height;
+		int32_t type;
+		uint32_t codec;
+		uint64_t timestamp;
+		uint64_t dataOffset;
+		uint64_t dataSize;
+	};
+
+	RGBDSequenceFile();
+	virtual ~RGBDSequenceFile();
+
+	/* ----- Reading ----- */
+	bool open(const std::string& fn);
+	void close();
+
+	virtual int getNumFrame() const
+	{
+		return m_header != NULL ? (int) m_header->numFrame : 0;
+	}
+
+	virtual bool read(const int frameId, const FRAME_PLANE plane, cv::Mat& dst, size_t& numByteRead);
+	virtual bool getContentKey(const int frameId, const FRAME_PLANE plane, unsigned long long& key) const;
+	virtual std::string getName(const int frameId, const FRAME_PLANE plane) const;
+	virtual bool isZeroCopy() const;
+	// only png planes can be decoded to grayscale, raw planes are views
+	virtual bool setGrayColor(const bool bGray);
+
+	/* ----- Writing ----- */
+	bool create(const std::string& fn);
+	bool writeFrame(const cv::Mat& color, const cv::Mat& depth, const PLANE_CODEC codec, const uint64_t timestamp = 0);
+	bool finish();
+
+	// pack all frames of source into fn
+	static bool convert(FrameSource& source, const std::string& fn, const PLANE_CODEC codec);
+
+private:
+	const PlaneHeader* _getPlaneHeader(const int frameId, const FRAME_PLANE plane) const;
+	bool _map(const std::string& fn);
+	void _unmap();
+	bool _writePlane(const cv::Mat& plane, const PLANE_CODEC codec, const uint64_t timestamp, uint64_t& planeOffset);
+
+	std::string m_filename;
+
+	/* ----- Memory-mapped container ----- */
+	const uchar* m_mapped;
+	size_t m_mappedSize;
+	void* m_fileHandle;
+	void* m_mappingHandle;
+	const FileHeader* m_header;
+	const IndexEntry* m_index;
+	bool m_bGrayColor;
+
+	/* ----- Writer state ----- */
+	FILE* m_writeFile;
+	std::vector<IndexEntry> m_writeIndex;
+};
+
+#endif//__RGBD_SEQUENCE_FILE_H__
\ No newline at end of file
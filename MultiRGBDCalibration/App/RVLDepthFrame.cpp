@@ -0,0 +1,86 @@
+#include "RVLDepthFrame.h"
+#include "..\Utility\RVLCodec.h"
+
+RVLDepthFrame::RVLDepthFrame() : m_rows(0), m_cols(0), m_bandHeight(0), m_compressTicks(0)
+{
+
+}
+
+RVLDepthFrame::~RVLDepthFrame()
+{
+
+}
+
+void RVLDepthFrame::clear()
+{
+	m_words.clear();
+	m_bandOffsets.clear();
+	m_rows = 0;
+	m_cols = 0;
+	m_bandHeight = 0;
+	m_compressTicks = 0;
+}
+
+void RVLDepthFrame::compress(const cv::Mat& depth, const int bandHeight)
+{
+	int64 startTick = cv::getTickCount();
+
+	clear();
+	if (depth.data == NULL || depth.type() != CV_16UC1)
+		return;
+
+	m_rows = depth.rows;
+	m_cols = depth.cols;
+	m_bandHeight = bandHeight > 0 ? bandHeight : m_rows;
+
+	cv::Mat continuous = depth.isContinuous() ? depth : depth.clone();
+
+	int numBand = (m_rows + m_bandHeight - 1) / m_bandHeight;
+	std::vector<int> words(rvlMaxCompressedWords(m_rows * m_cols) + numBand * rvlMaxCompressedWords(0));
+
+	int numWord = 0;
+	m_bandOffsets.resize(numBand + 1);
+	for (int bandId = 0; bandId < numBand; bandId++)
+	{
+		int rowStart = bandId * m_bandHeight;
+		int rowEnd = std::min(rowStart + m_bandHeight, m_rows);
+
+		m_bandOffsets[bandId] = numWord;
+		numWord += rvlCompress(continuous.ptr<ushort>(rowStart), (rowEnd - rowStart) * m_cols, &words[numWord]);
+	}
+	m_bandOffsets[numBand] = numWord;
+
+	// keep only the used words
+	m_words.assign(words.begin(), words.begin() + numWord);
+
+	m_compressTicks = cv::getTickCount() - startTick;
+}
+
+void RVLDepthFrame::decompress(cv::Mat& depth) const
+{
+	decompressRows(0, m_rows, depth);
+}
+
+void RVLDepthFrame::decompressRows(const int rowStart, const int rowEnd, cv::Mat& depth) const
+{
+	if (empty())
+	{
+		depth.release();
+		return;
+	}
+
+	int numBand = (int) m_bandOffsets.size() - 1;
+	int bandStart = std::max(rowStart, 0) / m_bandHeight;
+	int bandEnd = std::min((std::min(rowEnd, m_rows) + m_bandHeight - 1) / m_bandHeight, numBand);
+
+	depth.create(m_rows, m_cols, CV_16UC1);
+	if (bandStart > 0 || bandEnd < numBand)
+		depth.setTo(cv::Scalar(0));
+
+	for (int bandId = bandStart; bandId < bandEnd; bandId++)
+	{
+		int bandRowStart = bandId * m_bandHeight;
+		int bandRowEnd = std::min(bandRowStart + m_bandHeight, m_rows);
+		rvlDecompress(&m_words[m_bandOffsets[bandId]], depth.ptr<ushort>(bandRowStart), (bandRowEnd - bandRowStart) * m_cols);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+/* This class keeps one 16-bit depth frame compressed with RVL.
+*
+* The frame is coded in bands of rows that decode independently, so a stage
+* that only samples a few rows does not have to decompress the whole frame.
+*/
+
+#pragma once
+
+#ifndef __RVL_DEPTH_FRAME_H__
+#define __RVL_DEPTH_FRAME_H__
+
+#include "MultiRGBDCalibrationUtil.h"
+
+class RVLDepthFrame
+{
+public:
+	RVLDepthFrame();
+	virtual ~RVLDepthFrame();
+
+	void clear();
+	void compress(const cv::Mat& depth, const int bandHeight = 16);
+
+	// decompress the whole frame into depth
+	void decompress(cv::Mat& depth) const;
+	// decompress the bands covering the rows [rowStart, rowEnd), the other rows of depth are zero
+	void decompressRows(const int rowStart, const int rowEnd, cv::Mat& depth) const;
+
+	bool empty() const
+	{
+		return m_bandOffsets.empty();
+	}
+	int getRows() const
+	{
+		return m_rows;
+	}
+	size_t getRawBytes() const
+	{
+		return (size_t) m_rows * m_cols * sizeof(ushort);
+	}
+	size_t getCompressedBytes() const
+	{
+		return m_words.size() * sizeof(int) + m_bandOffsets.size() * sizeof(int);
+	}
+	int64 getCompressTicks() const
+	{
+		return m_compressTicks;
+	}
+
+private:
+	int m_rows, m_cols;
+	int m_bandHeight;
+	int64 m_compressTicks;
+
+	std::vector<int> m_words;
+	// word offset of each band, followed by the total num. of words
+	std::vector<int> m_bandOffsets;
+};
+
+#endif//__RVL_DEPTH_FRAME_H__
\ No newline at end of file
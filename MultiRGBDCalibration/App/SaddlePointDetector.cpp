@@ -0,0 +1,424 @@
+#include "SaddlePointDetector.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SADDLE_SSE2 1
+#endif
+
+// Ixy^2 - Ixx * Iyy of row at columns 1..cols-2, positive at saddles
+static void scoreRow(const float* above, const float* row, const float* below, const int cols, float* response)
+{
+	int x = 1;
+
+#if SADDLE_SSE2
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 quarter = _mm_set1_ps(0.25f);
+	for (; x + 5 <= cols; x += 4)
+	{
+		__m128 twiceCenter = _mm_mul_ps(_mm_loadu_ps(row + x), two);
+		__m128 ixx = _mm_sub_ps(_mm_add_ps(_mm_loadu_ps(row + x - 1), _mm_loadu_ps(row + x + 1)), twiceCenter);
+		__m128 iyy = _mm_sub_ps(_mm_add_ps(_mm_loadu_ps(above + x), _mm_loadu_ps(below + x)), twiceCenter);
+		__m128 ixy = _mm_mul_ps(_mm_sub_ps(
+			_mm_add_ps(_mm_loadu_ps(below + x + 1), _mm_loadu_ps(above + x - 1)),
+			_mm_add_ps(_mm_loadu_ps(below + x - 1), _mm_loadu_ps(above + x + 1))), quarter);
+		_mm_storeu_ps(response + x, _mm_sub_ps(_mm_mul_ps(ixy, ixy), _mm_mul_ps(ixx, iyy)));
+	}
+#endif
+
+	for (; x < cols - 1; x++)
+	{
+		float twiceCenter = row[x] * 2.0f;
+		float ixx = (row[x - 1] + row[x + 1]) - twiceCenter;
+		float iyy = (above[x] + below[x]) - twiceCenter;
+		float ixy = ((below[x + 1] + above[x - 1]) - (below[x - 1] + above[x + 1])) * 0.25f;
+		response[x] = ixy * ixy - ixx * iyy;
+	}
+}
+
+// two dark and two bright sectors around the point, the opposite sectors alike
+static bool isXJunction(const cv::Mat& blurred, const int x, const int y, const cv::Point* ring)
+{
+	float samples[SADDLE_RING_SAMPLES];
+	float minValue = FLT_MAX, maxValue = -FLT_MAX;
+	for (int k = 0; k < SADDLE_RING_SAMPLES; k++)
+	{
+		samples[k] = blurred.at<float>(y + ring[k].y, x + ring[k].x);
+		minValue = std::min(minValue, samples[k]);
+		maxValue = std::max(maxValue, samples[k]);
+	}
+	if (maxValue - minValue < SADDLE_MIN_RING_CONTRAST)
+		return false;
+
+	float middle = 0.5f * (minValue + maxValue);
+	int numSwitch = 0, numOpposite = 0;
+	for (int k = 0; k < SADDLE_RING_SAMPLES; k++)
+	{
+		bool bBright = samples[k] > middle;
+		if (bBright != (samples[(k + 1) % SADDLE_RING_SAMPLES] > middle))
+			numSwitch++;
+		if (bBright == (samples[(k + SADDLE_RING_SAMPLES / 2) % SADDLE_RING_SAMPLES] > middle))
+			numOpposite++;
+	}
+	return numSwitch == 4 && numOpposite >= SADDLE_RING_SAMPLES - 4;
+}
+
+static float sampleClamped(const cv::Mat& blurred, const cv::Point2f point)
+{
+	int x = std::min(std::max((int) std::floor(point.x + 0.5f), 0), blurred.cols - 1);
+	int y = std::min(std::max((int) std::floor(point.y + 0.5f), 0), blurred.rows - 1);
+	return blurred.at<float>(y, x);
+}
+
+// the saddle response of a band of rows
+class SaddleResponseBody : public cv::ParallelLoopBody
+{
+public:
+	SaddleResponseBody(const cv::Mat& blurred, cv::Mat& response) : m_blurred(blurred), m_response(response)
+	{
+
+	}
+
+	virtual void operator()(const cv::Range& range) const
+	{
+		for (int band = range.start; band < range.end; band++)
+		{
+			int rowStart = std::max(band * SADDLE_BAND_ROWS, 1);
+			int rowEnd = std::min((band + 1) * SADDLE_BAND_ROWS, m_blurred.rows - 1);
+			for (int y = rowStart; y < rowEnd; y++)
+				scoreRow(m_blurred.ptr<float>(y - 1), m_blurred.ptr<float>(y), m_blurred.ptr<float>(y + 1),
+					m_blurred.cols, m_response.ptr<float>(y));
+		}
+	}
+
+private:
+	const cv::Mat& m_blurred;
+	cv::Mat& m_response;
+};
+
+// the local maxima of a band of rows that look like X-junctions
+class SaddleCandidateBody : public cv::ParallelLoopBody
+{
+public:
+	SaddleCandidateBody(const cv::Mat& blurred, const cv::Mat& response, const float threshold,
+		std::vector<std::vector<SaddlePointDetector::Saddle> >& bandSaddles)
+		: m_blurred(blurred), m_response(response), m_threshold(threshold), m_bandSaddles(bandSaddles)
+	{
+		for (int k = 0; k < SADDLE_RING_SAMPLES; k++)
+		{
+			double angle = 2 * CV_PI * k / SADDLE_RING_SAMPLES;
+			m_ring[k] = cv::Point((int) std::floor(SADDLE_RING_RADIUS * std::cos(angle) + 0.5),
+				(int) std::floor(SADDLE_RING_RADIUS * std::sin(angle) + 0.5));
+		}
+	}
+
+	virtual void operator()(const cv::Range& range) const
+	{
+		// the ring has to stay inside the frame
+		const int border = std::max(SADDLE_RING_RADIUS, SADDLE_NMS_RADIUS) + 1;
+		for (int band = range.start; band < range.end; band++)
+		{
+			std::vector<SaddlePointDetector::Saddle>& saddles = m_bandSaddles[band];
+			int rowStart = std::max(band * SADDLE_BAND_ROWS, border);
+			int rowEnd = std::min((band + 1) * SADDLE_BAND_ROWS, m_response.rows - border);
+			for (int y = rowStart; y < rowEnd; y++)
+			{
+				const float* row = m_response.ptr<float>(y);
+				for (int x = border; x < m_response.cols - border; x++)
+				{
+					float value = row[x];
+					if (value < m_threshold || !_isLocalMaximum(x, y, value) || !isXJunction(m_blurred, x, y, m_ring))
+						continue;
+
+					// vertex of the parabolas through the horizontal and vertical neighbours
+					float left = row[x - 1], right = row[x + 1];
+					float up = m_response.at<float>(y - 1, x), down = m_response.at<float>(y + 1, x);
+					float curvatureX = left - 2 * value + right, curvatureY = up - 2 * value + down;
+					float dx = curvatureX < 0 ? 0.5f * (left - right) / curvatureX : 0.0f;
+					float dy = curvatureY < 0 ? 0.5f * (up - down) / curvatureY : 0.0f;
+
+					SaddlePointDetector::Saddle saddle;
+					saddle.position = cv::Point2f(x + std::min(std::max(dx, -0.5f), 0.5f), y + std::min(std::max(dy, -0.5f), 0.5f));
+					saddle.response = value;
+					saddles.push_back(saddle);
+				}
+			}
+		}
+	}
+
+private:
+	// ties go to the first pixel in raster order
+	bool _isLocalMaximum(const int x, const int y, const float value) const
+	{
+		for (int dy = -SADDLE_NMS_RADIUS; dy <= SADDLE_NMS_RADIUS; dy++)
+		{
+			const float* row = m_response.ptr<float>(y + dy);
+			for (int dx = -SADDLE_NMS_RADIUS; dx <= SADDLE_NMS_RADIUS; dx++)
+			{
+				float neighbour = row[x + dx];
+				if (neighbour > value || (neighbour == value && (dy < 0 || (dy == 0 && dx < 0))))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	const cv::Mat& m_blurred;
+	const cv::Mat& m_response;
+	float m_threshold;
+	std::vector<std::vector<SaddlePointDetector::Saddle> >& m_bandSaddles;
+	cv::Point m_ring[SADDLE_RING_SAMPLES];
+};
+
+SaddlePointDetector::SaddlePointDetector() : m_maxSide(0)
+{
+
+}
+
+SaddlePointDetector::~SaddlePointDetector()
+{
+
+}
+
+void SaddlePointDetector::init(const cv::Size patternSize)
+{
+	m_patternSize = patternSize;
+	m_maxSide = std::max(patternSize.width, patternSize.height);
+}
+
+bool SaddlePointDetector::detect(const cv::Mat& grayMat, corner2d_t& corners) const
+{
+	corners.clear();
+
+	const int minSide = 2 * (SADDLE_RING_RADIUS + 1) + 1;
+	if (grayMat.data == NULL || grayMat.type() != CV_8UC1 || grayMat.cols < minSide || grayMat.rows < minSide
+		|| m_patternSize.width < 2 || m_patternSize.height < 2)
+		return false;
+
+	cv::Mat floatMat, blurred;
+	grayMat.convertTo(floatMat, CV_32F);
+	cv::GaussianBlur(floatMat, blurred, cv::Size(0, 0), SADDLE_BLUR_SIGMA);
+
+	std::vector<Saddle> saddles;
+	_findSaddles(blurred, saddles);
+	if (saddles.size() < m_patternSize.area())
+		return false;
+
+	std::vector<int> grid;
+	cv::Rect extent;
+	int numSeed = std::min((int) saddles.size(), SADDLE_MAX_SEEDS);
+	for (int seedId = 0; seedId < numSeed; seedId++)
+	{
+		if (_growGrid(saddles, seedId, grid, extent))
+		{
+			_orderCorners(saddles, grid, extent, blurred, corners);
+			return true;
+		}
+	}
+	return false;
+}
+
+void SaddlePointDetector::_findSaddles(const cv::Mat& blurred, std::vector<Saddle>& saddles) const
+{
+	saddles.clear();
+
+	int numBand = (blurred.rows + SADDLE_BAND_ROWS - 1) / SADDLE_BAND_ROWS;
+	cv::Mat response = cv::Mat::zeros(blurred.size(), CV_32F);
+	cv::parallel_for_(cv::Range(0, numBand), SaddleResponseBody(blurred, response));
+
+	double maxResponse = 0;
+	cv::minMaxLoc(response, NULL, &maxResponse);
+	float threshold = std::max((float) maxResponse * SADDLE_RESPONSE_RATIO, SADDLE_MIN_RESPONSE);
+
+	// each band collects its own saddles, merged in band order so the result doesn't depend on the threads
+	std::vector<std::vector<Saddle> > bandSaddles(numBand);
+	cv::parallel_for_(cv::Range(0, numBand), SaddleCandidateBody(blurred, response, threshold, bandSaddles));
+	for (int band = 0; band < numBand; band++)
+		saddles.insert(saddles.end(), bandSaddles[band].begin(), bandSaddles[band].end());
+
+	std::stable_sort(saddles.begin(), saddles.end());
+	size_t maxCandidate = SADDLE_MAX_CANDIDATE_FACTOR * m_patternSize.area();
+	if (saddles.size() > maxCandidate)
+		saddles.resize(maxCandidate);
+}
+
+bool SaddlePointDetector::_growGrid(const std::vector<Saddle>& saddles, const int seedId, std::vector<int>& grid,
+	cv::Rect& extent) const
+{
+	int side = 2 * m_maxSide + 1;
+	grid.assign(side * side, -1);
+	const cv::Point2f seed = saddles[seedId].position;
+
+	// the nearest saddle gives the column step, the nearest roughly perpendicular one of a similar distance the row step
+	int colId = -1, rowId = -1;
+	float colLength = FLT_MAX, rowLength = FLT_MAX;
+	for (int id = 0; id < saddles.size(); id++)
+	{
+		cv::Point2f diff = saddles[id].position - seed;
+		float length = std::sqrt(diff.x * diff.x + diff.y * diff.y);
+		if (id != seedId && length < colLength)
+		{
+			colLength = length;
+			colId = id;
+		}
+	}
+	if (colId < 0 || colLength <= 0)
+		return false;
+	cv::Point2f colStep = saddles[colId].position - seed;
+
+	for (int id = 0; id < saddles.size(); id++)
+	{
+		if (id == seedId || id == colId)
+			continue;
+
+		cv::Point2f diff = saddles[id].position - seed;
+		float length = std::sqrt(diff.x * diff.x + diff.y * diff.y);
+		if (length < 0.5f * colLength || length > 2.0f * colLength || length >= rowLength)
+			continue;
+		if (std::abs(diff.dot(colStep)) > 0.5f * length * colLength)
+			continue;
+
+		rowLength = length;
+		rowId = id;
+	}
+	if (rowId < 0)
+		return false;
+	cv::Point2f rowStep = saddles[rowId].position - seed;
+
+	std::vector<bool> bUsed(saddles.size(), false);
+	std::vector<cv::Point> queue;
+	grid[_cellIndex(cv::Point(0, 0))] = seedId;
+	grid[_cellIndex(cv::Point(1, 0))] = colId;
+	grid[_cellIndex(cv::Point(0, 1))] = rowId;
+	bUsed[seedId] = bUsed[colId] = bUsed[rowId] = true;
+	queue.push_back(cv::Point(0, 0));
+	queue.push_back(cv::Point(1, 0));
+	queue.push_back(cv::Point(0, 1));
+	extent = cv::Rect(0, 0, 2, 2);
+
+	const cv::Point directions[4] = {cv::Point(1, 0), cv::Point(-1, 0), cv::Point(0, 1), cv::Point(0, -1)};
+	for (int head = 0; head < queue.size(); head++)
+	{
+		cv::Point cell = queue[head];
+		cv::Point2f position = saddles[grid[_cellIndex(cell)]].position;
+		for (int dirId = 0; dirId < 4; dirId++)
+		{
+			cv::Point dir = directions[dirId];
+			cv::Point next = cell + dir;
+			if (std::abs(next.x) > m_maxSide || std::abs(next.y) > m_maxSide || grid[_cellIndex(next)] >= 0)
+				continue;
+
+			// the grid can't grow beyond the pattern in either orientation
+			int left = std::min(extent.x, next.x), top = std::min(extent.y, next.y);
+			int width = std::max(extent.x + extent.width, next.x + 1) - left;
+			int height = std::max(extent.y + extent.height, next.y + 1) - top;
+			if (!(width <= m_patternSize.width && height <= m_patternSize.height)
+				&& !(width <= m_patternSize.height && height <= m_patternSize.width))
+				continue;
+
+			// the step into the cell along dir, else the one of a neighbouring line, else the seed's
+			cv::Point2f step = dir.x * colStep + dir.y * rowStep;
+			cv::Point prev = cell - dir;
+			cv::Point side(std::abs(dir.y), std::abs(dir.x));
+			if (std::abs(prev.x) <= m_maxSide && std::abs(prev.y) <= m_maxSide && grid[_cellIndex(prev)] >= 0)
+				step = position - saddles[grid[_cellIndex(prev)]].position;
+			else
+			{
+				for (int sign = -1; sign <= 1; sign += 2)
+				{
+					cv::Point from = cell + sign * side, to = next + sign * side;
+					if (std::abs(from.x) <= m_maxSide && std::abs(from.y) <= m_maxSide
+						&& std::abs(to.x) <= m_maxSide && std::abs(to.y) <= m_maxSide
+						&& grid[_cellIndex(from)] >= 0 && grid[_cellIndex(to)] >= 0)
+					{
+						step = saddles[grid[_cellIndex(to)]].position - saddles[grid[_cellIndex(from)]].position;
+						break;
+					}
+				}
+			}
+
+			cv::Point2f predicted = position + step;
+			float tolerance = SADDLE_GRID_TOLERANCE * std::sqrt(step.x * step.x + step.y * step.y);
+			int nearestId = -1;
+			float nearestDistance = tolerance * tolerance;
+			for (int id = 0; id < saddles.size(); id++)
+			{
+				if (bUsed[id])
+					continue;
+
+				cv::Point2f diff = saddles[id].position - predicted;
+				float distance = diff.x * diff.x + diff.y * diff.y;
+				if (distance <= nearestDistance)
+				{
+					nearestDistance = distance;
+					nearestId = id;
+				}
+			}
+			if (nearestId < 0)
+				continue;
+
+			grid[_cellIndex(next)] = nearestId;
+			bUsed[nearestId] = true;
+			queue.push_back(next);
+			extent = cv::Rect(left, top, width, height);
+		}
+	}
+
+	// every cell inside the extent is filled once the count matches
+	return queue.size() == m_patternSize.area()
+		&& ((extent.width == m_patternSize.width && extent.height == m_patternSize.height)
+		|| (extent.width == m_patternSize.height && extent.height == m_patternSize.width));
+}
+
+void SaddlePointDetector::_orderCorners(const std::vector<Saddle>& saddles, const std::vector<int>& grid,
+	const cv::Rect extent, const cv::Mat& blurred, corner2d_t& corners) const
+{
+	int patternWidth = m_patternSize.width, patternHeight = m_patternSize.height;
+
+	// the rows run along the grid side of patternWidth corners
+	bool bTranspose = extent.width != patternWidth;
+	if (patternWidth == patternHeight)
+	{
+		cv::Point2f along = saddles[grid[_cellIndex(cv::Point(extent.x + extent.width - 1, extent.y))]].position
+			- saddles[grid[_cellIndex(extent.tl())]].position;
+		bTranspose = std::abs(along.x) < std::abs(along.y);
+	}
+
+	corners.resize(m_patternSize.area());
+	for (int row = 0; row < patternHeight; row++)
+	{
+		for (int col = 0; col < patternWidth; col++)
+		{
+			cv::Point cell = bTranspose ? cv::Point(extent.x + row, extent.y + col) : cv::Point(extent.x + col, extent.y + row);
+			corners[row * patternWidth + col] = saddles[grid[_cellIndex(cell)]].position;
+		}
+	}
+
+	// rows left to right, then stacked downwards: the column direction turns clockwise from the row direction
+	if (corners[patternWidth - 1].x < corners[0].x)
+	{
+		for (int row = 0; row < patternHeight; row++)
+			std::reverse(corners.begin() + row * patternWidth, corners.begin() + (row + 1) * patternWidth);
+	}
+	cv::Point2f rowDir = corners[patternWidth - 1] - corners[0];
+	cv::Point2f colDir = corners[(patternHeight - 1) * patternWidth] - corners[0];
+	if (rowDir.x * colDir.y - rowDir.y * colDir.x < 0)
+	{
+		for (int row = 0; row < patternHeight / 2; row++)
+			std::swap_ranges(corners.begin() + row * patternWidth, corners.begin() + (row + 1) * patternWidth,
+				corners.begin() + (patternHeight - 1 - row) * patternWidth);
+	}
+
+	// the darker outer square goes first when the two differ
+	if ((patternWidth + patternHeight) % 2 == 1)
+	{
+		int last = m_patternSize.area() - 1;
+		cv::Point2f firstSquare = corners[0] - 0.5f * (corners[1] - corners[0]) - 0.5f * (corners[patternWidth] - corners[0]);
+		cv::Point2f lastSquare = corners[last] + 0.5f * (corners[last] - corners[last - 1])
+			+ 0.5f * (corners[last] - corners[last - patternWidth]);
+		if (sampleClamped(blurred, firstSquare) > sampleClamped(blurred, lastSquare))
+			std::reverse(corners.begin(), corners.end());
+	}
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+/* This class finds the inner corners of the checkerboard as saddle points of the image.
+*
+* Every inner corner is an X-junction where two dark and two bright squares
+* meet, a saddle of the smoothed intensity: the determinant of its Hessian is
+* strongly negative. The response Ixy^2 - Ixx * Iyy is computed four pixels at
+* a time with SSE2 and its local maxima are kept where a ring around them
+* alternates dark, bright, dark, bright. The frame is cut into bands of rows
+* that are scored in parallel. The strongest candidates are then linked into
+* a grid from a seed by predicting each next corner from its neighbours, and
+* the grid is accepted when it has exactly the pattern size.
+*
+* The work is one pass over the frame plus a bounded number of candidates and
+* seeds, so the time per frame hardly depends on what else is in the frame.
+*
+* The corners come in the order of findChessboardCorners: patternHeight rows of
+* patternWidth corners, the rows running left to right and stacked downwards.
+* When patternWidth + patternHeight is odd, the squares diagonally outside the
+* first and the last corner have different colors and the grid is turned so
+* that the first one is the darker, which keeps the order fixed to the board
+* when it is turned upside down. A square pattern can't tell its rows from its
+* columns, the more horizontal direction is taken as the rows.
+*/
+
+#pragma once
+
+#ifndef __SADDLE_POINT_DETECTOR_H__
+#define __SADDLE_POINT_DETECTOR_H__
+
+#include "MultiRGBDCalibrationUtil.h"
+
+#define SADDLE_BLUR_SIGMA 1.5
+#define SADDLE_BAND_ROWS 64 // rows of a band scored by one thread
+#define SADDLE_NMS_RADIUS 3 // pixels
+#define SADDLE_RESPONSE_RATIO 0.02f // of the strongest response in the frame
+#define SADDLE_MIN_RESPONSE 0.5f
+#define SADDLE_RING_RADIUS 4 // pixels
+#define SADDLE_RING_SAMPLES 16
+#define SADDLE_MIN_RING_CONTRAST 12.0f // gray levels
+#define SADDLE_MAX_CANDIDATE_FACTOR 3 // times the num. of inner corners
+#define SADDLE_MAX_SEEDS 16
+#define SADDLE_GRID_TOLERANCE 0.35f // of the distance to the neighbour the corner is predicted from
+
+class SaddlePointDetector
+{
+public:
+	// found by the band workers
+	struct Saddle
+	{
+		cv::Point2f position;
+		float response;
+
+		// strongest first
+		bool operator<(const Saddle& saddle) const
+		{
+			return response > saddle.response;
+		}
+	};
+
+	SaddlePointDetector();
+	virtual ~SaddlePointDetector();
+
+	void init(const cv::Size patternSize);
+
+	// called concurrently from the detection workers; the corners are at the saddle maxima,
+	// refining them is left to the caller
+	bool detect(const cv::Mat& grayMat, corner2d_t& corners) const;
+
+private:
+	void _findSaddles(const cv::Mat& blurred, std::vector<Saddle>& saddles) const;
+	// grid[(row + m) * (2m + 1) + col + m] is the saddle of the cell, -1 if none, m = max. pattern side;
+	// false unless the grid grown from the seed has the pattern size
+	bool _growGrid(const std::vector<Saddle>& saddles, const int seedId, std::vector<int>& grid,
+		cv::Rect& extent) const;
+	int _cellIndex(const cv::Point cell) const
+	{
+		return (cell.y + m_maxSide) * (2 * m_maxSide + 1) + cell.x + m_maxSide;
+	}
+	// the grid cells in findChessboardCorners order
+	void _orderCorners(const std::vector<Saddle>& saddles, const std::vector<int>& grid, const cv::Rect extent,
+		const cv::Mat& blurred, corner2d_t& corners) const;
+
+	cv::Size m_patternSize;
+	// max(patternWidth, patternHeight)
+	int m_maxSide;
+};
+
+#endif//__SADDLE_POINT_DETECTOR_H__
\ No newline at end of file
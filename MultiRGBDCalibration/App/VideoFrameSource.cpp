@@ -0,0 +1,201 @@
+#include "VideoFrameSource.h"
+#include "..\Utility\ContentKey.h"
+
+VideoFrameSource::VideoFrameSource(const std::string& colorVideoFilename,
+	const std::string& depthVideoFilename,
+	const int frameStart,
+	const int frameStride,
+	const int numFrame,
+	const int numReadAhead)
+	: m_frameStart(frameStart > 0 ? frameStart : 0),
+	m_frameStride(frameStride > 0 ? frameStride : 1),
+	m_numFrame(numFrame),
+	m_numReadAhead(numReadAhead > 0 ? numReadAhead : 1)
+{
+	_open(m_colorStream, colorVideoFilename, COLOR);
+	_open(m_depthStream, depthVideoFilename, DEPTH);
+
+	if (m_numFrame < 0)
+	{
+		int numVideoFrame = m_colorStream.capture.isOpened() ?
+			(int) m_colorStream.capture.get(cv::CAP_PROP_FRAME_COUNT) : 0;
+		m_numFrame = (numVideoFrame > m_frameStart) ?
+			(numVideoFrame - m_frameStart + m_frameStride - 1) / m_frameStride : 0;
+	}
+
+	m_colorStream.reader = std::thread(&VideoFrameSource::_readerLoop, this, &m_colorStream, COLOR);
+	m_depthStream.reader = std::thread(&VideoFrameSource::_readerLoop, this, &m_depthStream, DEPTH);
+}
+
+VideoFrameSource::~VideoFrameSource()
+{
+	VideoStream* streams[2] = { &m_colorStream, &m_depthStream };
+	for (int streamId = 0; streamId < 2; streamId++)
+	{
+		{
+			std::unique_lock<std::mutex> lock(streams[streamId]->mutex);
+			streams[streamId]->bStop = true;
+		}
+		streams[streamId]->condition.notify_all();
+		if (streams[streamId]->reader.joinable())
+			streams[streamId]->reader.join();
+		streams[streamId]->capture.release();
+	}
+}
+
+bool VideoFrameSource::read(const int frameId, const FRAME_PLANE plane, cv::Mat& dst, size_t& numByteRead)
+{
+	VideoStream& stream = (plane == COLOR) ? m_colorStream : m_depthStream;
+
+	// the compressed size of a video frame is not exposed by cv::VideoCapture
+	numByteRead = 0;
+	if (frameId < 0 || frameId >= m_numFrame)
+	{
+		dst.release();
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock(stream.mutex);
+
+	// a frame the reader has already passed is decoded again after a seek
+	if (frameId < stream.nextFrameId && stream.decoded.find(frameId) == stream.decoded.end())
+	{
+		stream.decoded.clear();
+		stream.nextFrameId = frameId;
+		stream.maxRequestedFrameId = frameId;
+		stream.bEnd = false;
+	}
+	if (frameId > stream.maxRequestedFrameId)
+		stream.maxRequestedFrameId = frameId;
+	stream.condition.notify_all();
+
+	std::map<int, cv::Mat>::iterator it;
+	while ((it = stream.decoded.find(frameId)) == stream.decoded.end())
+	{
+		if (stream.bStop || stream.bEnd || stream.nextFrameId > frameId)
+		{
+			dst.release();
+			return false;
+		}
+		stream.condition.wait(lock);
+	}
+
+	// copy into a preallocated buffer of matching size, otherwise just take the frame
+	if (dst.data != NULL && dst.size() == it->second.size() && dst.type() == it->second.type())
+		it->second.copyTo(dst);
+	else
+		dst = it->second;
+	stream.decoded.erase(it);
+	stream.condition.notify_all();
+
+	return dst.data != NULL;
+}
+
+bool VideoFrameSource::getContentKey(const int frameId, const FRAME_PLANE plane, unsigned long long& key) const
+{
+	// the name holds the video position of the frame
+	const VideoStream& stream = (plane == COLOR) ? m_colorStream : m_depthStream;
+	if (frameId < 0 || frameId >= m_numFrame || !getFileContentKey(stream.filename, key))
+		return false;
+	key = hashContentString(getName(frameId, plane), key);
+	return true;
+}
+
+std::string VideoFrameSource::getName(const int frameId, const FRAME_PLANE plane) const
+{
+	char buffer[32];
+	sprintf_s(buffer, 32, "#%d", m_frameStart + frameId * m_frameStride);
+
+	const VideoStream& stream = (plane == COLOR) ? m_colorStream : m_depthStream;
+	return stream.filename + std::string(buffer);
+}
+
+void VideoFrameSource::_open(VideoStream& stream, const std::string& fn, const FRAME_PLANE plane)
+{
+	stream.filename = fn;
+	stream.nextFrameId = 0;
+	stream.videoPosition = 0;
+	stream.maxRequestedFrameId = -1;
+	stream.bEnd = false;
+	stream.bStop = false;
+
+	if (!stream.capture.open(fn))
+	{
+		printf("Couldn't open video %s\n", fn.c_str());
+		stream.bEnd = true;
+		return;
+	}
+
+	// keep the 16-bit samples of the depth video instead of converting to 8-bit BGR
+	if (plane == DEPTH)
+		stream.capture.set(cv::CAP_PROP_CONVERT_RGB, 0);
+}
+
+void VideoFrameSource::_readerLoop(VideoStream* stream, const FRAME_PLANE plane)
+{
+	std::unique_lock<std::mutex> lock(stream->mutex);
+	for (;;)
+	{
+		// decode ahead of the requests, but never more than numReadAhead frames
+		while (!stream->bStop
+			&& (stream->bEnd
+			|| stream->nextFrameId >= m_numFrame
+			|| stream->nextFrameId > stream->maxRequestedFrameId + m_numReadAhead
+			|| (int) stream->decoded.size() >= m_numReadAhead))
+			stream->condition.wait(lock);
+
+		if (stream->bStop)
+			return;
+
+		int frameId = stream->nextFrameId;
+		lock.unlock();
+
+		cv::Mat frame;
+		int videoIndex = m_frameStart + frameId * m_frameStride;
+		bool bGrabbed = true;
+		if (videoIndex < stream->videoPosition)
+		{
+			stream->capture.set(cv::CAP_PROP_POS_FRAMES, videoIndex);
+			stream->videoPosition = videoIndex;
+		}
+		// frames skipped by the stride are grabbed without being retrieved
+		while (bGrabbed && stream->videoPosition <= videoIndex)
+		{
+			bGrabbed = stream->capture.grab();
+			stream->videoPosition++;
+		}
+		if (bGrabbed)
+			_retrieve(*stream, plane, frame);
+
+		lock.lock();
+
+		// drop the frame if a seek happened meanwhile
+		if (stream->nextFrameId != frameId)
+			continue;
+
+		if (!bGrabbed)
+			stream->bEnd = true;
+		else
+			stream->decoded[frameId] = frame;
+		stream->nextFrameId++;
+		stream->condition.notify_all();
+	}
+}
+
+bool VideoFrameSource::_retrieve(VideoStream& stream, const FRAME_PLANE plane, cv::Mat& frame)
+{
+	if (!stream.capture.retrieve(frame) || frame.data == NULL)
+	{
+		frame.release();
+		return false;
+	}
+
+	if (plane == DEPTH && frame.type() != CV_16UC1)
+	{
+		printf("Depth video %s does not decode to 16-bit single channel frames!\n", stream.filename.c_str());
+		frame.release();
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
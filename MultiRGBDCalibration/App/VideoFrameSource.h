@@ -0,0 +1,75 @@
+/* This class reads color and 16-bit depth frames from a pair of video files.
+*
+* Both videos should use a lossless or intra-only codec (e.g. FFV1, MJPEG).
+* Each video is decoded front to back by its own read-ahead thread; frame
+* frameId of the source is frame (frameStart + frameId * frameStride) of the
+* video, so frames outside the selection are only grabbed, never retrieved.
+*/
+
+#pragma once
+
+#ifndef __VIDEO_FRAME_SOURCE_H__
+#define __VIDEO_FRAME_SOURCE_H__
+
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "FrameSource.h"
+
+class VideoFrameSource : public FrameSource
+{
+public:
+	// numFrame < 0 selects every frame up to the end of the color video
+	VideoFrameSource(const std::string& colorVideoFilename,
+		const std::string& depthVideoFilename,
+		const int frameStart,
+		const int frameStride,
+		const int numFrame,
+		const int numReadAhead);
+	virtual ~VideoFrameSource();
+
+	virtual int getNumFrame() const
+	{
+		return m_numFrame;
+	}
+
+	virtual bool read(const int frameId, const FRAME_PLANE plane, cv::Mat& dst, size_t& numByteRead);
+	virtual bool getContentKey(const int frameId, const FRAME_PLANE plane, unsigned long long& key) const;
+	virtual std::string getName(const int frameId, const FRAME_PLANE plane) const;
+
+private:
+	struct VideoStream
+	{
+		std::string filename;
+		cv::VideoCapture capture;
+		std::thread reader;
+		std::mutex mutex;
+		std::condition_variable condition;
+
+		// decoded frames waiting to be read, keyed by frameId
+		std::map<int, cv::Mat> decoded;
+		// next frameId the reader decodes, and the video position of the capture
+		int nextFrameId;
+		int videoPosition;
+		// highest frameId requested so far; the reader stays numReadAhead frames ahead of it
+		int maxRequestedFrameId;
+		bool bEnd;
+		bool bStop;
+	};
+
+	void _open(VideoStream& stream, const std::string& fn, const FRAME_PLANE plane);
+	void _readerLoop(VideoStream* stream, const FRAME_PLANE plane);
+	bool _retrieve(VideoStream& stream, const FRAME_PLANE plane, cv::Mat& frame);
+
+	int m_frameStart;
+	int m_frameStride;
+	int m_numFrame;
+	int m_numReadAhead;
+
+	VideoStream m_colorStream;
+	VideoStream m_depthStream;
+};
+
+#endif//__VIDEO_FRAME_SOURCE_H__
\ No newline at end of file
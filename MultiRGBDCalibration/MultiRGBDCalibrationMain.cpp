@@ -1,20 +1,32 @@
+#include <cstdio>
+#include <cstring>
+
 #include "App/MultiRGBDCalibrationApp.h"
 
 int main(int argc, char* argv[])
 {
-#if 0
-	if (argc < 1)
+	MultiRGBDCalibrationApp app;
+
+	// usage: MultiRGBDCalibration [--convert] config.ini
+	// "--convert" packs the png folders into .rgbdseq containers instead of calibrating
+	int argId = 1;
+	bool bConvert = false;
+	if (argc > argId && strcmp(argv[argId], "--convert") == 0)
 	{
-		printf("Please add path for configuration file\n");
-		return 0;
+		bConvert = true;
+		argId++;
 	}
-#endif
 
-	MultiRGBDCalibrationApp app;
-
-	//app.loadConfig("E:/Data/MultiRGBDCalibration/example00/config.ini");
-	app.loadConfig("E:/Data/MultiRGBDCalibration/realsense00/config.ini");
-	app.startMainLoop();
+	if (argc <= argId)
+	{
+		printf("usage: %s [--convert] config.ini\n", argv[0]);
+		return 1;
+	}
+	std::string configFilename = argv[argId];
 
-	return 0;
+	if (!app.loadConfig(configFilename))
+		return 1;
+	if (bConvert)
+		return app.convertToSequence() ? 0 : 1;
+	return app.startMainLoop() ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "AsyncFileReader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+AsyncFileReader::AsyncFileReader() : m_bEnabled(false), m_queueDepth(0), m_maxInFlightBytes(0), m_inFlightBytes(0),
+	m_bStop(false), m_numPrefetchHit(0), m_numPrefetchMiss(0), m_numBytePrefetched(0)
+{
+
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	clear();
+}
+
+void AsyncFileReader::init(const int queueDepth, const size_t maxInFlightBytes)
+{
+	clear();
+
+	m_queueDepth = std::max(queueDepth, 1);
+	m_maxInFlightBytes = maxInFlightBytes;
+	m_numPrefetchHit = 0;
+	m_numPrefetchMiss = 0;
+	m_numBytePrefetched = 0;
+	m_bStop = false;
+
+	m_bEnabled = true;
+	for (int threadId = 0; threadId < m_queueDepth; threadId++)
+		m_workers.push_back(std::thread(&AsyncFileReader::_readLoop, this));
+}
+
+void AsyncFileReader::clear()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_bStop = true;
+	}
+	m_startCondition.notify_all();
+
+	for (int threadId = 0; threadId < m_workers.size(); threadId++)
+	{
+		if (m_workers[threadId].joinable())
+			m_workers[threadId].join();
+	}
+	m_workers.clear();
+
+	for (std::map<std::string, Request*>::iterator it = m_requests.begin(); it != m_requests.end(); it++)
+		delete it->second;
+	m_requests.clear();
+	m_pending.clear();
+	m_inFlightBytes = 0;
+	m_bEnabled = false;
+}
+
+void AsyncFileReader::prefetch(const std::string& filename)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (!m_bEnabled)
+			return;
+		m_pending.push_back(filename);
+	}
+	m_startCondition.notify_one();
+}
+
+bool AsyncFileReader::read(const std::string& filename, std::vector<unsigned char>& data)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		std::map<std::string, Request*>::iterator it = m_requests.find(filename);
+		if (it != m_requests.end())
+		{
+			Request* request = it->second;
+			while (request->state == SUBMITTED)
+				m_doneCondition.wait(lock);
+
+			m_requests.erase(filename);
+			m_inFlightBytes -= request->data.size();
+			bool bDone = (request->state == DONE);
+			if (bDone)
+			{
+				data.swap(request->data);
+				m_numPrefetchHit++;
+			}
+			delete request;
+
+			// the freed bytes let the next read-ahead start
+			m_startCondition.notify_all();
+			if (bDone)
+				return true;
+		}
+		else {
+			// not started yet, read it here instead of waiting for the queue
+			std::deque<std::string>::iterator pendingIt = std::find(m_pending.begin(), m_pending.end(), filename);
+			if (pendingIt != m_pending.end())
+				m_pending.erase(pendingIt);
+			m_numPrefetchMiss++;
+		}
+	}
+
+	// a failed read-ahead is retried here so the caller reports the actual error
+	return readFile(filename, data);
+}
+
+bool AsyncFileReader::readFile(const std::string& filename, std::vector<unsigned char>& data)
+{
+	data.clear();
+
+	std::ifstream file(filename, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	file.seekg(0, std::ios::end);
+	std::streamoff fileSize = file.tellg();
+	file.seekg(0, std::ios::beg);
+	if (fileSize > 0)
+	{
+		data.resize((size_t) fileSize);
+		file.read((char*) &data[0], fileSize);
+		if (!file)
+			data.clear();
+	}
+	file.close();
+
+	return !data.empty();
+}
+
+void AsyncFileReader::printStats()
+{
+	if (!m_bEnabled || m_numPrefetchHit + m_numPrefetchMiss == 0)
+		return;
+
+	printf("Read-ahead (queue depth %d, %.0f MB in flight): %d of %d files ready, %.1f MB prefetched\n",
+		m_queueDepth, m_maxInFlightBytes / (1024.0 * 1024.0),
+		m_numPrefetchHit, m_numPrefetchHit + m_numPrefetchMiss, m_numBytePrefetched / (1024.0 * 1024.0));
+}
+
+bool AsyncFileReader::_canStart() const
+{
+	return !m_pending.empty() && (m_maxInFlightBytes == 0 || m_inFlightBytes < m_maxInFlightBytes);
+}
+
+AsyncFileReader::Request* AsyncFileReader::_start()
+{
+	std::string filename = m_pending.front();
+	m_pending.pop_front();
+
+	// already on its way
+	if (m_requests.find(filename) != m_requests.end())
+		return NULL;
+
+	Request* request = new Request;
+	request->filename = filename;
+	request->state = SUBMITTED;
+	m_requests[filename] = request;
+
+	return request;
+}
+
+void AsyncFileReader::_finish(Request* request, const bool bSuccess)
+{
+	if (bSuccess)
+	{
+		request->state = DONE;
+		m_numBytePrefetched += (long long) request->data.size();
+	}
+	else {
+		request->state = FAILED;
+		m_inFlightBytes -= request->data.size();
+		std::vector<unsigned char>().swap(request->data);
+	}
+	m_doneCondition.notify_all();
+}
+
+void AsyncFileReader::_readLoop()
+{
+	for (;;)
+	{
+		Request* request = NULL;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (!m_bStop && !_canStart())
+				m_startCondition.wait(lock);
+
+			if (m_bStop)
+				return;
+
+			request = _start();
+		}
+		if (request == NULL)
+			continue;
+
+		std::vector<unsigned char> data;
+		bool bSuccess = readFile(request->filename, data);
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			request->data.swap(data);
+			m_inFlightBytes += request->data.size();
+			_finish(request, bSuccess);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+/* This class reads whole files ahead of the threads that consume them.
+*
+* Files queued with prefetch() are read in the background in queue order, at most
+* queueDepth at once and until about maxInFlightBytes are read but not yet taken.
+* Each of queueDepth threads keeps one blocking read in flight.
+*/
+
+#pragma once
+
+#ifndef __ASYNC_FILE_READER_H__
+#define __ASYNC_FILE_READER_H__
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class AsyncFileReader
+{
+public:
+	AsyncFileReader();
+	virtual ~AsyncFileReader();
+
+	void init(const int queueDepth, const size_t maxInFlightBytes);
+	// stop the background reads and drop the files not taken yet
+	void clear();
+
+	// queue a read-ahead of the whole file
+	void prefetch(const std::string& filename);
+	// return the whole file, waiting for its read-ahead or reading it directly when it was not
+	// prefetched. Called concurrently from the decode threads.
+	bool read(const std::string& filename, std::vector<unsigned char>& data);
+
+	// read a whole file on the calling thread
+	static bool readFile(const std::string& filename, std::vector<unsigned char>& data);
+
+	bool isEnabled() const
+	{
+		return m_bEnabled;
+	}
+
+	void printStats();
+
+private:
+	enum REQUEST_STATE{SUBMITTED, DONE, FAILED};
+
+	struct Request
+	{
+		std::string filename;
+		std::vector<unsigned char> data;
+		REQUEST_STATE state;
+	};
+
+	// m_mutex must be held
+	bool _canStart() const;
+	Request* _start();
+	void _finish(Request* request, const bool bSuccess);
+
+	void _readLoop();
+
+	bool m_bEnabled;
+	int m_queueDepth;
+	size_t m_maxInFlightBytes;
+	size_t m_inFlightBytes;
+
+	std::deque<std::string> m_pending;
+	std::map<std::string, Request*> m_requests;
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_startCondition;
+	std::condition_variable m_doneCondition;
+	bool m_bStop;
+
+	/* ----- Statistics ----- */
+	int m_numPrefetchHit;
+	int m_numPrefetchMiss;
+	long long m_numBytePrefetched;
+};
+
+#endif//__ASYNC_FILE_READER_H__
\ No newline at end of file
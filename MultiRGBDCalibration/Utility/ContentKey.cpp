@@ -0,0 +1,44 @@
+#include "ContentKey.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define CONTENT_KEY_PRIME 1099511628211ULL
+
+unsigned long long hashContentBytes(const void* data, const size_t size, const unsigned long long seed)
+{
+	const unsigned char* bytes = (const unsigned char*) data;
+	unsigned long long hash = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= CONTENT_KEY_PRIME;
+	}
+	return hash;
+}
+
+unsigned long long hashContentString(const std::string& str, const unsigned long long seed)
+{
+	return hashContentBytes(str.data(), str.size(), seed);
+}
+
+bool getFileContentKey(const std::string& filename, unsigned long long& key)
+{
+	long long fileSize, modifiedTime;
+#ifdef _WIN32
+	struct _stat64 fileStat;
+	if (_stat64(filename.c_str(), &fileStat) != 0)
+		return false;
+#else
+	struct stat fileStat;
+	if (stat(filename.c_str(), &fileStat) != 0)
+		return false;
+#endif
+	fileSize = (long long) fileStat.st_size;
+	modifiedTime = (long long) fileStat.st_mtime;
+
+	key = hashContentString(filename);
+	key = hashContentBytes(&fileSize, sizeof(fileSize), key);
+	key = hashContentBytes(&modifiedTime, sizeof(modifiedTime), key);
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+/* 64-bit keys that tell whether stored content has changed, without reading it.
+*
+* The keys are FNV-1a hashes. A file is keyed by its path, size and modification
+* time, which is what a rerun on the same dataset needs to recognize its frames.
+*/
+
+#pragma once
+
+#ifndef __CONTENT_KEY_H__
+#define __CONTENT_KEY_H__
+
+#include <string>
+
+#define CONTENT_KEY_SEED 14695981039346656037ULL
+
+unsigned long long hashContentBytes(const void* data, const size_t size, const unsigned long long seed = CONTENT_KEY_SEED);
+unsigned long long hashContentString(const std::string& str, const unsigned long long seed = CONTENT_KEY_SEED);
+
+// false if the file can't be found
+bool getFileContentKey(const std::string& filename, unsigned long long& key);
+
+#endif//__CONTENT_KEY_H__
\ No newline at end of file
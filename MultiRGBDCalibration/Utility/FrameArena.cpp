@@ -0,0 +1,130 @@
+#include "FrameArena.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024) // bytes
+
+FrameArena::FrameArena() : m_slab(NULL), m_capacity(0), m_used(0), m_bHugePage(false)
+{
+
+}
+
+FrameArena::FrameArena(const FrameArena& arena) : m_slab(NULL), m_capacity(0), m_used(0), m_bHugePage(false)
+{
+
+}
+
+FrameArena& FrameArena::operator=(const FrameArena& arena)
+{
+	if (this != &arena)
+		clear();
+	return *this;
+}
+
+FrameArena::~FrameArena()
+{
+	clear();
+}
+
+bool FrameArena::reserve(const size_t numBytes)
+{
+	if (numBytes <= m_capacity)
+	{
+		reset();
+		return true;
+	}
+
+	clear();
+
+	size_t hugeBytes = (numBytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+	void* slab = NULL;
+
+#ifdef _WIN32
+	// large pages need the "Lock pages in memory" privilege, fall back to normal pages otherwise
+	size_t largePageSize = GetLargePageMinimum();
+	if (largePageSize > 0)
+	{
+		size_t largeBytes = (numBytes + largePageSize - 1) / largePageSize * largePageSize;
+		slab = VirtualAlloc(NULL, largeBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (slab != NULL)
+		{
+			hugeBytes = largeBytes;
+			m_bHugePage = true;
+		}
+	}
+	if (slab == NULL)
+		slab = VirtualAlloc(NULL, hugeBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	// explicit huge pages need a reserved hugetlbfs pool, fall back to transparent huge pages
+#ifdef MAP_HUGETLB
+	slab = mmap(NULL, hugeBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (slab != MAP_FAILED)
+		m_bHugePage = true;
+	else
+		slab = NULL;
+#endif
+	if (slab == NULL)
+	{
+		slab = mmap(NULL, hugeBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (slab == MAP_FAILED)
+			slab = NULL;
+#ifdef MADV_HUGEPAGE
+		else
+			madvise(slab, hugeBytes, MADV_HUGEPAGE);
+#endif
+	}
+#endif
+
+	if (slab == NULL)
+	{
+		m_bHugePage = false;
+		return false;
+	}
+
+	m_slab = (unsigned char*) slab;
+	m_capacity = hugeBytes;
+	m_used = 0;
+	return true;
+}
+
+void FrameArena::reset()
+{
+	m_used = 0;
+}
+
+void FrameArena::clear()
+{
+	if (m_slab != NULL)
+	{
+#ifdef _WIN32
+		VirtualFree(m_slab, 0, MEM_RELEASE);
+#else
+		munmap(m_slab, m_capacity);
+#endif
+	}
+
+	m_slab = NULL;
+	m_capacity = 0;
+	m_used = 0;
+	m_bHugePage = false;
+}
+
+void* FrameArena::allocate(const size_t numBytes, const size_t alignment)
+{
+	if (m_slab == NULL)
+		return NULL;
+
+	size_t offset = (m_used + alignment - 1) / alignment * alignment;
+	if (offset + numBytes > m_capacity)
+		return NULL;
+
+	m_used = offset + numBytes;
+	return m_slab + offset;
+}
\ No newline at end of file
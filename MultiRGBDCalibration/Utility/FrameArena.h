@@ -0,0 +1,54 @@
+/* This class hands out aligned blocks from one large slab.
+*
+* The slab is backed by huge pages where the system allows it. reset() rewinds
+* the slab without freeing it, so the same memory serves the next dataset as
+* long as it is large enough.
+*/
+
+#pragma once
+
+#ifndef __FRAME_ARENA_H__
+#define __FRAME_ARENA_H__
+
+#include <cstddef>
+
+class FrameArena
+{
+public:
+	FrameArena();
+	// a copy starts without a slab of its own
+	FrameArena(const FrameArena& arena);
+	FrameArena& operator=(const FrameArena& arena);
+	virtual ~FrameArena();
+
+	// make sure the slab holds at least numBytes, reallocating only when it is too small
+	bool reserve(const size_t numBytes);
+	// rewind the slab, keeping the memory
+	void reset();
+	// free the slab
+	void clear();
+
+	// aligned block from the slab, NULL when the slab is exhausted
+	void* allocate(const size_t numBytes, const size_t alignment = 64);
+
+	size_t getCapacity() const
+	{
+		return m_capacity;
+	}
+	size_t getUsedBytes() const
+	{
+		return m_used;
+	}
+	bool isHugePage() const
+	{
+		return m_bHugePage;
+	}
+
+private:
+	unsigned char* m_slab;
+	size_t m_capacity;
+	size_t m_used;
+	bool m_bHugePage;
+};
+
+#endif//__FRAME_ARENA_H__
\ No newline at end of file
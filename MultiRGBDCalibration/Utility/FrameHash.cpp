@@ -0,0 +1,56 @@
+#include "FrameHash.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+static int popCount64(const unsigned long long x)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	return (int) __popcnt64(x);
+#elif defined(__GNUC__)
+	return __builtin_popcountll(x);
+#else
+	unsigned long long v = x - ((x >> 1) & 0x5555555555555555ULL);
+	v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+	v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return (int) ((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+FrameHash computeFrameHash(const cv::Mat& frame)
+{
+	FrameHash hash;
+	for (int word = 0; word < FRAME_HASH_WORDS; word++)
+		hash.bits[word] = 0;
+
+	if (frame.data == NULL)
+		return hash;
+
+	// shrink first, so a color frame only converts the thumbnail
+	cv::Mat thumbnail;
+	cv::resize(frame, thumbnail, cv::Size(FRAME_HASH_SIZE + 1, FRAME_HASH_SIZE), 0, 0, cv::INTER_AREA);
+	if (thumbnail.channels() == 3)
+		cv::cvtColor(thumbnail, thumbnail, CV_BGR2GRAY);
+
+	int bit = 0;
+	for (int y = 0; y < FRAME_HASH_SIZE; y++)
+	{
+		const uchar* row = thumbnail.ptr<uchar>(y);
+		for (int x = 0; x < FRAME_HASH_SIZE; x++, bit++)
+		{
+			if (row[x] > row[x + 1])
+				hash.bits[bit / 64] |= 1ULL << (bit % 64);
+		}
+	}
+
+	return hash;
+}
+
+int frameHashDistance(const FrameHash& hash0, const FrameHash& hash1)
+{
+	int distance = 0;
+	for (int word = 0; word < FRAME_HASH_WORDS; word++)
+		distance += popCount64(hash0.bits[word] ^ hash1.bits[word]);
+	return distance;
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+/* Perceptual hash for finding near-duplicate frames.
+*
+* The frame is shrunk to (FRAME_HASH_SIZE + 1) x FRAME_HASH_SIZE pixels with area
+* averaging and every pixel that is brighter than its right neighbour sets one bit
+* (difference hash). Frames that look alike differ in only a few bits, regardless
+* of small exposure changes and sensor noise.
+*/
+
+#pragma once
+
+#ifndef __FRAME_HASH_H__
+#define __FRAME_HASH_H__
+
+#include <opencv2/opencv.hpp>
+
+#define FRAME_HASH_SIZE 16
+#define FRAME_HASH_WORDS (FRAME_HASH_SIZE * FRAME_HASH_SIZE / 64)
+
+struct FrameHash
+{
+	unsigned long long bits[FRAME_HASH_WORDS];
+};
+
+// hash of an 8-bit grayscale or BGR frame
+FrameHash computeFrameHash(const cv::Mat& frame);
+
+// num. of differing bits, 0 for identical frames
+int frameHashDistance(const FrameHash& hash0, const FrameHash& hash1);
+
+#endif//__FRAME_HASH_H__
\ No newline at end of file
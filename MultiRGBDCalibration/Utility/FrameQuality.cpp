@@ -0,0 +1,118 @@
+#include "FrameQuality.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FRAME_QUALITY_SSE2 1
+#endif
+
+// 16-pixel blocks summed in 32-bit lanes before they are flushed, 256 * 4 squared Laplacians stay below 2^31
+#define FRAME_QUALITY_FLUSH_BLOCKS 256
+
+struct QualitySums
+{
+	long long lapSum;
+	long long lapSquaredSum;
+	long long lumaSum;
+	long long numDark;
+	long long numBright;
+};
+
+#if FRAME_QUALITY_SSE2
+static long long sumInt32Lanes(const __m128i v)
+{
+	int lanes[4];
+	_mm_storeu_si128((__m128i*) lanes, v);
+	return (long long) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+static long long sumInt64Lanes(const __m128i v)
+{
+	long long lanes[2];
+	_mm_storeu_si128((__m128i*) lanes, v);
+	return lanes[0] + lanes[1];
+}
+#endif
+
+// interior pixels 1..width-2 of row
+static void scoreRow(const uchar* above, const uchar* row, const uchar* below, const int width, QualitySums& sums)
+{
+	int x = 1;
+
+#if FRAME_QUALITY_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones16 = _mm_set1_epi16(1);
+	const __m128i ones8 = _mm_set1_epi8(1);
+	const __m128i darkMax = _mm_set1_epi8((char) (FRAME_QUALITY_DARK_LEVEL - 1));
+	const __m128i brightMin = _mm_set1_epi8((char) FRAME_QUALITY_BRIGHT_LEVEL);
+
+	__m128i luma64 = zero, dark64 = zero, bright64 = zero;
+	while (x + 17 <= width)
+	{
+		__m128i lapSum32 = zero, lapSquaredSum32 = zero;
+		for (int block = 0; block < FRAME_QUALITY_FLUSH_BLOCKS && x + 17 <= width; block++, x += 16)
+		{
+			__m128i center = _mm_loadu_si128((const __m128i*) (row + x));
+			__m128i left = _mm_loadu_si128((const __m128i*) (row + x - 1));
+			__m128i right = _mm_loadu_si128((const __m128i*) (row + x + 1));
+			__m128i up = _mm_loadu_si128((const __m128i*) (above + x));
+			__m128i down = _mm_loadu_si128((const __m128i*) (below + x));
+
+			// neighbours - 4 * center in 16-bit lanes
+			__m128i lapLo = _mm_sub_epi16(
+				_mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(left, zero), _mm_unpacklo_epi8(right, zero)),
+					_mm_add_epi16(_mm_unpacklo_epi8(up, zero), _mm_unpacklo_epi8(down, zero))),
+				_mm_slli_epi16(_mm_unpacklo_epi8(center, zero), 2));
+			__m128i lapHi = _mm_sub_epi16(
+				_mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(left, zero), _mm_unpackhi_epi8(right, zero)),
+					_mm_add_epi16(_mm_unpackhi_epi8(up, zero), _mm_unpackhi_epi8(down, zero))),
+				_mm_slli_epi16(_mm_unpackhi_epi8(center, zero), 2));
+
+			lapSum32 = _mm_add_epi32(lapSum32, _mm_add_epi32(_mm_madd_epi16(lapLo, ones16), _mm_madd_epi16(lapHi, ones16)));
+			lapSquaredSum32 = _mm_add_epi32(lapSquaredSum32, _mm_add_epi32(_mm_madd_epi16(lapLo, lapLo), _mm_madd_epi16(lapHi, lapHi)));
+
+			// exposure, counted as bytes of 1 summed by psadbw
+			__m128i dark = _mm_and_si128(_mm_cmpeq_epi8(_mm_min_epu8(center, darkMax), center), ones8);
+			__m128i bright = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(center, brightMin), center), ones8);
+			luma64 = _mm_add_epi64(luma64, _mm_sad_epu8(center, zero));
+			dark64 = _mm_add_epi64(dark64, _mm_sad_epu8(dark, zero));
+			bright64 = _mm_add_epi64(bright64, _mm_sad_epu8(bright, zero));
+		}
+		sums.lapSum += sumInt32Lanes(lapSum32);
+		sums.lapSquaredSum += sumInt32Lanes(lapSquaredSum32);
+	}
+	sums.lumaSum += sumInt64Lanes(luma64);
+	sums.numDark += sumInt64Lanes(dark64);
+	sums.numBright += sumInt64Lanes(bright64);
+#endif
+
+	for (; x < width - 1; x++)
+	{
+		int lap = row[x - 1] + row[x + 1] + above[x] + below[x] - 4 * row[x];
+		sums.lapSum += lap;
+		sums.lapSquaredSum += lap * lap;
+		sums.lumaSum += row[x];
+		if (row[x] < FRAME_QUALITY_DARK_LEVEL)
+			sums.numDark++;
+		if (row[x] >= FRAME_QUALITY_BRIGHT_LEVEL)
+			sums.numBright++;
+	}
+}
+
+FrameQuality computeFrameQuality(const cv::Mat& gray)
+{
+	FrameQuality quality;
+	if (gray.data == NULL || gray.type() != CV_8UC1 || gray.rows < 3 || gray.cols < 3)
+		return quality;
+
+	QualitySums sums = {0, 0, 0, 0, 0};
+	for (int y = 1; y < gray.rows - 1; y++)
+		scoreRow(gray.ptr<uchar>(y - 1), gray.ptr<uchar>(y), gray.ptr<uchar>(y + 1), gray.cols, sums);
+
+	double numPixel = (double) (gray.rows - 2) * (gray.cols - 2);
+	double lapMean = sums.lapSum / numPixel;
+	quality.sharpness = (float) (sums.lapSquaredSum / numPixel - lapMean * lapMean);
+	quality.brightness = (float) (sums.lumaSum / numPixel);
+	quality.darkFraction = (float) (sums.numDark / numPixel);
+	quality.brightFraction = (float) (sums.numBright / numPixel);
+	return quality;
+}
\ No newline at end of file
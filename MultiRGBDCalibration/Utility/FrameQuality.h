@@ -0,0 +1,38 @@
+/* Quality scores of a grayscale frame for skipping unusable frames before detection.
+*
+* A single pass over the frame, 16 pixels at a time with SSE2, accumulates the
+* variance of the 4-neighbour Laplacian (sharpness, low for motion blur and
+* defocus) together with the mean brightness and the fractions of crushed
+* and saturated pixels (exposure).
+*/
+
+#pragma once
+
+#ifndef __FRAME_QUALITY_H__
+#define __FRAME_QUALITY_H__
+
+#include <opencv2/opencv.hpp>
+
+#define FRAME_QUALITY_DARK_LEVEL 16 // pixels below are crushed to black
+#define FRAME_QUALITY_BRIGHT_LEVEL 240 // pixels at or above are saturated
+
+struct FrameQuality
+{
+	// variance of the Laplacian, -1 if not scored
+	float sharpness;
+	// mean gray level, 0..255
+	float brightness;
+	// fractions of the pixels below FRAME_QUALITY_DARK_LEVEL and at or above FRAME_QUALITY_BRIGHT_LEVEL
+	float darkFraction;
+	float brightFraction;
+
+	FrameQuality() : sharpness(-1.0f), brightness(0.0f), darkFraction(0.0f), brightFraction(0.0f)
+	{
+
+	}
+};
+
+// scores of an 8-bit grayscale frame, the border pixels are left out
+FrameQuality computeFrameQuality(const cv::Mat& gray);
+
+#endif//__FRAME_QUALITY_H__
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "FrameSet.h"
+#include "dirent.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+
+FramePattern::FramePattern() : m_numDigit(0)
+{
+
+}
+
+bool FramePattern::init(const std::string& pattern)
+{
+	size_t percentPos = pattern.find('%');
+	if (percentPos == std::string::npos)
+	{
+		printf("Frame pattern %s has no %%d\n", pattern.c_str());
+		return false;
+	}
+
+	size_t pos = percentPos + 1;
+	int numDigit = 0;
+	while (pos < pattern.size() && pattern[pos] >= '0' && pattern[pos] <= '9')
+	{
+		numDigit = numDigit * 10 + (pattern[pos] - '0');
+		pos++;
+	}
+	if (pos >= pattern.size() || pattern[pos] != 'd')
+	{
+		printf("Frame pattern %s has no %%d\n", pattern.c_str());
+		return false;
+	}
+
+	m_prefix = pattern.substr(0, percentPos);
+	m_suffix = pattern.substr(pos + 1);
+	m_numDigit = numDigit;
+	return true;
+}
+
+std::string FramePattern::format(const int frameNumber) const
+{
+	// like %0Nd, larger numbers simply take more digits
+	std::string digits = std::to_string((long long) frameNumber);
+	if (digits.size() < m_numDigit)
+		digits.insert(0, m_numDigit - digits.size(), '0');
+
+	return m_prefix + digits + m_suffix;
+}
+
+bool FramePattern::parse(const std::string& filename, int& frameNumber) const
+{
+	if (filename.size() <= m_prefix.size() + m_suffix.size()
+		|| filename.compare(0, m_prefix.size(), m_prefix) != 0
+		|| filename.compare(filename.size() - m_suffix.size(), m_suffix.size(), m_suffix) != 0)
+		return false;
+
+	std::string digits = filename.substr(m_prefix.size(), filename.size() - m_prefix.size() - m_suffix.size());
+	if (digits.size() < m_numDigit || digits.size() > 9)
+		return false;
+	for (int i = 0; i < digits.size(); i++)
+	{
+		if (digits[i] < '0' || digits[i] > '9')
+			return false;
+	}
+
+	frameNumber = atoi(digits.c_str());
+	return true;
+}
+
+FrameSet::FrameSet() : m_numFrame(0)
+{
+
+}
+
+void FrameSet::clear()
+{
+	m_runs.clear();
+	m_numFrame = 0;
+}
+
+void FrameSet::initRange(const int frameStart, const int frameStride, const int numFrame)
+{
+	clear();
+	_addFrames(frameStart, frameStride, numFrame);
+}
+
+bool FrameSet::initList(const std::string& frameList)
+{
+	clear();
+
+	size_t tokenStart = 0;
+	while (tokenStart <= frameList.size())
+	{
+		size_t tokenEnd = frameList.find(',', tokenStart);
+		if (tokenEnd == std::string::npos)
+			tokenEnd = frameList.size();
+		std::string token = frameList.substr(tokenStart, tokenEnd - tokenStart);
+		tokenStart = tokenEnd + 1;
+
+		// "first", "first-last" or "first-last:stride"
+		int first = 0, last = 0, stride = 1;
+		char rest = 0;
+		int numField = sscanf(token.c_str(), " %d - %d : %d %c", &first, &last, &stride, &rest);
+		if (numField == EOF)
+			continue;
+		if (numField == 1)
+			last = first;
+		if (numField == 2 || numField == 1)
+			stride = 1;
+		if (numField > 3 || first < 0 || last < first || stride < 1)
+		{
+			printf("Invalid frame range \"%s\" in frame list\n", token.c_str());
+			clear();
+			return false;
+		}
+
+		_addFrames(first, stride, (last - first) / stride + 1);
+	}
+
+	return m_numFrame > 0;
+}
+
+bool FrameSet::initScan(const std::vector<std::string>& folders, const std::vector<FramePattern>& patterns)
+{
+	clear();
+
+	std::vector<int> frameNumbers;
+	for (int folderId = 0; folderId < folders.size(); folderId++)
+	{
+		DIR* dir = opendir(folders[folderId].c_str());
+		if (dir == NULL)
+		{
+			printf("Couldn't scan %s for frames\n", folders[folderId].c_str());
+			return false;
+		}
+
+		std::vector<int> folderFrameNumbers;
+		struct dirent* entry;
+		while ((entry = readdir(dir)) != NULL)
+		{
+			int frameNumber;
+			if (patterns[folderId].parse(entry->d_name, frameNumber))
+				folderFrameNumbers.push_back(frameNumber);
+		}
+		closedir(dir);
+
+		std::sort(folderFrameNumbers.begin(), folderFrameNumbers.end());
+		folderFrameNumbers.erase(std::unique(folderFrameNumbers.begin(), folderFrameNumbers.end()), folderFrameNumbers.end());
+
+		// keep the frames found in every folder
+		if (folderId == 0)
+			frameNumbers.swap(folderFrameNumbers);
+		else {
+			std::vector<int> common;
+			std::set_intersection(frameNumbers.begin(), frameNumbers.end(),
+				folderFrameNumbers.begin(), folderFrameNumbers.end(), std::back_inserter(common));
+			frameNumbers.swap(common);
+		}
+	}
+
+	for (int i = 0; i < frameNumbers.size(); i++)
+		_addFrames(frameNumbers[i], 1, 1);
+
+	return m_numFrame > 0;
+}
+
+int FrameSet::getFrameNumber(const int frameId) const
+{
+	if (frameId < 0 || frameId >= m_numFrame)
+		return -1;
+
+	// last run starting at or before frameId
+	int lo = 0, hi = (int) m_runs.size() - 1;
+	while (lo < hi)
+	{
+		int mid = (lo + hi + 1) / 2;
+		if (m_runs[mid].firstFrameId <= frameId)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	const Run& run = m_runs[lo];
+	return run.frameStart + (frameId - run.firstFrameId) * run.frameStride;
+}
+
+void FrameSet::_addFrames(const int frameStart, const int frameStride, const int numFrame)
+{
+	if (numFrame <= 0)
+		return;
+
+	// extend the last run when the frames continue it
+	if (!m_runs.empty())
+	{
+		Run& run = m_runs.back();
+		int nextFrame = run.frameStart + run.frameStride * run.numFrame;
+		if (run.numFrame == 1 && frameStart > run.frameStart && (numFrame == 1 || frameStride == frameStart - run.frameStart))
+		{
+			run.frameStride = frameStart - run.frameStart;
+			run.numFrame += numFrame;
+			m_numFrame += numFrame;
+			return;
+		}
+		if (frameStart == nextFrame && (numFrame == 1 || frameStride == run.frameStride))
+		{
+			run.numFrame += numFrame;
+			m_numFrame += numFrame;
+			return;
+		}
+	}
+
+	Run run;
+	run.firstFrameId = m_numFrame;
+	run.frameStart = frameStart;
+	run.frameStride = frameStride;
+	run.numFrame = numFrame;
+	m_runs.push_back(run);
+	m_numFrame += numFrame;
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+/* These classes resolve the frame files of a sequence without listing them.
+*
+* FramePattern turns a frame number into a filename, e.g. "color%04d.png".
+* FrameSet maps frame ids 0..numFrame-1 to the recorded frame numbers, stored
+* as strided runs so a range costs the same regardless of its length.
+*/
+
+#pragma once
+
+#ifndef __FRAME_SET_H__
+#define __FRAME_SET_H__
+
+#include <string>
+#include <vector>
+
+class FramePattern
+{
+public:
+	FramePattern();
+
+	// printf-like pattern with one %d or %0Nd for the frame number
+	bool init(const std::string& pattern);
+
+	std::string format(const int frameNumber) const;
+	// return false if filename doesn't follow the pattern
+	bool parse(const std::string& filename, int& frameNumber) const;
+
+private:
+	std::string m_prefix;
+	std::string m_suffix;
+	int m_numDigit;
+};
+
+class FrameSet
+{
+public:
+	FrameSet();
+
+	void clear();
+	// numFrame frames frameStart, frameStart + frameStride, ...
+	void initRange(const int frameStart, const int frameStride, const int numFrame);
+	// comma separated frame numbers and ranges, e.g. "0, 10-20, 100-200:5" (end inclusive, ":" gives the stride)
+	bool initList(const std::string& frameList);
+	// frame numbers with a file in every folder, in increasing order
+	bool initScan(const std::vector<std::string>& folders, const std::vector<FramePattern>& patterns);
+
+	int getNumFrame() const
+	{
+		return m_numFrame;
+	}
+	int getFrameNumber(const int frameId) const;
+
+private:
+	struct Run
+	{
+		int firstFrameId;
+		int frameStart;
+		int frameStride;
+		int numFrame;
+	};
+
+	void _addFrames(const int frameStart, const int frameStride, const int numFrame);
+
+	int m_numFrame;
+	std::vector<Run> m_runs;
+};
+
+#endif//__FRAME_SET_H__
\ No newline at end of file
@@ -0,0 +1,387 @@
+#include "PooledMatAllocator.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// VS2013 has no thread_local, its __declspec(thread) only holds plain data and a fiber local slot
+// gives the thread exit callback; elsewhere a thread_local object does
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define POOL_THREAD_LOCAL __declspec(thread)
+#define POOL_FLS_EXIT
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#define POOL_THREAD_LOCAL thread_local
+#endif
+
+#define POOL_MIN_BLOCK_BYTES 64
+#define POOL_NUM_CLASS 73 // 64 bytes, then four classes per power of two up to POOL_MAX_BLOCK_BYTES
+#define POOL_UMATDATA_OFFSET 16
+#define POOL_DATA_OFFSET ((POOL_UMATDATA_OFFSET + sizeof(cv::UMatData) + 63) & ~(size_t) 63)
+
+// start of every block, in front of the Mat header and the pixels
+struct PoolBlock
+{
+	PoolBlock* next;
+	int sizeClass; // -1 for a block of the heap only
+};
+
+enum ALLOCATION_COUNT{COUNT_ALLOCATION, COUNT_HEAP_ALLOCATION, COUNT_HEAP_BYTE, NUM_ALLOCATION_COUNT};
+
+// the free lists are touched by the owning thread only, so allocating takes no lock. The counts are
+// written by the owner only and read by the report, trim() asks the owner to empty its lists
+struct ThreadCache
+{
+	PoolBlock* freeBlocks[POOL_NUM_CLASS];
+	std::atomic<size_t> cachedBytes;
+	std::atomic<long long> counts[NUM_ALLOCATION_STAGE][NUM_ALLOCATION_COUNT];
+	// counts at the last resetStats(), under s_registryMutex
+	long long baseCounts[NUM_ALLOCATION_STAGE][NUM_ALLOCATION_COUNT];
+	std::atomic<bool> bTrimRequested;
+};
+
+static const char* STAGE_NAMES[NUM_ALLOCATION_STAGE] = {"other", "detection", "3d corners", "intrinsic", "extrinsic"};
+
+// caches of the live threads; a thread that ends frees its buffers and folds its counts into s_endedCounts
+static std::mutex s_registryMutex;
+static std::vector<ThreadCache*> s_caches;
+static long long s_endedCounts[NUM_ALLOCATION_STAGE][NUM_ALLOCATION_COUNT];
+
+static POOL_THREAD_LOCAL ThreadCache* t_cache = NULL;
+static POOL_THREAD_LOCAL bool t_bEnded = false;
+static POOL_THREAD_LOCAL int t_stage = STAGE_OTHER;
+
+// only the owning thread writes a count, a plain load and store is enough
+static void addCount(std::atomic<long long>& count, const long long n)
+{
+	count.store(count.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static void freeCachedBlocks(ThreadCache* cache)
+{
+	for (int sizeClass = 0; sizeClass < POOL_NUM_CLASS; sizeClass++)
+	{
+		while (cache->freeBlocks[sizeClass] != NULL)
+		{
+			PoolBlock* block = cache->freeBlocks[sizeClass];
+			cache->freeBlocks[sizeClass] = block->next;
+			cv::fastFree(block);
+		}
+	}
+	cache->cachedBytes.store(0, std::memory_order_relaxed);
+}
+
+// called on the ending thread; Mats it frees after this go straight to the heap
+static void releaseThreadCache(ThreadCache* cache)
+{
+	if (cache == NULL)
+		return;
+
+	freeCachedBlocks(cache);
+	{
+		std::unique_lock<std::mutex> lock(s_registryMutex);
+		for (int stage = 0; stage < NUM_ALLOCATION_STAGE; stage++)
+			for (int count = 0; count < NUM_ALLOCATION_COUNT; count++)
+				s_endedCounts[stage][count] += cache->counts[stage][count].load(std::memory_order_relaxed) - cache->baseCounts[stage][count];
+		for (int cacheId = 0; cacheId < s_caches.size(); cacheId++)
+		{
+			if (s_caches[cacheId] == cache)
+			{
+				s_caches.erase(s_caches.begin() + cacheId);
+				break;
+			}
+		}
+	}
+	delete cache;
+	t_cache = NULL;
+	t_bEnded = true;
+}
+
+#ifdef POOL_FLS_EXIT
+static DWORD s_flsIndex = FLS_OUT_OF_INDEXES;
+
+static void WINAPI onThreadExit(void* cache)
+{
+	releaseThreadCache((ThreadCache*) cache);
+}
+#else
+struct ThreadCacheOwner
+{
+	~ThreadCacheOwner()
+	{
+		releaseThreadCache(t_cache);
+	}
+};
+
+static thread_local ThreadCacheOwner t_cacheOwner;
+#endif
+
+// NULL once the thread is ending
+static ThreadCache* getThreadCache()
+{
+	if (t_cache == NULL && !t_bEnded)
+	{
+		ThreadCache* cache = new ThreadCache();
+		for (int sizeClass = 0; sizeClass < POOL_NUM_CLASS; sizeClass++)
+			cache->freeBlocks[sizeClass] = NULL;
+		cache->cachedBytes.store(0);
+		for (int stage = 0; stage < NUM_ALLOCATION_STAGE; stage++)
+		{
+			for (int count = 0; count < NUM_ALLOCATION_COUNT; count++)
+			{
+				cache->counts[stage][count].store(0);
+				cache->baseCounts[stage][count] = 0;
+			}
+		}
+		cache->bTrimRequested.store(false);
+
+		std::unique_lock<std::mutex> lock(s_registryMutex);
+		s_caches.push_back(cache);
+		t_cache = cache;
+#ifdef POOL_FLS_EXIT
+		if (s_flsIndex == FLS_OUT_OF_INDEXES)
+			s_flsIndex = FlsAlloc(onThreadExit);
+		if (s_flsIndex != FLS_OUT_OF_INDEXES)
+			FlsSetValue(s_flsIndex, cache);
+#else
+		// constructed on first use, destroyed when the thread ends
+		(void) &t_cacheOwner;
+#endif
+	}
+
+	// a trim() from another thread is carried out by the owner
+	ThreadCache* cache = t_cache;
+	if (cache != NULL && cache->bTrimRequested.load(std::memory_order_relaxed))
+	{
+		freeCachedBlocks(cache);
+		cache->bTrimRequested.store(false, std::memory_order_relaxed);
+	}
+	return cache;
+}
+
+// smallest class holding numBytes, -1 if it is too large for the pool
+static int getSizeClass(const size_t numBytes)
+{
+	if (numBytes <= POOL_MIN_BLOCK_BYTES)
+		return 0;
+	if (numBytes > POOL_MAX_BLOCK_BYTES)
+		return -1;
+
+	size_t n = numBytes - 1;
+	int exponent = 0;
+	while ((n >> (exponent + 1)) != 0)
+		exponent++;
+	size_t quarter = (size_t) 1 << (exponent - 2);
+	int sub = (int) ((n - ((size_t) 1 << exponent)) / quarter);
+	return 1 + (exponent - 6) * 4 + sub;
+}
+
+static size_t getClassBytes(const int sizeClass)
+{
+	if (sizeClass == 0)
+		return POOL_MIN_BLOCK_BYTES;
+
+	int exponent = 6 + (sizeClass - 1) / 4;
+	int sub = (sizeClass - 1) % 4;
+	return ((size_t) 1 << exponent) + (sub + 1) * ((size_t) 1 << (exponent - 2));
+}
+
+PooledMatAllocator::PooledMatAllocator() : m_bPool(false), m_bInstalled(false)
+{
+
+}
+
+PooledMatAllocator* PooledMatAllocator::_getInstance()
+{
+	// never deleted, Mats may outlive the run; created by install() before any worker uses it
+	static PooledMatAllocator* instance = NULL;
+	if (instance == NULL)
+		instance = new PooledMatAllocator();
+	return instance;
+}
+
+void PooledMatAllocator::install(const bool bPool)
+{
+	PooledMatAllocator* allocator = _getInstance();
+	allocator->m_bPool = bPool;
+	allocator->m_bInstalled = true;
+	cv::Mat::setDefaultAllocator(allocator);
+}
+
+void PooledMatAllocator::uninstall()
+{
+	PooledMatAllocator* allocator = _getInstance();
+	if (!allocator->m_bInstalled)
+		return;
+
+	cv::Mat::setDefaultAllocator(NULL);
+	allocator->m_bInstalled = false;
+	allocator->m_bPool = false;
+}
+
+bool PooledMatAllocator::isInstalled()
+{
+	return _getInstance()->m_bInstalled;
+}
+
+void PooledMatAllocator::trim()
+{
+	ThreadCache* ownCache = t_cache;
+	if (ownCache != NULL)
+		freeCachedBlocks(ownCache);
+
+	std::unique_lock<std::mutex> lock(s_registryMutex);
+	for (int cacheId = 0; cacheId < s_caches.size(); cacheId++)
+	{
+		if (s_caches[cacheId] != ownCache)
+			s_caches[cacheId]->bTrimRequested.store(true, std::memory_order_relaxed);
+	}
+}
+
+void PooledMatAllocator::resetStats()
+{
+	std::unique_lock<std::mutex> lock(s_registryMutex);
+	memset(s_endedCounts, 0, sizeof(s_endedCounts));
+	for (int cacheId = 0; cacheId < s_caches.size(); cacheId++)
+	{
+		ThreadCache* cache = s_caches[cacheId];
+		for (int stage = 0; stage < NUM_ALLOCATION_STAGE; stage++)
+			for (int count = 0; count < NUM_ALLOCATION_COUNT; count++)
+				cache->baseCounts[stage][count] = cache->counts[stage][count].load(std::memory_order_relaxed);
+	}
+}
+
+void PooledMatAllocator::printStats()
+{
+	long long total[NUM_ALLOCATION_STAGE][NUM_ALLOCATION_COUNT];
+	size_t cachedBytes = 0;
+	int numThread = 0;
+	{
+		std::unique_lock<std::mutex> lock(s_registryMutex);
+		memcpy(total, s_endedCounts, sizeof(total));
+		numThread = (int) s_caches.size();
+		for (int cacheId = 0; cacheId < numThread; cacheId++)
+		{
+			ThreadCache* cache = s_caches[cacheId];
+			cachedBytes += cache->cachedBytes.load(std::memory_order_relaxed);
+			for (int stage = 0; stage < NUM_ALLOCATION_STAGE; stage++)
+				for (int count = 0; count < NUM_ALLOCATION_COUNT; count++)
+					total[stage][count] += cache->counts[stage][count].load(std::memory_order_relaxed) - cache->baseCounts[stage][count];
+		}
+	}
+
+	printf("Mat allocations (%s, %d live threads, %.1f MB cached):\n", _getInstance()->m_bPool ? "pooled" : "counted only",
+		numThread, cachedBytes / (1024.0 * 1024.0));
+	for (int stage = 0; stage < NUM_ALLOCATION_STAGE; stage++)
+	{
+		if (total[stage][COUNT_ALLOCATION] == 0)
+			continue;
+		printf("  %-10s %9lld allocations, %9lld from the heap (%.1f MB)\n", STAGE_NAMES[stage],
+			total[stage][COUNT_ALLOCATION], total[stage][COUNT_HEAP_ALLOCATION], total[stage][COUNT_HEAP_BYTE] / (1024.0 * 1024.0));
+	}
+}
+
+cv::UMatData* PooledMatAllocator::allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+	int flags, cv::UMatUsageFlags usageFlags) const
+{
+	// the steps as cv::Mat's own allocator sets them
+	size_t total = CV_ELEM_SIZE(type);
+	for (int i = dims - 1; i >= 0; i--)
+	{
+		if (step != NULL)
+		{
+			if (data != NULL && step[i] != CV_AUTOSTEP)
+			{
+				CV_Assert(total <= step[i]);
+				total = step[i];
+			}
+			else
+				step[i] = total;
+		}
+		total *= sizes[i];
+	}
+
+	// a Mat around user data only needs the header
+	size_t blockBytes = POOL_DATA_OFFSET + (data != NULL ? 0 : total);
+	int stage = t_stage;
+	ThreadCache* cache = getThreadCache();
+	int sizeClass = (m_bPool && stage != STAGE_OTHER && cache != NULL) ? getSizeClass(blockBytes) : -1;
+	if (sizeClass >= 0)
+		blockBytes = getClassBytes(sizeClass);
+
+	PoolBlock* block = NULL;
+	if (sizeClass >= 0 && cache->freeBlocks[sizeClass] != NULL)
+	{
+		block = cache->freeBlocks[sizeClass];
+		cache->freeBlocks[sizeClass] = block->next;
+		cache->cachedBytes.store(cache->cachedBytes.load(std::memory_order_relaxed) - blockBytes, std::memory_order_relaxed);
+	}
+	else
+	{
+		block = (PoolBlock*) cv::fastMalloc(blockBytes);
+		if (cache != NULL)
+		{
+			addCount(cache->counts[stage][COUNT_HEAP_ALLOCATION], 1);
+			addCount(cache->counts[stage][COUNT_HEAP_BYTE], (long long) blockBytes);
+		}
+	}
+	if (cache != NULL)
+		addCount(cache->counts[stage][COUNT_ALLOCATION], 1);
+
+	block->next = NULL;
+	block->sizeClass = sizeClass;
+
+	cv::UMatData* u = new ((uchar*) block + POOL_UMATDATA_OFFSET) cv::UMatData(this);
+	u->data = u->origdata = data != NULL ? (uchar*) data : (uchar*) block + POOL_DATA_OFFSET;
+	u->size = total;
+	if (data != NULL)
+		u->flags |= cv::UMatData::USER_ALLOCATED;
+	return u;
+}
+
+bool PooledMatAllocator::allocate(cv::UMatData* u, int accessFlags, cv::UMatUsageFlags usageFlags) const
+{
+	return u != NULL;
+}
+
+void PooledMatAllocator::deallocate(cv::UMatData* u) const
+{
+	if (u == NULL)
+		return;
+
+	CV_Assert(u->urefcount == 0 && u->refcount == 0);
+	PoolBlock* block = (PoolBlock*) ((uchar*) u - POOL_UMATDATA_OFFSET);
+	int sizeClass = block->sizeClass;
+	u->~UMatData();
+
+	// the block joins the cache of the freeing thread, which need not be the allocating one
+	ThreadCache* cache = sizeClass >= 0 ? getThreadCache() : NULL;
+	if (cache != NULL)
+	{
+		size_t blockBytes = getClassBytes(sizeClass);
+		size_t cachedBytes = cache->cachedBytes.load(std::memory_order_relaxed);
+		if (cachedBytes + blockBytes <= POOL_MAX_THREAD_BYTES)
+		{
+			block->next = cache->freeBlocks[sizeClass];
+			cache->freeBlocks[sizeClass] = block;
+			cache->cachedBytes.store(cachedBytes + blockBytes, std::memory_order_relaxed);
+			return;
+		}
+	}
+	cv::fastFree(block);
+}
+
+AllocationStage::AllocationStage(const ALLOCATION_STAGE stage) : m_prevStage(t_stage)
+{
+	t_stage = stage;
+}
+
+AllocationStage::~AllocationStage()
+{
+	t_stage = m_prevStage;
+}
\ No newline at end of file
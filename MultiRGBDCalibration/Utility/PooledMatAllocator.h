@@ -0,0 +1,73 @@
+/* This allocator recycles the pixel buffers of cv::Mat per thread.
+*
+* Once installed, every cv::Mat without an allocator of its own is created by
+* it, including the temporaries OpenCV creates inside its functions. Buffers
+* allocated while the thread is in an AllocationStage are pooled: a freed
+* buffer goes to a size class of the freeing thread and serves the next Mat of
+* that class there, so a loop that keeps creating the same Mats stops reaching
+* the heap after its first pass. The Mat header lives in front of its pixels,
+* in the same block. Buffers outside a stage, or larger than the largest class,
+* come straight from the heap.
+*
+* Only the owning thread touches its free lists, so allocating takes no lock.
+* A thread that ends frees its buffers and drops its cache, keeping its counts
+* for the report.
+*
+* Every allocation is counted per stage, also when pooling is off, so the
+* report shows which stage still allocates.
+*/
+
+#pragma once
+
+#ifndef __POOLED_MAT_ALLOCATOR_H__
+#define __POOLED_MAT_ALLOCATOR_H__
+
+#include <opencv2/opencv.hpp>
+
+#define POOL_MAX_BLOCK_BYTES ((size_t) 16 << 20)
+#define POOL_MAX_THREAD_BYTES ((size_t) 64 << 20) // cached per thread
+
+enum ALLOCATION_STAGE{STAGE_OTHER, STAGE_DETECT, STAGE_CORNERS3D, STAGE_INTRINSIC, STAGE_EXTRINSIC, NUM_ALLOCATION_STAGE};
+
+class PooledMatAllocator : public cv::MatAllocator
+{
+public:
+	// make the allocator OpenCV's default; without bPool it only counts
+	static void install(const bool bPool);
+	// back to OpenCV's allocator, Mats still alive are returned to this one
+	static void uninstall();
+	static bool isInstalled();
+
+	// free the buffers cached by the calling thread now and by the other live threads at their next
+	// allocation or free; the threads that have ended freed theirs when they ended
+	static void trim();
+	static void resetStats();
+	// allocations per stage since the last reset; call while no stage is running
+	static void printStats();
+
+	cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+		int flags, cv::UMatUsageFlags usageFlags) const;
+	bool allocate(cv::UMatData* u, int accessFlags, cv::UMatUsageFlags usageFlags) const;
+	void deallocate(cv::UMatData* u) const;
+
+private:
+	PooledMatAllocator();
+
+	static PooledMatAllocator* _getInstance();
+
+	bool m_bPool;
+	bool m_bInstalled;
+};
+
+// tags the Mat allocations of the calling thread with stage while in scope
+class AllocationStage
+{
+public:
+	explicit AllocationStage(const ALLOCATION_STAGE stage);
+	~AllocationStage();
+
+private:
+	int m_prevStage;
+};
+
+#endif//__POOLED_MAT_ALLOCATOR_H__
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "RVLCodec.h"
+
+namespace
+{
+	struct RVLWriter
+	{
+		int* buffer;
+		int* start;
+		unsigned int word;
+		int numNibble;
+
+		void encode(unsigned int value)
+		{
+			do {
+				unsigned int nibble = value & 0x7;
+				if (value >>= 3)
+					nibble |= 0x8;
+				word <<= 4;
+				word |= nibble;
+				if (++numNibble == 8)
+				{
+					*buffer++ = (int) word;
+					numNibble = 0;
+					word = 0;
+				}
+			} while (value);
+		}
+
+		void flush()
+		{
+			if (numNibble)
+				*buffer++ = (int) (word << 4 * (8 - numNibble));
+			numNibble = 0;
+			word = 0;
+		}
+	};
+
+	struct RVLReader
+	{
+		const int* buffer;
+		const int* start;
+		unsigned int word;
+		int numNibble;
+
+		int decode()
+		{
+			unsigned int nibble, value = 0;
+			int bits = 29;
+			do {
+				if (!numNibble)
+				{
+					word = (unsigned int) *buffer++;
+					numNibble = 8;
+				}
+				nibble = word & 0xf0000000;
+				value |= (nibble << 1) >> bits;
+				word <<= 4;
+				numNibble--;
+				bits -= 3;
+			} while (nibble & 0x80000000);
+			return (int) value;
+		}
+	};
+}
+
+int rvlMaxCompressedWords(const int numPixel)
+{
+	// a 16-bit delta takes at most 6 nibbles and each zero / non-zero run pair
+	// adds at most one nibble per sample, plus the run lengths of the last pair
+	return (numPixel * 7 + 24 + 7) / 8 + 1;
+}
+
+int rvlCompress(const unsigned short* input, const int numPixel, int* output)
+{
+	RVLWriter writer = { output, output, 0, 0 };
+
+	const unsigned short* end = input + numPixel;
+	unsigned short previous = 0;
+	while (input != end)
+	{
+		int zeros = 0, nonzeros = 0;
+		for (; input != end && !*input; input++, zeros++);
+		writer.encode(zeros);
+
+		for (const unsigned short* p = input; p != end && *p++; nonzeros++);
+		writer.encode(nonzeros);
+
+		for (int i = 0; i < nonzeros; i++)
+		{
+			unsigned short current = *input++;
+			int delta = current - previous;
+			unsigned int positive = ((unsigned int) delta << 1) ^ (unsigned int) (delta >> 31);
+			writer.encode(positive);
+			previous = current;
+		}
+	}
+	writer.flush();
+
+	return (int) (writer.buffer - writer.start);
+}
+
+int rvlDecompress(const int* input, unsigned short* output, const int numPixel)
+{
+	RVLReader reader = { input, input, 0, 0 };
+
+	int numRemaining = numPixel;
+	unsigned short previous = 0;
+	while (numRemaining > 0)
+	{
+		int zeros = reader.decode();
+		numRemaining -= zeros;
+		for (; zeros; zeros--)
+			*output++ = 0;
+
+		int nonzeros = reader.decode();
+		numRemaining -= nonzeros;
+		for (; nonzeros; nonzeros--)
+		{
+			int positive = reader.decode();
+			int delta = (int) (((unsigned int) positive >> 1) ^ (0u - ((unsigned int) positive & 1)));
+			unsigned short current = (unsigned short) (previous + delta);
+			*output++ = current;
+			previous = current;
+		}
+	}
+
+	return (int) (reader.buffer - reader.start);
+}
\ No newline at end of file
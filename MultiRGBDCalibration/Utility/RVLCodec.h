@@ -0,0 +1,22 @@
+/* Lossless run-length / variable-length (RVL) coding of 16-bit depth samples.
+*
+* Zero runs and the deltas between valid samples are written as 3-bit
+* variable-length nibbles packed into 32-bit words, following
+* A. D. Wilson, "Fast Lossless Depth Image Compression", ISS 2017.
+*/
+
+#pragma once
+
+#ifndef __RVL_CODEC_H__
+#define __RVL_CODEC_H__
+
+// upper bound of the num. of 32-bit words rvlCompress() writes for numPixel samples
+int rvlMaxCompressedWords(const int numPixel);
+
+// compress numPixel samples into output, returns the num. of 32-bit words written
+int rvlCompress(const unsigned short* input, const int numPixel, int* output);
+
+// decompress numPixel samples from input, returns the num. of 32-bit words consumed
+int rvlDecompress(const int* input, unsigned short* output, const int numPixel);
+
+#endif//__RVL_CODEC_H__
\ No newline at end of file
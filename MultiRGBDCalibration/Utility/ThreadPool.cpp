@@ -0,0 +1,97 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool() : m_numPendingJob(0), m_bStop(false)
+{
+
+}
+
+ThreadPool::~ThreadPool()
+{
+	clear();
+}
+
+void ThreadPool::init(int numThreads)
+{
+	clear();
+
+	if (numThreads <= 0)
+		numThreads = (int) std::thread::hardware_concurrency();
+	if (numThreads <= 0)
+		numThreads = 1;
+
+	m_bStop = false;
+	for (int threadId = 0; threadId < numThreads; threadId++)
+	{
+		m_workers.push_back(std::thread(&ThreadPool::_workerLoop, this));
+	}
+}
+
+void ThreadPool::clear()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_bStop = true;
+	}
+	m_jobCondition.notify_all();
+
+	for (int threadId = 0; threadId < m_workers.size(); threadId++)
+	{
+		if (m_workers[threadId].joinable())
+			m_workers[threadId].join();
+	}
+	m_workers.clear();
+	m_jobs.clear();
+	m_numPendingJob = 0;
+}
+
+void ThreadPool::enqueue(const std::function<void()>& job)
+{
+	// run inline when the pool has not been initialized
+	if (m_workers.empty())
+	{
+		job();
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_jobs.push_back(job);
+		m_numPendingJob++;
+	}
+	m_jobCondition.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_numPendingJob > 0)
+		m_doneCondition.wait(lock);
+}
+
+void ThreadPool::_workerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (!m_bStop && m_jobs.empty())
+				m_jobCondition.wait(lock);
+
+			if (m_bStop && m_jobs.empty())
+				return;
+
+			job = m_jobs.front();
+			m_jobs.pop_front();
+		}
+
+		job();
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_numPendingJob--;
+			if (m_numPendingJob == 0)
+				m_doneCondition.notify_all();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+/* This class runs jobs on a fixed number of worker threads. */
+
+#pragma once
+
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class ThreadPool
+{
+public:
+	ThreadPool();
+	virtual ~ThreadPool();
+
+	// numThreads <= 0 uses one worker per hardware thread
+	void init(int numThreads);
+	void clear();
+
+	void enqueue(const std::function<void()>& job);
+
+	// block until every queued job has finished
+	void wait();
+
+	int getNumThreads() const
+	{
+		return (int) m_workers.size();
+	}
+
+private:
+	void _workerLoop();
+
+	std::vector<std::thread> m_workers;
+	std::deque<std::function<void()>> m_jobs;
+
+	std::mutex m_mutex;
+	std::condition_variable m_jobCondition;
+	std::condition_variable m_doneCondition;
+
+	int m_numPendingJob;
+	bool m_bStop;
+};
+
+#endif//__THREAD_POOL_H__
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "WorkStealingPool.h"
+
+WorkStealingPool::WorkStealingPool() : m_nextQueue(0), m_numQueuedJob(0), m_numPendingJob(0), m_numStolen(0), m_bStop(false)
+{
+
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	clear();
+}
+
+void WorkStealingPool::init(int numThreads)
+{
+	clear();
+
+	if (numThreads <= 0)
+		numThreads = (int) std::thread::hardware_concurrency();
+	if (numThreads <= 0)
+		numThreads = 1;
+
+	m_bStop = false;
+	m_numStolen = 0;
+	for (int workerId = 0; workerId < numThreads; workerId++)
+		m_queues.push_back(new WorkerQueue);
+	for (int workerId = 0; workerId < numThreads; workerId++)
+	{
+		m_workers.push_back(std::thread(&WorkStealingPool::_workerLoop, this, workerId));
+	}
+}
+
+void WorkStealingPool::clear()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_bStop = true;
+	}
+	m_jobCondition.notify_all();
+
+	for (int workerId = 0; workerId < m_workers.size(); workerId++)
+	{
+		if (m_workers[workerId].joinable())
+			m_workers[workerId].join();
+	}
+	m_workers.clear();
+
+	for (int workerId = 0; workerId < m_queues.size(); workerId++)
+		delete m_queues[workerId];
+	m_queues.clear();
+
+	m_nextQueue = 0;
+	m_numQueuedJob = 0;
+	m_numPendingJob = 0;
+}
+
+void WorkStealingPool::enqueue(const std::function<void()>& job)
+{
+	// run inline when the pool has not been initialized
+	if (m_workers.empty())
+	{
+		job();
+		return;
+	}
+
+	WorkerQueue* queue = m_queues[m_nextQueue];
+	m_nextQueue = (m_nextQueue + 1) % (int) m_queues.size();
+	{
+		std::unique_lock<std::mutex> lock(queue->mutex);
+		queue->jobs.push_back(job);
+	}
+
+	// counted only once the job is in a queue, so a claimed job is always found
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_numQueuedJob++;
+		m_numPendingJob++;
+	}
+	m_jobCondition.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_numPendingJob > 0)
+		m_doneCondition.wait(lock);
+}
+
+void WorkStealingPool::_workerLoop(const int workerId)
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (!m_bStop && m_numQueuedJob == 0)
+				m_jobCondition.wait(lock);
+
+			if (m_bStop && m_numQueuedJob == 0)
+				return;
+
+			m_numQueuedJob--;
+		}
+
+		std::function<void()> job;
+		while (!_takeJob(workerId, job))
+			std::this_thread::yield();
+
+		job();
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_numPendingJob--;
+			if (m_numPendingJob == 0)
+				m_doneCondition.notify_all();
+		}
+	}
+}
+
+bool WorkStealingPool::_takeJob(const int workerId, std::function<void()>& job)
+{
+	// own queue in order first, then the most recently queued job of the others
+	int numQueue = (int) m_queues.size();
+	for (int i = 0; i < numQueue; i++)
+	{
+		WorkerQueue* queue = m_queues[(workerId + i) % numQueue];
+		std::unique_lock<std::mutex> lock(queue->mutex);
+		if (queue->jobs.empty())
+			continue;
+
+		if (i == 0)
+		{
+			job = queue->jobs.front();
+			queue->jobs.pop_front();
+		}
+		else {
+			job = queue->jobs.back();
+			queue->jobs.pop_back();
+			lock.unlock();
+
+			std::unique_lock<std::mutex> statLock(m_mutex);
+			m_numStolen++;
+		}
+		return true;
+	}
+
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+/* This class runs jobs of very uneven cost on a fixed number of worker threads.
+*
+* Every worker has its own queue; jobs are spread over the queues in turn and a
+* worker whose queue runs dry takes jobs from the back of the other queues, so a
+* few slow jobs don't leave the rest of the workers idle.
+*/
+
+#pragma once
+
+#ifndef __WORK_STEALING_POOL_H__
+#define __WORK_STEALING_POOL_H__
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class WorkStealingPool
+{
+public:
+	WorkStealingPool();
+	virtual ~WorkStealingPool();
+
+	// numThreads <= 0 uses one worker per hardware thread
+	void init(int numThreads);
+	void clear();
+
+	void enqueue(const std::function<void()>& job);
+
+	// block until every queued job has finished
+	void wait();
+
+	int getNumThreads() const
+	{
+		return (int) m_workers.size();
+	}
+	// jobs run by another worker than the one they were queued on
+	long long getNumStolen() const
+	{
+		return m_numStolen;
+	}
+
+private:
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<std::function<void()>> jobs;
+	};
+
+	void _workerLoop(const int workerId);
+	bool _takeJob(const int workerId, std::function<void()>& job);
+
+	std::vector<std::thread> m_workers;
+	// workerId
+	std::vector<WorkerQueue*> m_queues;
+	int m_nextQueue;
+
+	std::mutex m_mutex;
+	std::condition_variable m_jobCondition;
+	std::condition_variable m_doneCondition;
+
+	// m_numQueuedJob counts the jobs no worker has claimed yet
+	int m_numQueuedJob;
+	int m_numPendingJob;
+	long long m_numStolen;
+	bool m_bStop;
+};
+
+#endif//__WORK_STEALING_POOL_H__
\ No newline at end of file